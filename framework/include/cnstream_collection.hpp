@@ -138,6 +138,15 @@ class Collection : public NonCopyable {
   bool TaggedIsOfType(const std::string& tag);
 #endif
 
+  /**
+   * @brief Copies all data to another collection. Data already tagged in `dst` is kept.
+   *
+   * @param[out] dst The collection to copy data to.
+   *
+   * @return No return value.
+   */
+  void CopyTo(Collection* dst);
+
  private:
   void Add(const std::string& tag, std::unique_ptr<cnstream::any>&& value);
   bool AddIfNotExists(const std::string& tag, std::unique_ptr<cnstream::any>&& value);
@@ -54,6 +54,14 @@ bool Collection::HasValue(const std::string& tag) {
   return data_.end() != data_.find(tag);
 }
 
+void Collection::CopyTo(Collection* dst) {
+  if (dst == this) return;
+  RwLockReadGuard lk(rw_lock_);
+  for (const auto& it : data_) {
+    dst->AddIfNotExists(it.first, std::unique_ptr<cnstream::any>(new cnstream::any(*it.second)));
+  }
+}
+
 #if !defined(_LIBCPP_NO_RTTI)
 const std::type_info& Collection::Type(const std::string& tag) {
   RwLockReadGuard lk(rw_lock_);
@@ -209,6 +209,24 @@ TEST(CoreCollection, HasValue) {
   EXPECT_FALSE(collection.HasValue(test_tag1));
 }
 
+TEST(CoreCollection, CopyTo) {
+  cnstream::Collection collection;
+  collection.Add(test_tag0, value_a);
+  collection.Add(test_tag1, value_b);
+  cnstream::Collection dst;
+  collection_test::TestStructB kept{"kept_member_b", 2};
+  dst.Add(test_tag1, kept);
+  collection.CopyTo(&dst);
+  EXPECT_EQ(dst.Get<collection_test::TestStructA>(test_tag0), value_a);
+  EXPECT_EQ(dst.Get<collection_test::TestStructB>(test_tag1), kept);
+  // values are copied, not shared
+  dst.Get<collection_test::TestStructA>(test_tag0).member_a = "modified_member_a";
+  EXPECT_EQ(collection.Get<collection_test::TestStructA>(test_tag0), value_a);
+  // copying to itself does nothing
+  collection.CopyTo(&collection);
+  EXPECT_EQ(collection.Get<collection_test::TestStructB>(test_tag1), value_b);
+}
+
 #if !defined(_LIBCPP_NO_RTTI)
 TEST(CoreCollection, Type) {
   cnstream::Collection collection;
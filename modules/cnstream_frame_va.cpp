@@ -20,6 +20,7 @@
 #include "cnstream_frame_va.hpp"
 
 #include <unistd.h>
+#include <algorithm>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -80,6 +81,71 @@ static inline cv::Mat FrameToImageBGR(const CNDataFrame& frame) {
   return cv::Mat();
 }
 
+// roi is aligned to even and inside the frame, the surface is synced for cpu
+static cv::Mat YUV420SPRoiToImage(const CNDataFrame& frame, const cv::Rect& roi, const cv::Size& dst_size,
+                                  CnedkBufSurfaceColorFormat fmt) {
+  cnedk::BufSurfWrapperPtr surf = frame.buf_surf;
+  bool nv21 = surf->GetColorFormat() == CNEDK_BUF_COLOR_FORMAT_NV21;
+  int y_stride = surf->GetStride(0);
+  int uv_stride = surf->GetStride(1);
+  const uint8_t* y_plane = static_cast<const uint8_t*>(surf->GetHostData(0)) + roi.y * y_stride + roi.x;
+  const uint8_t* uv_plane = static_cast<const uint8_t*>(surf->GetHostData(1)) + roi.y / 2 * uv_stride + roi.x;
+  int width = dst_size.width;
+  int height = dst_size.height;
+
+  if (fmt == CNEDK_BUF_COLOR_FORMAT_GRAY8) {
+    cv::Mat gray(height, width, CV_8UC1);
+    libyuv::ScalePlane(y_plane, y_stride, roi.width, roi.height, gray.data, width, width, height,
+                       libyuv::kFilterBilinear);
+    return gray;
+  }
+
+  // scale the region on the YUV planes first, the color conversion is done at the output size
+  std::vector<uint8_t> scaled;
+  if (roi.width != width || roi.height != height) {
+    scaled.resize(width * height * 3 / 2);
+    uint8_t* dst_y = scaled.data();
+    uint8_t* dst_uv = dst_y + width * height;
+    libyuv::NV12Scale(y_plane, y_stride, uv_plane, uv_stride, roi.width, roi.height, dst_y, width, dst_uv, width,
+                      width, height, libyuv::kFilterBilinear);
+    y_plane = dst_y, y_stride = width;
+    uv_plane = dst_uv, uv_stride = width;
+  }
+
+  cv::Mat bgr(height, width, CV_8UC3);
+  int dst_stride = width * 3;
+  // kYvuH709Constants make it to BGR, the same as ImageBGR()
+  if (nv21)
+    libyuv::NV21ToRGB24Matrix(y_plane, y_stride, uv_plane, uv_stride, bgr.data, dst_stride, &libyuv::kYvuH709Constants,
+                              width, height);
+  else
+    libyuv::NV12ToRGB24Matrix(y_plane, y_stride, uv_plane, uv_stride, bgr.data, dst_stride, &libyuv::kYvuH709Constants,
+                              width, height);
+  if (fmt == CNEDK_BUF_COLOR_FORMAT_RGB) {
+    cv::Mat rgb(height, width, CV_8UC3);
+    libyuv::RGB24ToRAW(bgr.data, dst_stride, rgb.data, dst_stride, width, height);
+    return rgb;
+  }
+  return bgr;
+}
+
+// roi is inside the image
+static cv::Mat BGRRoiToImage(const cv::Mat& bgr, const cv::Rect& roi, const cv::Size& dst_size,
+                             CnedkBufSurfaceColorFormat fmt) {
+  cv::Mat dst;
+  if (roi.width != dst_size.width || roi.height != dst_size.height) {
+    cv::resize(bgr(roi), dst, dst_size);
+  } else {
+    dst = bgr(roi).clone();
+  }
+  if (fmt == CNEDK_BUF_COLOR_FORMAT_RGB) {
+    cv::cvtColor(dst, dst, cv::COLOR_BGR2RGB);
+  } else if (fmt == CNEDK_BUF_COLOR_FORMAT_GRAY8) {
+    cv::cvtColor(dst, dst, cv::COLOR_BGR2GRAY);
+  }
+  return dst;
+}
+
 }  // namespace color_cvt
 
 cv::Mat CNDataFrame::ImageBGR() {
@@ -91,6 +157,56 @@ cv::Mat CNDataFrame::ImageBGR() {
   return bgr_mat;
 }
 
+constexpr size_t CNDataFrame::kMaxRoiCacheSize;
+
+cv::Mat CNDataFrame::ImageRoi(const cv::Rect& roi, const cv::Size& dst_size, CnedkBufSurfaceColorFormat fmt) {
+  if (!buf_surf) return cv::Mat();
+  if (fmt != CNEDK_BUF_COLOR_FORMAT_BGR && fmt != CNEDK_BUF_COLOR_FORMAT_RGB && fmt != CNEDK_BUF_COLOR_FORMAT_GRAY8) {
+    LOGE(FRAME) << "ImageRoi(): Unsupported output format. fmt[" << static_cast<int>(fmt) << "]";
+    return cv::Mat();
+  }
+  CnedkBufSurfaceColorFormat src_fmt = buf_surf->GetColorFormat();
+  if (src_fmt != CNEDK_BUF_COLOR_FORMAT_NV12 && src_fmt != CNEDK_BUF_COLOR_FORMAT_NV21) {
+    LOGE(FRAME) << "ImageRoi(): Unsupported pixel format. fmt[" << static_cast<int>(src_fmt) << "]";
+    return cv::Mat();
+  }
+
+  int frame_w = static_cast<int>(buf_surf->GetWidth()) & ~1;
+  int frame_h = static_cast<int>(buf_surf->GetHeight()) & ~1;
+  int x0 = std::max(roi.x, 0) & ~1;
+  int y0 = std::max(roi.y, 0) & ~1;
+  int x1 = std::min(roi.x + roi.width, frame_w);
+  int y1 = std::min(roi.y + roi.height, frame_h);
+  cv::Rect aligned(x0, y0, (x1 - x0) & ~1, (y1 - y0) & ~1);
+  if (aligned.width <= 0 || aligned.height <= 0) return cv::Mat();
+  cv::Size size = dst_size;
+  if (size.width <= 0 || size.height <= 0) size = cv::Size(aligned.width, aligned.height);
+
+  RoiKey key{aligned.x, aligned.y, aligned.width, aligned.height, size.width, size.height, static_cast<int>(fmt)};
+  std::unique_lock<std::mutex> lk(mtx);
+  auto iter = roi_cache_.find(key);
+  if (iter != roi_cache_.end()) return iter->second;
+  cv::Mat bgr = bgr_mat;
+  // the whole surface is synced once for all regions of the frame
+  if (bgr.empty() && !synced_) {
+    CnedkBufSurfaceSyncForCpu(buf_surf->GetBufSurface(), -1, -1);
+    synced_ = true;
+  }
+  lk.unlock();
+
+  // convert without holding the lock, regions of the same frame can be converted concurrently
+  cv::Mat dst;
+  if (!bgr.empty()) {
+    dst = color_cvt::BGRRoiToImage(bgr, aligned, size, fmt);
+  } else {
+    dst = color_cvt::YUV420SPRoiToImage(*this, aligned, size, fmt);
+  }
+
+  lk.lock();
+  if (roi_cache_.size() < kMaxRoiCacheSize) roi_cache_.emplace(key, dst);
+  return dst;
+}
+
 bool CNInferObject::AddAttribute(const std::string& key, const CNInferAttr& value) {
   std::lock_guard<std::mutex> lk(attribute_mutex_);
   if (attributes_.find(key) != attributes_.end()) return false;
@@ -114,6 +230,11 @@ CNInferAttr CNInferObject::GetAttribute(const std::string& key) {
   return CNInferAttr();
 }
 
+std::vector<std::pair<std::string, CNInferAttr>> CNInferObject::GetAttributes() {
+  std::lock_guard<std::mutex> lk(attribute_mutex_);
+  return std::vector<std::pair<std::string, CNInferAttr>>(attributes_.begin(), attributes_.end());
+}
+
 bool CNInferObject::AddExtraAttribute(const std::string& key, const std::string& value) {
   std::lock_guard<std::mutex> lk(attribute_mutex_);
   if (extra_attributes_.find(key) != extra_attributes_.end()) return false;
@@ -30,6 +30,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -86,14 +87,43 @@ class CNDataFrame : public NonCopyable {
     if (bgr_mat.empty()) return false;
     return true;
   }
+  /**
+   * @brief Converts a region of interest of the frame, and resizes it if needed.
+   *
+   * Only the region is converted, directly from the YUV surface. If the whole frame has been converted by
+   * ImageBGR(), the region is cropped from the BGR image instead. The results are cached for the lifetime of the frame,
+   * the same region requested again with the same size and format is returned without converting.
+   *
+   * @param[in] roi The region in pixels. It is clipped to the frame, and its origin and size are aligned to even.
+   * @param[in] dst_size The size of the output image. The size of the region is used if it is empty.
+   * @param[in] fmt The color format of the output image. Supports BGR, RGB and GRAY8.
+   *
+   * @return Returns the converted image. Returns an empty mat if the region or the format is invalid.
+   *
+   * @note The returned mat shares data with the cache, it should not be modified.
+   * @note This is a thread-safe function.
+   */
+  cv::Mat ImageRoi(const cv::Rect& roi, const cv::Size& dst_size = cv::Size(),
+                   CnedkBufSurfaceColorFormat fmt = CNEDK_BUF_COLOR_FORMAT_BGR);
 
   uint64_t frame_id = -1;  /*!< The frame index that incremented from 0. */
 
   cnedk::BufSurfWrapperPtr buf_surf = nullptr;
 
  private:
+  struct RoiKey {
+    int x, y, w, h, dst_w, dst_h, fmt;
+    bool operator<(const RoiKey& other) const {
+      return std::tie(x, y, w, h, dst_w, dst_h, fmt) <
+             std::tie(other.x, other.y, other.w, other.h, other.dst_w, other.dst_h, other.fmt);
+    }
+  };
+  static constexpr size_t kMaxRoiCacheSize = 256;  /*!< Regions requested beyond this are converted but not cached. */
+
   std::mutex mtx;
   cv::Mat bgr_mat;  /*!< A Mat stores BGR image. */
+  std::map<RoiKey, cv::Mat> roi_cache_;  /*!< Converted regions. */
+  bool synced_ = false;  /*!< Whether the surface has been synced for cpu by ImageRoi(). */
 };  // class CNDataFrame
 
 /**
@@ -183,6 +213,15 @@ class CNInferObject {
    */
   CNInferAttr GetAttribute(const std::string& key);
 
+  /**
+   * @brief Gets all attributes of an object.
+   *
+   * @return Returns all attributes.
+   *
+   * @note This is a thread-safe function.
+   */
+  std::vector<std::pair<std::string, CNInferAttr>> GetAttributes();
+
   /**
    * @brief Adds the key of the extended attribute to a specified object.
    *
@@ -34,6 +34,7 @@ extern "C" {
 };
 #endif
 #include "cnstream_logging.hpp"
+#include "sws_context_cache.hpp"
 
 namespace cnstream {
 
@@ -127,10 +128,12 @@ void YUV420spToRGBx(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int s
   int rgb_linesize[4] = {dst_stride, 0, 0, 0};
   unsigned char *inaddr[4] = {src_y, src_uv, 0, 0};
   unsigned char *outaddr[4] = {dst_rgbx, 0, 0, 0};
-  SwsContext *sws_ctx =
-      sws_getContext(src_w, src_h, src_av_fmt, dst_w, dst_h, dst_av_fmt, SWS_BILINEAR, NULL, NULL, NULL);
+  SwsContext *sws_ctx = GetCachedSwsContext(src_w, src_h, src_av_fmt, dst_w, dst_h, dst_av_fmt, SWS_BILINEAR);
+  if (!sws_ctx) {
+    LOGE(PREPROC) << "YUV420spToRGBx(): Get sws context failed";
+    return;
+  }
   sws_scale(sws_ctx, inaddr, yuv_linesize, 0, src_h, outaddr, rgb_linesize);
-  sws_freeContext(sws_ctx);
 }
 
 void NV12ToBGR24(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int src_stride, uint8_t *dst_bgr24, int dst_w,
@@ -183,6 +183,87 @@ void NV21ToBGR24(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int src_
 void YUV420spToRGBx(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int src_y_stride, int srv_uv_stride,
                     CnedkBufSurfaceColorFormat src_fmt, uint8_t *dst_rgbx, int dst_w, int dst_h, int dst_stride,
                     CnedkBufSurfaceColorFormat dst_fmt);
+/**
+ * @brief The instruction sets used by the CPU preprocessing helpers, NormalizeToFloat and HWCToCHW.
+ */
+enum class PreprocIsa {
+  SCALAR,  /*!< No SIMD instruction. */
+  SSE41,   /*!< SSE4.1 on x86. */
+  AVX2,    /*!< AVX2 on x86. */
+  NEON     /*!< NEON on ARM. */
+};
+/**
+ * @brief Gets the instruction set used by the CPU preprocessing helpers.
+ *
+ * @return Returns the instruction set. It is the best one supported by the CPU unless set by SetPreprocIsa().
+ */
+PreprocIsa GetPreprocIsa();
+/**
+ * @brief Sets the instruction set used by the CPU preprocessing helpers, e.g. to compare the kernels in tests.
+ *
+ * @param[in] isa The instruction set.
+ *
+ * @return Returns true if it is set. Returns false if the CPU or the build does not support it.
+ */
+bool SetPreprocIsa(PreprocIsa isa);
+/**
+ * @brief Converts an image with 8-bit channels to float and normalizes it, dst = (src - mean) / std.
+ *
+ * @param[in] src The data pointer of the source, in HWC layout.
+ * @param[out] dst The data pointer of the destination.
+ * @param[in] pixels The number of pixels, which is height * width.
+ * @param[in] channels The number of channels.
+ * @param[in] mean The mean values of each channel. nullptr means 0.
+ * @param[in] std The std values of each channel. nullptr means 1.
+ * @param[in] chw Whether the destination is in CHW layout. Otherwise it is in HWC layout.
+ *
+ * @return No return value.
+ *
+ * @note AVX2, SSE4.1 or NEON is used if the CPU supports it.
+ */
+void NormalizeToFloat(const uint8_t *src, float *dst, uint32_t pixels, uint32_t channels, const float *mean,
+                      const float *std, bool chw = false);
+/**
+ * @brief Converts an image with 8-bit channels from HWC layout to CHW layout.
+ *
+ * @param[in] src The data pointer of the source.
+ * @param[out] dst The data pointer of the destination.
+ * @param[in] pixels The number of pixels, which is height * width.
+ * @param[in] channels The number of channels.
+ *
+ * @return No return value.
+ *
+ * @note SSE4.1 or NEON is used if the CPU supports it.
+ */
+void HWCToCHW(const uint8_t *src, uint8_t *dst, uint32_t pixels, uint32_t channels);
+/**
+ * @brief Converts an image from YUV420sp NV12/NV21 format to a network input tensor on CPU.
+ *
+ * The image is converted to RGB or BGR and resized into the tensor, keeping the aspect ratio with padding if required.
+ * Then it is normalized and converted to the data type and the layout of the tensor.
+ *
+ * @param[in] src_y The y plane pointer of the source.
+ * @param[in] src_uv The uv plane pointer of the source.
+ * @param[in] src_w The width of the source.
+ * @param[in] src_h The height of the source.
+ * @param[in] src_y_stride The stride of y plane of the source.
+ * @param[in] src_uv_stride The stride of uv plane of the source.
+ * @param[in] src_fmt The pixel format of the source.
+ * @param[in] info The information of the network. Only UINT8 and FLOAT32 data types are supported.
+ * @param[in] dst_fmt The pixel format of the network input, RGB or BGR.
+ * @param[in] keep_aspect_ratio Whether to keep the aspect ratio of the source.
+ * @param[in] pad_value The value of padding pixels.
+ * @param[in] mean The mean values of each channel, nullptr means 0. It is valid only for FLOAT32.
+ * @param[in] std The std values of each channel, nullptr means 1. It is valid only for FLOAT32.
+ * @param[in] chw Whether the tensor is in CHW layout. Otherwise it is in HWC layout.
+ * @param[out] dst The data pointer of the tensor.
+ *
+ * @return Returns 0 if this function has run successfully. Otherwise returns -1.
+ */
+int YUV420spToTensor(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int src_y_stride, int src_uv_stride,
+                     CnedkBufSurfaceColorFormat src_fmt, const CnPreprocNetworkInfo &info,
+                     CnedkBufSurfaceColorFormat dst_fmt, bool keep_aspect_ratio, int pad_value, const float *mean,
+                     const float *std, bool chw, void *dst);
 }  // namespace cnstream
 
 #endif  // CNSTREAM_INFERENCE_PREPROC_HPP_
@@ -0,0 +1,423 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CNS_PREPROC_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CNS_PREPROC_NEON
+#endif
+
+#include "cnstream_logging.hpp"
+#include "cnstream_preproc.hpp"
+
+namespace cnstream {
+
+namespace {
+
+constexpr uint32_t kMaxChannels = 4;
+
+// dst = src * scale + bias, which is (src - mean) / std
+struct NormParams {
+  uint32_t channels;
+  float scale[kMaxChannels];
+  float bias[kMaxChannels];
+};
+
+// ------------------------------------- scalar -------------------------------------
+
+void NormalizeHWCScalar(const uint8_t *src, float *dst, uint32_t begin, uint32_t pixels, const NormParams &p) {
+  for (uint32_t i = begin; i < pixels; ++i) {
+    for (uint32_t c = 0; c < p.channels; ++c) {
+      dst[i * p.channels + c] = src[i * p.channels + c] * p.scale[c] + p.bias[c];
+    }
+  }
+}
+
+void NormalizeCHWScalar(const uint8_t *src, float *dst, uint32_t begin, uint32_t pixels, const NormParams &p) {
+  for (uint32_t c = 0; c < p.channels; ++c) {
+    float *plane = dst + c * pixels;
+    for (uint32_t i = begin; i < pixels; ++i) {
+      plane[i] = src[i * p.channels + c] * p.scale[c] + p.bias[c];
+    }
+  }
+}
+
+void HWCToCHWScalar(const uint8_t *src, uint8_t *dst, uint32_t begin, uint32_t pixels, uint32_t channels) {
+  for (uint32_t c = 0; c < channels; ++c) {
+    uint8_t *plane = dst + c * pixels;
+    for (uint32_t i = begin; i < pixels; ++i) {
+      plane[i] = src[i * channels + c];
+    }
+  }
+}
+
+#ifdef CNS_PREPROC_X86
+// ------------------------------------- x86 -------------------------------------
+
+// Shuffle masks to deinterleave 16 packed 3-channel pixels loaded as three 16-byte blocks:
+// channel k of pixel j is byte 3 * j + k, it is picked from block (3 * j + k) / 16.
+struct Deinterleave3Masks {
+  alignas(16) int8_t mask[3][3][16];  // [channel][block][lane]
+  Deinterleave3Masks() {
+    for (int k = 0; k < 3; ++k) {
+      for (int b = 0; b < 3; ++b) {
+        for (int j = 0; j < 16; ++j) {
+          int idx = 3 * j + k - 16 * b;
+          mask[k][b][j] = (idx >= 0 && idx < 16) ? idx : -128;
+        }
+      }
+    }
+  }
+};
+const Deinterleave3Masks g_deinterleave3;
+
+__attribute__((target("sse4.1"))) inline void Deinterleave3(const uint8_t *src, __m128i out[3]) {
+  __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+  __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+  __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+  for (int k = 0; k < 3; ++k) {
+    const __m128i *m = reinterpret_cast<const __m128i *>(g_deinterleave3.mask[k]);
+    __m128i lo = _mm_or_si128(_mm_shuffle_epi8(a0, _mm_load_si128(m)), _mm_shuffle_epi8(a1, _mm_load_si128(m + 1)));
+    out[k] = _mm_or_si128(lo, _mm_shuffle_epi8(a2, _mm_load_si128(m + 2)));
+  }
+}
+
+__attribute__((target("sse4.1"))) void NormalizeHWCSse41(const uint8_t *src, float *dst, uint32_t pixels,
+                                                           const NormParams &p) {
+  // the channel pattern of 4 lanes repeats every `channels` vectors
+  __m128 scale[kMaxChannels], bias[kMaxChannels];
+  for (uint32_t v = 0; v < p.channels; ++v) {
+    float s[4], b[4];
+    for (int l = 0; l < 4; ++l) s[l] = p.scale[(v * 4 + l) % p.channels], b[l] = p.bias[(v * 4 + l) % p.channels];
+    scale[v] = _mm_loadu_ps(s);
+    bias[v] = _mm_loadu_ps(b);
+  }
+  uint32_t i = 0;
+  for (; i + 4 <= pixels; i += 4) {
+    const uint8_t *s = src + i * p.channels;
+    float *d = dst + i * p.channels;
+    for (uint32_t v = 0; v < p.channels; ++v) {
+      int32_t packed;
+      memcpy(&packed, s + v * 4, sizeof(packed));
+      __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+      _mm_storeu_ps(d + v * 4, _mm_add_ps(_mm_mul_ps(f, scale[v]), bias[v]));
+    }
+  }
+  NormalizeHWCScalar(src, dst, i, pixels, p);
+}
+
+__attribute__((target("sse4.1"))) void NormalizeCHWSse41(const uint8_t *src, float *dst, uint32_t pixels,
+                                                           const NormParams &p) {
+  uint32_t i = 0;
+  if (p.channels == 3) {
+    __m128 scale[3], bias[3];
+    for (int k = 0; k < 3; ++k) scale[k] = _mm_set1_ps(p.scale[k]), bias[k] = _mm_set1_ps(p.bias[k]);
+    for (; i + 16 <= pixels; i += 16) {
+      __m128i ch[3];
+      Deinterleave3(src + i * 3, ch);
+      for (int k = 0; k < 3; ++k) {
+        float *d = dst + k * pixels + i;
+        __m128 f0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(ch[k]));
+        __m128 f1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(ch[k], 4)));
+        __m128 f2 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(ch[k], 8)));
+        __m128 f3 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(ch[k], 12)));
+        _mm_storeu_ps(d, _mm_add_ps(_mm_mul_ps(f0, scale[k]), bias[k]));
+        _mm_storeu_ps(d + 4, _mm_add_ps(_mm_mul_ps(f1, scale[k]), bias[k]));
+        _mm_storeu_ps(d + 8, _mm_add_ps(_mm_mul_ps(f2, scale[k]), bias[k]));
+        _mm_storeu_ps(d + 12, _mm_add_ps(_mm_mul_ps(f3, scale[k]), bias[k]));
+      }
+    }
+  }
+  NormalizeCHWScalar(src, dst, i, pixels, p);
+}
+
+__attribute__((target("sse4.1"))) void HWCToCHWSse41(const uint8_t *src, uint8_t *dst, uint32_t pixels,
+                                                       uint32_t channels) {
+  uint32_t i = 0;
+  if (channels == 3) {
+    for (; i + 16 <= pixels; i += 16) {
+      __m128i ch[3];
+      Deinterleave3(src + i * 3, ch);
+      for (int k = 0; k < 3; ++k) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + k * pixels + i), ch[k]);
+      }
+    }
+  }
+  HWCToCHWScalar(src, dst, i, pixels, channels);
+}
+
+__attribute__((target("avx2"))) void NormalizeHWCAvx2(const uint8_t *src, float *dst, uint32_t pixels,
+                                                        const NormParams &p) {
+  // the channel pattern of 8 lanes repeats every `channels` vectors
+  __m256 scale[kMaxChannels], bias[kMaxChannels];
+  for (uint32_t v = 0; v < p.channels; ++v) {
+    float s[8], b[8];
+    for (int l = 0; l < 8; ++l) s[l] = p.scale[(v * 8 + l) % p.channels], b[l] = p.bias[(v * 8 + l) % p.channels];
+    scale[v] = _mm256_loadu_ps(s);
+    bias[v] = _mm256_loadu_ps(b);
+  }
+  uint32_t i = 0;
+  for (; i + 8 <= pixels; i += 8) {
+    const uint8_t *s = src + i * p.channels;
+    float *d = dst + i * p.channels;
+    for (uint32_t v = 0; v < p.channels; ++v) {
+      __m128i u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(s + v * 8));
+      __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(u8));
+      _mm256_storeu_ps(d + v * 8, _mm256_add_ps(_mm256_mul_ps(f, scale[v]), bias[v]));
+    }
+  }
+  NormalizeHWCScalar(src, dst, i, pixels, p);
+}
+
+__attribute__((target("avx2"))) void NormalizeCHWAvx2(const uint8_t *src, float *dst, uint32_t pixels,
+                                                        const NormParams &p) {
+  uint32_t i = 0;
+  if (p.channels == 3) {
+    __m256 scale[3], bias[3];
+    for (int k = 0; k < 3; ++k) scale[k] = _mm256_set1_ps(p.scale[k]), bias[k] = _mm256_set1_ps(p.bias[k]);
+    for (; i + 16 <= pixels; i += 16) {
+      __m128i ch[3];
+      Deinterleave3(src + i * 3, ch);
+      for (int k = 0; k < 3; ++k) {
+        float *d = dst + k * pixels + i;
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(ch[k]));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(ch[k], 8)));
+        _mm256_storeu_ps(d, _mm256_add_ps(_mm256_mul_ps(lo, scale[k]), bias[k]));
+        _mm256_storeu_ps(d + 8, _mm256_add_ps(_mm256_mul_ps(hi, scale[k]), bias[k]));
+      }
+    }
+  }
+  NormalizeCHWScalar(src, dst, i, pixels, p);
+}
+
+#endif  // CNS_PREPROC_X86
+
+#ifdef CNS_PREPROC_NEON
+// ------------------------------------- NEON -------------------------------------
+
+inline void StoreNormalized(uint8x8_t u8, float32x4_t scale_lo, float32x4_t bias_lo, float32x4_t scale_hi,
+                            float32x4_t bias_hi, float *dst) {
+  uint16x8_t u16 = vmovl_u8(u8);
+  float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(u16)));
+  float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(u16)));
+  vst1q_f32(dst, vmlaq_f32(bias_lo, lo, scale_lo));
+  vst1q_f32(dst + 4, vmlaq_f32(bias_hi, hi, scale_hi));
+}
+
+void NormalizeHWCNeon(const uint8_t *src, float *dst, uint32_t pixels, const NormParams &p) {
+  // the channel pattern of 8 lanes repeats every `channels` vectors
+  float32x4_t scale[kMaxChannels][2], bias[kMaxChannels][2];
+  for (uint32_t v = 0; v < p.channels; ++v) {
+    float s[8], b[8];
+    for (int l = 0; l < 8; ++l) s[l] = p.scale[(v * 8 + l) % p.channels], b[l] = p.bias[(v * 8 + l) % p.channels];
+    scale[v][0] = vld1q_f32(s), scale[v][1] = vld1q_f32(s + 4);
+    bias[v][0] = vld1q_f32(b), bias[v][1] = vld1q_f32(b + 4);
+  }
+  uint32_t i = 0;
+  for (; i + 8 <= pixels; i += 8) {
+    const uint8_t *s = src + i * p.channels;
+    float *d = dst + i * p.channels;
+    for (uint32_t v = 0; v < p.channels; ++v) {
+      StoreNormalized(vld1_u8(s + v * 8), scale[v][0], bias[v][0], scale[v][1], bias[v][1], d + v * 8);
+    }
+  }
+  NormalizeHWCScalar(src, dst, i, pixels, p);
+}
+
+void NormalizeCHWNeon(const uint8_t *src, float *dst, uint32_t pixels, const NormParams &p) {
+  uint32_t i = 0;
+  if (p.channels == 3) {
+    float32x4_t scale[3], bias[3];
+    for (int k = 0; k < 3; ++k) scale[k] = vdupq_n_f32(p.scale[k]), bias[k] = vdupq_n_f32(p.bias[k]);
+    for (; i + 8 <= pixels; i += 8) {
+      uint8x8x3_t ch = vld3_u8(src + i * 3);
+      for (int k = 0; k < 3; ++k) {
+        StoreNormalized(ch.val[k], scale[k], bias[k], scale[k], bias[k], dst + k * pixels + i);
+      }
+    }
+  }
+  NormalizeCHWScalar(src, dst, i, pixels, p);
+}
+
+void HWCToCHWNeon(const uint8_t *src, uint8_t *dst, uint32_t pixels, uint32_t channels) {
+  uint32_t i = 0;
+  if (channels == 3) {
+    for (; i + 16 <= pixels; i += 16) {
+      uint8x16x3_t ch = vld3q_u8(src + i * 3);
+      for (int k = 0; k < 3; ++k) vst1q_u8(dst + k * pixels + i, ch.val[k]);
+    }
+  }
+  HWCToCHWScalar(src, dst, i, pixels, channels);
+}
+#endif  // CNS_PREPROC_NEON
+
+bool IsaSupported(PreprocIsa isa) {
+  switch (isa) {
+    case PreprocIsa::SCALAR:
+      return true;
+#if defined(CNS_PREPROC_X86)
+    case PreprocIsa::SSE41:
+      return __builtin_cpu_supports("sse4.1");
+    case PreprocIsa::AVX2:
+      return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("avx2");
+#elif defined(CNS_PREPROC_NEON)
+    case PreprocIsa::NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+PreprocIsa BestIsa() {
+  for (PreprocIsa isa : {PreprocIsa::AVX2, PreprocIsa::SSE41, PreprocIsa::NEON}) {
+    if (IsaSupported(isa)) return isa;
+  }
+  return PreprocIsa::SCALAR;
+}
+
+// the best instruction set supported by the CPU is used by default
+std::atomic<PreprocIsa> &CurrentIsa() {
+  static std::atomic<PreprocIsa> isa(BestIsa());
+  return isa;
+}
+
+}  // namespace
+
+PreprocIsa GetPreprocIsa() { return CurrentIsa(); }
+
+bool SetPreprocIsa(PreprocIsa isa) {
+  if (!IsaSupported(isa)) return false;
+  CurrentIsa() = isa;
+  return true;
+}
+
+void NormalizeToFloat(const uint8_t *src, float *dst, uint32_t pixels, uint32_t channels, const float *mean,
+                      const float *std, bool chw) {
+  if (!src || !dst || channels == 0 || channels > kMaxChannels) {
+    LOGE(PREPROC) << "NormalizeToFloat(): Invalid parameters, channels = " << channels;
+    return;
+  }
+  NormParams p;
+  p.channels = channels;
+  for (uint32_t c = 0; c < channels; ++c) {
+    float s = std ? std[c] : 1.f;
+    float m = mean ? mean[c] : 0.f;
+    p.scale[c] = 1.f / s;
+    p.bias[c] = -m / s;
+  }
+  if (chw && channels == 1) chw = false;  // the same layout
+  switch (CurrentIsa().load()) {
+#if defined(CNS_PREPROC_X86)
+    case PreprocIsa::AVX2:
+      chw ? NormalizeCHWAvx2(src, dst, pixels, p) : NormalizeHWCAvx2(src, dst, pixels, p);
+      return;
+    case PreprocIsa::SSE41:
+      chw ? NormalizeCHWSse41(src, dst, pixels, p) : NormalizeHWCSse41(src, dst, pixels, p);
+      return;
+#elif defined(CNS_PREPROC_NEON)
+    case PreprocIsa::NEON:
+      chw ? NormalizeCHWNeon(src, dst, pixels, p) : NormalizeHWCNeon(src, dst, pixels, p);
+      return;
+#endif
+    default:
+      chw ? NormalizeCHWScalar(src, dst, 0, pixels, p) : NormalizeHWCScalar(src, dst, 0, pixels, p);
+  }
+}
+
+void HWCToCHW(const uint8_t *src, uint8_t *dst, uint32_t pixels, uint32_t channels) {
+  if (!src || !dst || channels == 0) return;
+  if (channels == 1) {
+    memcpy(dst, src, pixels);
+    return;
+  }
+  switch (CurrentIsa().load()) {
+#if defined(CNS_PREPROC_X86)
+    case PreprocIsa::AVX2:  // no AVX2 kernel, the SSE4.1 one is used
+    case PreprocIsa::SSE41:
+      HWCToCHWSse41(src, dst, pixels, channels);
+      return;
+#elif defined(CNS_PREPROC_NEON)
+    case PreprocIsa::NEON:
+      HWCToCHWNeon(src, dst, pixels, channels);
+      return;
+#endif
+    default:
+      HWCToCHWScalar(src, dst, 0, pixels, channels);
+  }
+}
+
+int YUV420spToTensor(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int src_y_stride, int src_uv_stride,
+                     CnedkBufSurfaceColorFormat src_fmt, const CnPreprocNetworkInfo &info,
+                     CnedkBufSurfaceColorFormat dst_fmt, bool keep_aspect_ratio, int pad_value, const float *mean,
+                     const float *std, bool chw, void *dst) {
+  if (info.c != 3 || (info.dtype != infer_server::DataType::UINT8 && info.dtype != infer_server::DataType::FLOAT32)) {
+    LOGE(PREPROC) << "YUV420spToTensor(): Only UINT8 and FLOAT32 tensors with 3 channels are supported";
+    return -1;
+  }
+  uint32_t pixels = info.w * info.h;
+  size_t img_size = pixels * info.c;
+  // the packed 8-bit image is written to the tensor directly if no further conversion is needed
+  bool direct = info.dtype == infer_server::DataType::UINT8 && !chw;
+  thread_local std::vector<uint8_t> workspace;
+  uint8_t *img = reinterpret_cast<uint8_t *>(dst);
+  if (!direct) {
+    if (workspace.size() < img_size) workspace.resize(img_size);
+    img = workspace.data();
+  }
+
+  CnedkTransformRect dst_bbox;
+  uint8_t *img_roi = img;
+  if (keep_aspect_ratio) {
+    dst_bbox = KeepAspectRatio(src_w, src_h, info.w, info.h);
+    // validate bbox
+    dst_bbox.left -= dst_bbox.left & 1;
+    dst_bbox.top -= dst_bbox.top & 1;
+    dst_bbox.width -= dst_bbox.width & 1;
+    dst_bbox.height -= dst_bbox.height & 1;
+    while (dst_bbox.left + dst_bbox.width > info.w) dst_bbox.width -= 2;
+    while (dst_bbox.top + dst_bbox.height > info.h) dst_bbox.height -= 2;
+    img_roi = img + dst_bbox.left * info.c + dst_bbox.top * info.w * info.c;
+    // padding is needed only if the image does not fill the tensor
+    if (dst_bbox.width != info.w || dst_bbox.height != info.h) memset(img, pad_value, img_size);
+  } else {
+    dst_bbox.left = 0;
+    dst_bbox.top = 0;
+    dst_bbox.width = info.w;
+    dst_bbox.height = info.h;
+  }
+
+  YUV420spToRGBx(src_y, src_uv, src_w, src_h, src_y_stride, src_uv_stride, src_fmt, img_roi, dst_bbox.width,
+                 dst_bbox.height, info.w * info.c, dst_fmt);
+
+  if (info.dtype == infer_server::DataType::FLOAT32) {
+    NormalizeToFloat(img, reinterpret_cast<float *>(dst), pixels, info.c, mean, std, chw);
+  } else if (chw) {
+    HWCToCHW(img, reinterpret_cast<uint8_t *>(dst), pixels, info.c);
+  }
+  return 0;
+}
+
+}  // namespace cnstream
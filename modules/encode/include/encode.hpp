@@ -48,6 +48,7 @@ struct VEncParam {
   int gop_size = 10;                 // Target gop, default is 10
   int tile_cols = 0;                 // Grids in horizontally of video tiling, only support cpu input
   int tile_rows = 0;                 // Grids in vertically of video tiling, only support cpu input
+  std::string tile_color = "nv12";   // Color format of the canvas of video tiling, nv12, nv21, i420 or bgr
   bool resample = false;             // Resample frame with canvas, only support cpu input
   std::string file_name = "";        // File name to encode to
   int rtsp_port = -1;                // rtsp output port
@@ -128,6 +129,7 @@ class VEncode : public ModuleEx, public ModuleCreator<VEncode> {
   int stream_index_ = 0;
   std::unique_ptr<Tiler> tiler_ = nullptr;
   bool tiler_enable_ = false;
+  std::unique_ptr<TilerTimer> tiler_timer_ = nullptr;  // sends the canvas of tiling at the frame rate
   const std::string tiler_key_name_ = "tiler";
 };  // class VEncode
 
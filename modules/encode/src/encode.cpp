@@ -21,10 +21,12 @@
 
 #include <algorithm>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "cnedk_buf_surface_util.hpp"
 #include "cnedk_platform.h"
 
 #include "cnstream_frame_va.hpp"
@@ -51,6 +53,39 @@ static inline int64_t CurrentTick() {
       std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
+static bool GetTileColor(const std::string &name, Scaler::ColorFormat *color) {
+  static const std::map<std::string, Scaler::ColorFormat> color_map = {
+      {"nv12", Scaler::ColorFormat::YUV_NV12},
+      {"nv21", Scaler::ColorFormat::YUV_NV21},
+      {"i420", Scaler::ColorFormat::YUV_I420},
+      {"bgr", Scaler::ColorFormat::BGR},
+  };
+  auto iter = color_map.find(name);
+  if (iter == color_map.end()) return false;
+  *color = iter->second;
+  return true;
+}
+
+// Gets the planes of a YUV420SP frame, which are scaled to the canvas directly instead of the BGR image
+static bool FrameToYUVBuffer(CNDataFramePtr frame, Scaler::Buffer *buffer) {
+  // the BGR image may have been drawn on by other modules
+  if (frame->HasBGRImage()) return false;
+  CnedkBufSurfaceColorFormat fmt = frame->buf_surf->GetColorFormat();
+  if (fmt != CNEDK_BUF_COLOR_FORMAT_NV12 && fmt != CNEDK_BUF_COLOR_FORMAT_NV21) return false;
+
+  CnedkBufSurfaceSyncForCpu(frame->buf_surf->GetBufSurface(), -1, -1);
+  buffer->width = frame->buf_surf->GetWidth();
+  buffer->height = frame->buf_surf->GetHeight();
+  buffer->color = fmt == CNEDK_BUF_COLOR_FORMAT_NV12 ? Scaler::ColorFormat::YUV_NV12 : Scaler::ColorFormat::YUV_NV21;
+  buffer->data[0] = static_cast<uint8_t *>(frame->buf_surf->GetHostData(0));
+  buffer->data[1] = static_cast<uint8_t *>(frame->buf_surf->GetHostData(1));
+  buffer->data[2] = nullptr;
+  buffer->stride[0] = frame->buf_surf->GetStride(0);
+  buffer->stride[1] = frame->buf_surf->GetStride(1);
+  buffer->stride[2] = 0;
+  return true;
+}
+
 class VEncodeImplement {
  public:
   VEncodeImplement() {}
@@ -288,6 +323,9 @@ VEncode::VEncode(const std::string &name) : ModuleEx(name) {
        OFFSET(VEncParam, tile_cols), ModuleParamParser<int>::Parser, "int"},
       {"view_rows", "1", "Grids in vertically of video tiling, only support cpu input.", PARAM_OPTIONAL,
        OFFSET(VEncParam, tile_rows), ModuleParamParser<int>::Parser, "int"},
+      {"view_color", "nv12", "Color format of the canvas of video tiling, nv12, nv21, i420 or bgr. "
+       "Hardware encoding only supports nv12 and nv21.", PARAM_OPTIONAL,
+       OFFSET(VEncParam, tile_color), ModuleParamParser<std::string>::Parser, "string"},
       {"resample", "false", "Resample. If set true, some frame will be dropped.", PARAM_OPTIONAL,
        OFFSET(VEncParam, resample), ModuleParamParser<bool>::Parser, "bool"},
       {"frame_rate", "25", "Frame rate of video encoding. Higher value means more fluent.", PARAM_OPTIONAL,
@@ -336,6 +374,17 @@ bool VEncode::CheckParamSet(const ModuleParamSet& param_set) const {
     return false;
   }
 
+  Scaler::ColorFormat tile_color;
+  if (!GetTileColor(params.tile_color, &tile_color)) {
+    LOGE(VENC) << "[" << GetName() << "] view_color " << params.tile_color << " is not supported.";
+    return false;
+  }
+  if (params.mlu_encoder && tile_color != Scaler::ColorFormat::YUV_NV12 &&
+      tile_color != Scaler::ColorFormat::YUV_NV21) {
+    LOGE(VENC) << "[" << GetName() << "] hardware encoding only supports nv12 and nv21 view_color.";
+    return false;
+  }
+
   if (params.mlu_encoder) {
     uint32_t dev_cnt = 0;
     if (cnrtGetDeviceCount(&dev_cnt) != cnrtSuccess || params.device_id < 0 ||
@@ -350,6 +399,8 @@ bool VEncode::CheckParamSet(const ModuleParamSet& param_set) const {
 
 void VEncode::Close() {
   if (tiler_) {
+    // no canvas is sent after the eos
+    tiler_timer_.reset();
     Scaler::Buffer* encode_buffer = nullptr;
     ivenc_[tiler_key_name_]->SendFrame(encode_buffer);
     ivenc_[tiler_key_name_]->Close();
@@ -412,8 +463,9 @@ int VEncode::Process(std::shared_ptr<CNFrameInfo> data) {
         height = frame->buf_surf->GetHeight();
       }
 
-      tiler_.reset(new (std::nothrow) Tiler(params.tile_cols, params.tile_rows,
-                                            Scaler::ColorFormat::YUV_NV12, width, height));
+      Scaler::ColorFormat tile_color = Scaler::ColorFormat::YUV_NV12;
+      GetTileColor(params.tile_color, &tile_color);
+      tiler_.reset(new (std::nothrow) Tiler(params.tile_cols, params.tile_rows, tile_color, width, height));
 
       VEncImplParam iparam;
       iparam.venc_param = params;
@@ -423,7 +475,15 @@ int VEncode::Process(std::shared_ptr<CNFrameInfo> data) {
       iparam.stream_height = frame->buf_surf->GetHeight();
       iparam.stream_width = frame->buf_surf->GetWidth();
       ivenc_[tiler_key_name_]->SetParams(iparam);
-
+      ivenc_[tiler_key_name_]->SetFrameRate(params.frame_rate);
+
+      if (tiler_) {
+        // the canvas is sent at the frame rate by a timer of this module, whether frames arrive or not
+        std::shared_ptr<VEncodeImplement> ivenc = ivenc_[tiler_key_name_];
+        auto send = [ivenc](Scaler::Buffer *canvas) { ivenc->SendFrame(canvas); };
+        tiler_timer_.reset(new (std::nothrow) TilerTimer(tiler_.get(), params.frame_rate, send));
+        if (tiler_timer_) tiler_timer_->Start();
+      }
     } else if (!tiler_enable_ && !ivenc_.count(data->stream_id)) {  // create normal context
       VEncImplParam iparam;
       ivenc_[data->stream_id] = std::make_shared<VEncodeImplement>();
@@ -438,22 +498,13 @@ int VEncode::Process(std::shared_ptr<CNFrameInfo> data) {
     guard.unlock();
 
     if (tiler_) {   // enable tiler
-      std::unique_lock<std::mutex> lk(venc_mutex_);
       CNDataFramePtr frame = data->collection.Get<CNDataFramePtr>(kCNDataFrameTag);
       Scaler::Buffer buffer;
-      Scaler::MatToBuffer(frame->ImageBGR(), Scaler::ColorFormat::BGR, &buffer);
-
-      tiler_->Blit(&buffer, data->GetStreamIndex());
-      static int64_t last_tick = 0;
-      int64_t tick = CurrentTick();
-      if ((tick - last_tick) >= (1000 / params.frame_rate)) {
-        Scaler::Buffer* encode_buffer = tiler_->GetCanvas();
-        ivenc_[tiler_key_name_]->SetFrameRate(params.frame_rate);
-        ivenc_[tiler_key_name_]->SendFrame(encode_buffer);
-        tiler_->ReleaseCanvas();
-        last_tick = tick;
+      if (!FrameToYUVBuffer(frame, &buffer)) {
+        Scaler::MatToBuffer(frame->ImageBGR(), Scaler::ColorFormat::BGR, &buffer);
       }
-      lk.unlock();
+      // streams blit concurrently, the canvas is sent by the timer
+      tiler_->Blit(&buffer, data->GetStreamIndex());
     } else {
       ivenc_[data->stream_id]->SetFrameRate(params.frame_rate);
       ivenc_[data->stream_id]->SendFrame(data);
@@ -466,6 +517,10 @@ int VEncode::Process(std::shared_ptr<CNFrameInfo> data) {
     }
     frame_rate_guard.unlock();
 
+    std::unique_lock<std::mutex> guard(venc_mutex_);
+    if (tiler_) tiler_->ClearGrid(data->GetStreamIndex());  // the grid of the removed stream is left blank
+    guard.unlock();
+
     auto iter = ivenc_.find(data->stream_id);
     if (iter != ivenc_.end()) {
       ivenc_[data->stream_id]->SendFrame(data);
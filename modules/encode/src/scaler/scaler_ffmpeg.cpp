@@ -34,6 +34,7 @@ extern "C" {
 #endif
 
 #include "scaler.hpp"
+#include "sws_context_cache.hpp"
 
 namespace cnstream {
 
@@ -115,9 +116,8 @@ bool FFmpegProcess(const Scaler::Buffer *src, Scaler::Buffer *dst) {
     }
   }
 
-  SwsContext *sws_ctx = sws_getContext(src->width, src->height, ffmpeg_color_map[src->color],
-                                       dst->width, dst->height, ffmpeg_color_map[dst->color],
-                                       SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+  SwsContext *sws_ctx = GetCachedSwsContext(src->width, src->height, ffmpeg_color_map[src->color],
+                                            dst->width, dst->height, ffmpeg_color_map[dst->color], SWS_FAST_BILINEAR);
   if (!sws_ctx) {
     LOGE(ScalerFFmpeg) << "FFmpegProcess() sws_getContext failed";
     return false;
@@ -128,8 +128,6 @@ bool FFmpegProcess(const Scaler::Buffer *src, Scaler::Buffer *dst) {
     return false;
   }
 
-  if (sws_ctx) sws_freeContext(sws_ctx);
-
   return true;
 }
 
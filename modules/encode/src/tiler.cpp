@@ -25,16 +25,43 @@
 #include <opencv2/imgcodecs/imgcodecs.hpp>
 #endif
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "cnstream_logging.hpp"
 
 namespace cnstream {
 
-static thread_local std::unique_ptr<uint8_t[]> tl_grid_buffer = nullptr;
-static thread_local uint32_t tl_grid_buffer_size = 0;
+// Gets the regions in bytes covered by the rect on each plane of the canvas, returns the number of planes.
+// Chroma of YUV formats is rounded out to the 2x2 blocks touched by the rect.
+static int GetPlaneRects(Tiler::ColorFormat color, uint32_t width, uint32_t height, const Tiler::Rect &grid,
+                         Tiler::Rect plane_rects[3]) {
+  Tiler::Rect rect;
+  rect.x = std::max(grid.x, 0);
+  rect.y = std::max(grid.y, 0);
+  rect.w = std::min(grid.x + grid.w, static_cast<int>(width)) - rect.x;
+  rect.h = std::min(grid.y + grid.h, static_cast<int>(height)) - rect.y;
+  if (rect.w <= 0 || rect.h <= 0) return 0;
+  int cx0 = rect.x / 2, cx1 = std::min((rect.x + rect.w + 1) / 2, static_cast<int>(width / 2));
+  int cy0 = rect.y / 2, cy1 = std::min((rect.y + rect.h + 1) / 2, static_cast<int>(height / 2));
+  if (color == Tiler::ColorFormat::YUV_I420) {
+    plane_rects[0] = rect;
+    plane_rects[1] = Tiler::Rect(cx0, cy0, cx1 - cx0, cy1 - cy0);
+    plane_rects[2] = plane_rects[1];
+    return 3;
+  } else if (color <= Tiler::ColorFormat::YUV_NV21) {
+    plane_rects[0] = rect;
+    plane_rects[1] = Tiler::Rect(cx0 * 2, cy0, (cx1 - cx0) * 2, cy1 - cy0);
+    return 2;
+  }
+  int bpp = color <= Tiler::ColorFormat::RGB ? 3 : 4;
+  plane_rects[0] = Tiler::Rect(rect.x * bpp, rect.y, rect.w * bpp, rect.h);
+  return 1;
+}
 
 Tiler::Tiler(uint32_t cols, uint32_t rows, ColorFormat color, uint32_t width, uint32_t height, uint32_t stride)
     : cols_(cols), rows_(rows), color_(color), width_(width), height_(height), stride_(stride) {
@@ -147,6 +174,21 @@ void Tiler::Init() {
     }
   }
 
+  dirty_grids_.assign(grids_.size(), false);
+  grid_mtxs_.reset(new std::mutex[grids_.size()]);
+  grid_buffers_.clear();
+  for (const auto &grid : grids_) {
+    uint32_t grid_size = std::max(grid.w, 0) * std::max(grid.h, 0);
+    if (color_ <= ColorFormat::YUV_NV21) {
+      grid_size = grid_size * 3 / 2;
+    } else if (color_ <= ColorFormat::RGB) {
+      grid_size = grid_size * 3;
+    } else {
+      grid_size = grid_size * 4;
+    }
+    grid_buffers_.emplace_back(new uint8_t[grid_size]);
+  }
+
   Scaler::SetCarrier(Scaler::LIBYUV);
 }
 
@@ -156,19 +198,19 @@ Tiler::~Tiler() {
     if (canvas_buffers_[i].data[0]) delete[] canvas_buffers_[i].data[0];
   }
   grids_.clear();
-  grid_buffer_count_ = 0;
   canvas_index_ = 0;
-  canvas_diff_ = 0;
+  dirty_grids_.clear();
 }
 
 bool Tiler::Blit(const Buffer *buffer, int position) {
-  if (static_cast<size_t>(position) >= grids_.size()) return false;
-  mtx_.lock();
-  if (position > static_cast<int>(grids_.size()) - 1) {
-    LOGE(Tiler) << "Input position is out of max position";
+  if (position >= static_cast<int>(grids_.size())) {
+    LOGE(Tiler) << "Tiler::Blit() input position is out of max position";
+    return false;
   }
+  mtx_.lock();
   if (position < 0) position = (last_position_ + 1) % grids_.size();
   last_position_ = position;
+  mtx_.unlock();
 
   Rect *grid = &grids_[position];
   Buffer grid_buffer;
@@ -179,35 +221,18 @@ bool Tiler::Blit(const Buffer *buffer, int position) {
   grid_buffer.stride[1] = 0;
   grid_buffer.stride[2] = 0;
 
-  uint32_t grid_buffer_size;
+  // blits to different grids run concurrently, the ones to the same grid are serialized as they share the buffer
+  std::lock_guard<std::mutex> grid_lk(grid_mtxs_[position]);
+  uint8_t *data = grid_buffers_[position].get();
   if (color_ <= ColorFormat::YUV_NV21) {
-    grid_buffer_size = grid->w * grid->h * 3 / 2;
-  } else if (color_ <= ColorFormat::RGB) {
-    grid_buffer_size = grid->w * grid->h * 3;
-  } else {
-    grid_buffer_size = grid->w * grid->h * 4;
-  }
-  if (tl_grid_buffer_size < grid_buffer_size) {
-    // LOG(INFO) << "Tiler::Blit() update grid_buffer_size to " << grid_buffer_size;
-    if (!tl_grid_buffer && ++grid_buffer_count_ >= static_cast<int>(cols_ * rows_ * 4)) {
-      LOGE(Tiler) << "Tiler::Blit() only support no more than 4 threads per grid to blit canvas";
-      mtx_.unlock();
-      return false;
-    }
-    tl_grid_buffer.reset(new uint8_t[grid_buffer_size]);
-    tl_grid_buffer_size = grid_buffer_size;
-  }
-
-  if (color_ <= ColorFormat::YUV_NV21) {
-    grid_buffer.data[0] = tl_grid_buffer.get();
-    grid_buffer.data[1] = tl_grid_buffer.get() + grid->w * grid->h;
+    grid_buffer.data[0] = data;
+    grid_buffer.data[1] = data + grid->w * grid->h;
     if (color_ == ColorFormat::YUV_I420) {
-      grid_buffer.data[2] = tl_grid_buffer.get() + grid->w * grid->h * 5 / 4;
+      grid_buffer.data[2] = data + grid->w * grid->h * 5 / 4;
     }
   } else {
-    grid_buffer.data[0] = tl_grid_buffer.get();
+    grid_buffer.data[0] = data;
   }
-  mtx_.unlock();
 
   if (!Scaler::Process(buffer, &grid_buffer)) {
     LOGE(Tiler) << "Tiler::Blit() scaler process src to grid failed";
@@ -219,8 +244,16 @@ bool Tiler::Blit(const Buffer *buffer, int position) {
     LOGE(Tiler) << "Tiler::Blit() scaler process grid to canvas failed";
     return false;
   }
-  if (!canvas_locked_) canvas_diff_++;
+  dirty_grids_[position] = true;
+
+  return true;
+}
 
+bool Tiler::ClearGrid(int position) {
+  if (position < 0 || static_cast<size_t>(position) >= grids_.size()) return false;
+  std::lock_guard<std::mutex> lk(buf_mtx_);
+  FillGrid(&canvas_buffers_[canvas_index_], grids_[position]);
+  dirty_grids_[position] = true;
   return true;
 }
 
@@ -230,13 +263,11 @@ Tiler::Buffer *Tiler::GetCanvas(Buffer *buffer) {
     int canvas_index = (canvas_index_ + 1) % 2;
     if (!canvas_locked_) {
       Buffer *canvas_buffer = &canvas_buffers_[canvas_index_];
-      if (canvas_diff_ > 0) {
-        // LOG(INFO) << "Tiler::GetCanvas() canvas_diff=" << canvas_diff_ << ", need update canvas";
-        // TODO(hqw): only copy diff grids
-        if (!Scaler::Process(canvas_buffer, &canvas_buffers_[canvas_index])) {
-          LOGE(Tiler) << "Tiler::GetCanvas() scaler process canvas_buffers_ failed";
-        }
-        canvas_diff_ = 0;
+      // the other canvas is the same as this one except for the grids updated since the last fetch
+      for (size_t i = 0; i < grids_.size(); ++i) {
+        if (!dirty_grids_[i]) continue;
+        CopyGrid(canvas_buffer, &canvas_buffers_[canvas_index], grids_[i]);
+        dirty_grids_[i] = false;
       }
       canvas_index_ = canvas_index;
       canvas_locked_ = true;
@@ -258,6 +289,30 @@ void Tiler::ReleaseCanvas() {
   if (canvas_locked_) canvas_locked_ = false;
 }
 
+void Tiler::CopyGrid(const Buffer *src, Buffer *dst, const Rect &grid) {
+  Rect plane_rects[3];
+  int plane_num = GetPlaneRects(color_, width_, height_, grid, plane_rects);
+  for (int i = 0; i < plane_num; ++i) {
+    const Rect &rect = plane_rects[i];
+    for (int y = rect.y; y < rect.y + rect.h; ++y) {
+      memcpy(dst->data[i] + y * dst->stride[i] + rect.x, src->data[i] + y * src->stride[i] + rect.x, rect.w);
+    }
+  }
+}
+
+void Tiler::FillGrid(Buffer *dst, const Rect &grid) {
+  Rect plane_rects[3];
+  int plane_num = GetPlaneRects(color_, width_, height_, grid, plane_rects);
+  for (int i = 0; i < plane_num; ++i) {
+    const Rect &rect = plane_rects[i];
+    // the same as the canvas is initialized with
+    uint8_t value = (i > 0 && color_ <= ColorFormat::YUV_NV21) ? 0x80 : 0;
+    for (int y = rect.y; y < rect.y + rect.h; ++y) {
+      memset(dst->data[i] + y * dst->stride[i] + rect.x, value, rect.w);
+    }
+  }
+}
+
 void Tiler::DumpCanvas() {
   static const int yuv_to_bgr_color_map[3] = {
       cv::COLOR_YUV2BGR_I420,
@@ -287,4 +342,47 @@ void Tiler::DumpCanvas() {
   index++;
 }
 
+// the frame rate used by the encoder when it is not set
+static constexpr double kDefaultTilerFrameRate = 25;
+
+TilerTimer::TilerTimer(Tiler *tiler, double frame_rate, Sender sender)
+    : tiler_(tiler),
+      interval_(static_cast<int64_t>(1e6 / (frame_rate > 0 ? frame_rate : kDefaultTilerFrameRate))),
+      sender_(std::move(sender)) {}
+
+TilerTimer::~TilerTimer() { Stop(); }
+
+void TilerTimer::Start() {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (running_) return;
+  running_ = true;
+  thread_ = std::thread(&TilerTimer::Loop, this);
+}
+
+void TilerTimer::Stop() {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    running_ = false;
+  }
+  cond_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+void TilerTimer::Loop() {
+  auto next_tick = std::chrono::steady_clock::now() + interval_;
+  std::unique_lock<std::mutex> lk(mtx_);
+  while (running_) {
+    if (cond_.wait_until(lk, next_tick, [this] { return !running_; })) break;
+    lk.unlock();
+    Tiler::Buffer *canvas = tiler_->GetCanvas();
+    sender_(canvas);
+    tiler_->ReleaseCanvas();
+    // advance by the interval rather than from now, so the cadence does not drift with the time of sending
+    auto now = std::chrono::steady_clock::now();
+    next_tick += interval_;
+    if (next_tick <= now) next_tick = now + interval_;
+    lk.lock();
+  }
+}
+
 }  // namespace cnstream
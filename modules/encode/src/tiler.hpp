@@ -22,8 +22,13 @@
 #define __TILER_H__
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 #include "scaler/scaler.hpp"
@@ -42,12 +47,18 @@ class Tiler {
   ~Tiler();
 
   bool Blit(const Buffer *buffer, int position);
+  /**
+   * @brief Fills the grid with blank, e.g. when the stream drawn in the grid is removed.
+   */
+  bool ClearGrid(int position);
   Buffer *GetCanvas(Buffer *buffer = nullptr);
   void ReleaseCanvas();
 
  private:
   void Init();
   void DumpCanvas();
+  void CopyGrid(const Buffer *src, Buffer *dst, const Rect &grid);
+  void FillGrid(Buffer *dst, const Rect &grid);
 
   uint32_t cols_, rows_;
   std::vector<Rect> grids_;
@@ -56,14 +67,45 @@ class Tiler {
 
   std::mutex mtx_;
   int last_position_ = 0;
-  int grid_buffer_count_ = 0;
+  // scaled input of each grid before it is copied to the canvas
+  std::vector<std::unique_ptr<uint8_t[]>> grid_buffers_;
+  std::unique_ptr<std::mutex[]> grid_mtxs_;
   std::mutex buf_mtx_;
   std::atomic<int> canvas_index_{0};
   std::atomic<bool> canvas_locked_{false};
-  int canvas_diff_ = 0;
+  // grids updated in the canvas being drawn since the last fetch, only they are copied to the other canvas
+  std::vector<bool> dirty_grids_;
   Buffer canvas_buffers_[2];
 };
 
+/**
+ * @brief Sends the canvas of a tiler at a fixed frame rate in a thread of its own, whether frames arrive or not.
+ */
+class TilerTimer {
+ public:
+  using Sender = std::function<void(Tiler::Buffer *canvas)>;
+
+  TilerTimer(Tiler *tiler, double frame_rate, Sender sender);
+  ~TilerTimer();
+
+  void Start();
+  /**
+   * @brief Stops the thread, no canvas is sent after it returns.
+   */
+  void Stop();
+
+ private:
+  void Loop();
+
+  Tiler *tiler_;
+  std::chrono::microseconds interval_;
+  Sender sender_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  bool running_ = false;
+  std::thread thread_;
+};
+
 }  // namespace cnstream
 
 #endif  // __TILER_H__
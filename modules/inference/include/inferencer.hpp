@@ -50,10 +50,17 @@ typedef struct InferParams {
   uint32_t device_id = 0;
   uint32_t priority = 0;
   uint32_t engine_num = 1;
+  std::string backend = "infer_server";
   uint32_t interval = 0;
+  float motion_threshold = 0.f;  ///< 0 means motion gating is disabled
+  uint32_t motion_max_skip = 30;
+  uint32_t cache_ttl = 0;  ///< 0 means the cache of secondary inference is disabled
+  float cache_refresh_score = 0.f;
+  float cache_iou = 0.5f;
   bool show_stats = false;
   InferBatchStrategy batch_strategy = InferBatchStrategy::DYNAMIC;
   uint32_t batch_timeout = 1000;  ///< only support in dynamic batch strategy
+  uint32_t latency_budget = 0;  ///< only support in dynamic batch strategy, 0 means disabled
   InferVideoPixelFmt input_format = infer_server::NetworkInputFormat::BGR;
   std::string model_path = "";
   std::vector<std::string> label_path;
@@ -70,7 +77,7 @@ typedef struct InferParams {
   std::unordered_map<std::string, std::string> custom_postproc_params;
 } InferParams;
 
-class InferObserver;
+class InferBackend;
 
 /**
  * @brief for inference based on infer_server.
@@ -143,22 +150,43 @@ class Inferencer : public ModuleEx,
   int OnPostproc(const std::vector<infer_server::InferData *> &data_vec,
                  const infer_server::ModelIO &model_output,
                  const infer_server::ModelInfo *model_info) override;
+  /**
+   * @brief Runs postprocessing of a batch. objects is empty for primary inference.
+   */
+  int Postprocess(const NetOutputs &net_outputs, const infer_server::ModelInfo &model_info,
+                  const std::vector<CNFrameInfoPtr> &packages, const std::vector<CNInferObjectPtr> &objects);
 
-  void OnProcessDone(const CNFrameInfoPtr data) {
-    this->TransmitData(data);
-  }
+  void OnProcessDone(const CNFrameInfoPtr data);
 
  private:
+  struct StreamContext;
+  /**
+   * @brief Returns true if the frame changed and should be inferred.
+   */
+  bool DetectMotion(StreamContext *ctx, const CNDataFramePtr &frame);
+  /**
+   * @brief Saves the detections of inferred frames, and copies them to frames skipped by motion gating.
+   *
+   * @note It is called with StreamContext::mtx locked.
+   */
+  void UpdateMotionDetections(StreamContext *ctx, const CNFrameInfoPtr &data);
+  /**
+   * @brief Transmits a frame which is not inferred without passing it to the backend. It is transmitted after the
+   *        inferred frames of the stream ahead of it are done.
+   */
+  void Bypass(StreamContext *ctx, const CNFrameInfoPtr &data);
+  void TransmitLocked(StreamContext *ctx, const CNFrameInfoPtr &data);
+
   std::unique_ptr<ModuleParamsHelper<InferParams>> param_helper_ = nullptr;
-  std::unique_ptr<infer_server::InferServer> server_ = nullptr;
-  infer_server::Session_t session_ = nullptr;
-  std::shared_ptr<InferObserver> observer_ = nullptr;
+  std::unique_ptr<InferBackend> backend_;
   std::shared_ptr<ObjectFilterVideo> filter_ = nullptr;
   std::shared_ptr<Preproc> preproc_ = nullptr;
   std::shared_ptr<Postproc> postproc_ = nullptr;
   LabelStrings label_strings_;
-  std::map<std::string, uint32_t> drop_cnt_map_;
-  std::mutex drop_cnt_map_mtx_;
+  bool motion_gating_ = false;
+  bool cache_enabled_ = false;
+  std::string motion_gate_tag_;
+  std::vector<std::unique_ptr<StreamContext>> stream_ctxs_;  ///< indexed by stream index
 };  // class Inferencer
 
 }  // namespace cnstream
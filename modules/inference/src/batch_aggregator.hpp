@@ -0,0 +1,197 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_INFERENCE_BATCH_AGGREGATOR_HPP_
+#define MODULES_INFERENCE_BATCH_AGGREGATOR_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * @brief BatchAggregator collects inputs of many streams and forms batches for inference engines.
+ *
+ * Three policies are supported:
+ *  - merge is false: inputs of different groups (requests) are never merged, batches are taken at once.
+ *  - merge is true and latency_budget_ms is 0: batches are flushed when full or timeout_ms after the oldest input
+ *    arrived.
+ *  - merge is true and latency_budget_ms > 0: batches are sized adaptively. The arrival interval of inputs and the
+ *    cost of batches are tracked. A batch is flushed when it is full, when waiting for the next input would miss
+ *    the deadline of the oldest input (arrival time + latency budget - batch cost), or at once if the batch is not
+ *    expected to grow before that deadline, e.g. at low load.
+ *
+ * Push blocks if max_pending inputs are waiting.
+ */
+template <typename T>
+class BatchAggregator {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    uint32_t batch_size = 1;
+    bool merge = true;
+    uint32_t timeout_ms = 0;
+    uint32_t latency_budget_ms = 0;
+    size_t max_pending = 0;  // 0 means no limit
+  };
+
+  explicit BatchAggregator(const Options &options) : options_(options) {
+    options_.batch_size = std::max(options_.batch_size, 1u);
+  }
+
+  /**
+   * @brief Adds the inputs of a group at once, so that they are not split by engines in static strategy.
+   *
+   * @return Returns false if the aggregator is closed.
+   */
+  bool Push(std::vector<T> *values, const void *group) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    space_cond_.wait(lk, [this] {
+      return closed_ || !options_.max_pending || pending_.size() < options_.max_pending;
+    });
+    if (closed_) return false;
+    if (values->empty()) return true;
+    auto now = Clock::now();
+    // inputs of a group arrive together, one interval is sampled per group
+    if (has_arrival_) {
+      UpdateEwma(&arrival_interval_us_, std::chrono::duration<double, std::micro>(now - last_arrival_).count());
+    }
+    has_arrival_ = true;
+    last_arrival_ = now;
+    for (auto &value : *values) pending_.push_back(Entry{std::move(value), group, now});
+    cond_.notify_all();
+    return true;
+  }
+
+  /**
+   * @brief Takes a batch. Blocks until a batch is ready. Returns false if the aggregator is closed.
+   */
+  bool Pop(std::vector<T> *batch) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (true) {
+      cond_.wait(lk, [this] { return closed_ || !pending_.empty(); });
+      if (closed_) return false;
+      Clock::time_point flush_time;
+      if (!options_.merge || pending_.size() >= options_.batch_size || FlushTime(&flush_time)) break;
+      // woken up by new inputs or at the flush time, then decide again
+      cond_.wait_until(lk, flush_time);
+      if (!closed_ && !pending_.empty() && Clock::now() >= flush_time) break;
+    }
+
+    size_t num = 0;
+    if (options_.merge) {
+      num = std::min<size_t>(pending_.size(), options_.batch_size);
+    } else {
+      const void *group = pending_.front().group;
+      while (num < pending_.size() && num < options_.batch_size && pending_[num].group == group) ++num;
+    }
+    batch->clear();
+    batch->reserve(num);
+    for (size_t i = 0; i < num; ++i) batch->push_back(std::move(pending_[i].value));
+    pending_.erase(pending_.begin(), pending_.begin() + num);
+    ++batch_count_;
+    item_count_ += num;
+    space_cond_.notify_all();
+    return true;
+  }
+
+  /**
+   * @brief Reports the cost of a batch, which is used to estimate the deadline of batching.
+   */
+  void OnBatchDone(std::chrono::microseconds cost) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    UpdateEwma(&batch_cost_us_, cost.count());
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    closed_ = true;
+    pending_.clear();
+    cond_.notify_all();
+    space_cond_.notify_all();
+  }
+
+  uint64_t BatchCount() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return batch_count_;
+  }
+  uint64_t ItemCount() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return item_count_;
+  }
+
+ private:
+  struct Entry {
+    T value;
+    const void *group;
+    Clock::time_point arrival;
+  };
+
+  static void UpdateEwma(double *avg, double sample) {
+    constexpr double kAlpha = 0.1;
+    *avg = *avg < 0 ? sample : *avg * (1 - kAlpha) + sample * kAlpha;
+  }
+
+  // returns true if the partial batch should be flushed now, otherwise sets the time to flush
+  bool FlushTime(Clock::time_point *flush_time) const {
+    auto oldest = pending_.front().arrival;
+    if (!options_.latency_budget_ms) {
+      *flush_time = oldest + std::chrono::milliseconds(options_.timeout_ms);
+      return Clock::now() >= *flush_time;
+    }
+    auto now = Clock::now();
+    auto cost = std::chrono::microseconds(static_cast<int64_t>(std::max(batch_cost_us_, 0.0)));
+    auto deadline = oldest + std::chrono::milliseconds(options_.latency_budget_ms) - cost;
+    if (now >= deadline) return true;
+    // flush at once if no more input is expected before the deadline
+    if (arrival_interval_us_ < 0 ||
+        std::chrono::duration<double, std::micro>(deadline - now).count() < arrival_interval_us_) {
+      return true;
+    }
+    *flush_time = deadline;
+    return false;
+  }
+
+  Options options_;
+  mutable std::mutex mtx_;
+  std::condition_variable cond_;
+  std::condition_variable space_cond_;
+  std::deque<Entry> pending_;
+  bool closed_ = false;
+
+  bool has_arrival_ = false;
+  Clock::time_point last_arrival_;
+  double arrival_interval_us_ = -1;  // < 0 means unknown
+  double batch_cost_us_ = -1;
+
+  uint64_t batch_count_ = 0;
+  uint64_t item_count_ = 0;
+};  // class BatchAggregator
+
+}  // namespace cnstream
+
+#endif  // MODULES_INFERENCE_BATCH_AGGREGATOR_HPP_
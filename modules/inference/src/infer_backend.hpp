@@ -0,0 +1,185 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_INFERENCE_INFER_BACKEND_HPP_
+#define MODULES_INFERENCE_INFER_BACKEND_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_aggregator.hpp"
+#include "cnstream_frame_va.hpp"
+#include "cnstream_postproc.hpp"
+#include "inferencer.hpp"
+
+namespace cnstream {
+
+/**
+ * @brief One input of an inference request, a whole frame or an object on the frame.
+ */
+struct InferBackendInput {
+  cnedk::BufSurfWrapperPtr surf = nullptr;
+  CnInferBbox bbox;
+  bool has_bbox = false;
+  CNInferObjectPtr obj = nullptr;
+};
+
+/**
+ * @brief InferBackend runs preprocessing, the model and postprocessing for Inferencer.
+ *
+ * Preprocessing and postprocessing are delegated to the Inferencer. Frames must be responsed by
+ * Inferencer::OnProcessDone in the order of requests of each stream.
+ */
+class InferBackend {
+ public:
+  virtual ~InferBackend() = default;
+  /**
+   * @brief Creates a backend by name. infer_server and cpu are supported.
+   */
+  static InferBackend *Create(const std::string &name, Inferencer *owner);
+
+  virtual bool Open(const InferParams &params) = 0;
+  virtual void Close() = 0;
+  /**
+   * @brief Requests inference of the inputs of a frame. The frame is only responsed in order if inputs is empty.
+   */
+  virtual bool Request(const CNFrameInfoPtr &data, std::vector<InferBackendInput> *inputs) = 0;
+  virtual void WaitTaskDone(const std::string &stream_id) = 0;
+  /**
+   * @brief Discards the requests of a stream which are not done. Discarded frames are not responsed.
+   */
+  virtual void DiscardTask(const std::string &stream_id) = 0;
+};
+
+class InferObserver;
+
+/**
+ * @brief Runs offline models on MLU with infer_server.
+ */
+class InferServerBackend : public InferBackend {
+ public:
+  explicit InferServerBackend(Inferencer *owner) : owner_(owner) {}
+  ~InferServerBackend() { Close(); }
+  bool Open(const InferParams &params) override;
+  void Close() override;
+  bool Request(const CNFrameInfoPtr &data, std::vector<InferBackendInput> *inputs) override;
+  void WaitTaskDone(const std::string &stream_id) override;
+  void DiscardTask(const std::string &stream_id) override;
+
+ private:
+  Inferencer *owner_ = nullptr;
+  std::unique_ptr<infer_server::InferServer> server_ = nullptr;
+  infer_server::Session_t session_ = nullptr;
+  std::shared_ptr<InferObserver> observer_ = nullptr;
+};  // class InferServerBackend
+
+class CpuModelInfo;
+
+/**
+ * @brief Runs a mock model on CPU, for pipelines and benchmarks on machines without MLU.
+ *
+ * The model is described by a JSON file, set by model_path. For example:
+ *
+ *   {
+ *     "input_shape": [4, 416, 416, 3],     // batch size first
+ *     "input_order": "NHWC",               // NHWC or NCHW
+ *     "input_dtype": "UINT8",              // UINT8 or FLOAT32
+ *     "outputs": [
+ *       {"shape": [4, 1024, 7], "dtype": "FLOAT32", "value": 0},
+ *       {"shape": [4, 1], "dtype": "INT32", "value": 0}
+ *     ],
+ *     "compute_us": 2000,                  // the compute cost of a batch, in microseconds
+ *     "compute_us_per_item": 500           // the compute cost added by each item of a batch
+ *   }
+ *
+ * The outputs are filled with the values. The compute cost is spent by busy waiting, so the CPU is occupied as
+ * a real model does. engine_num threads run batches in parallel. Batches are formed by BatchAggregator. In dynamic
+ * batch strategy, inputs of different requests and streams are merged into one batch, and a batch is run after
+ * batch_timeout if it is not full, or adaptively if latency_budget is set. In static batch strategy, inputs of
+ * different requests are never merged.
+ */
+class CpuInferBackend : public InferBackend {
+ public:
+  explicit CpuInferBackend(Inferencer *owner);
+  ~CpuInferBackend();
+  bool Open(const InferParams &params) override;
+  void Close() override;
+  bool Request(const CNFrameInfoPtr &data, std::vector<InferBackendInput> *inputs) override;
+  void WaitTaskDone(const std::string &stream_id) override;
+  void DiscardTask(const std::string &stream_id) override;
+
+ private:
+  struct Task {
+    CNFrameInfoPtr data;
+    size_t remaining = 0;  // guarded by task_mtx_
+    std::atomic<bool> discarded{false};
+  };
+  struct Item {
+    std::shared_ptr<Task> task;
+    InferBackendInput input;
+  };
+  struct StreamTasks {
+    std::deque<std::shared_ptr<Task>> tasks;  // unfinished tasks in the order of requests
+    bool responding = false;                  // a thread is responding finished tasks without the lock
+  };
+  // buffers of an engine, reused by all batches
+  struct Engine {
+    std::vector<cnedk::BufSurfWrapperPtr> inputs;  // one per item of a batch
+    std::vector<cnedk::BufSurfWrapperPtr> outputs;
+  };
+
+  bool LoadModel(const std::string &path);
+  bool CreateEngine(Engine *engine);
+  void EngineLoop(size_t engine_idx);
+  void RunBatch(Engine *engine, const std::vector<Item> &batch);
+  void OnItemsDone(const std::vector<Item> &items);
+
+  Inferencer *owner_ = nullptr;
+  InferParams params_;
+  std::unique_ptr<CpuModelInfo> model_;
+  std::vector<float> output_values_;
+  uint32_t compute_us_ = 0;
+  uint32_t compute_us_per_item_ = 0;
+  uint32_t batch_size_ = 1;
+
+  std::vector<Engine> engines_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> running_{false};
+
+  std::unique_ptr<BatchAggregator<Item>> aggregator_ = nullptr;
+
+  std::mutex task_mtx_;
+  std::condition_variable task_cond_;
+  std::map<std::string, StreamTasks> stream_tasks_;
+
+  std::atomic<uint64_t> batch_count_{0};
+  std::atomic<uint64_t> item_count_{0};
+};  // class CpuInferBackend
+
+}  // namespace cnstream
+
+#endif  // MODULES_INFERENCE_INFER_BACKEND_HPP_
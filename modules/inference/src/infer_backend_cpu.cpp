@@ -0,0 +1,404 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rapidjson/document.h"
+#include "rapidjson/rapidjson.h"
+
+#include "cnstream_logging.hpp"
+#include "infer_backend.hpp"
+
+namespace cnstream {
+
+class CpuModelInfo : public infer_server::ModelInfo {
+ public:
+  const infer_server::Shape &InputShape(int index) const noexcept override { return input_shapes[index]; }
+  const infer_server::Shape &OutputShape(int index) const noexcept override { return output_shapes[index]; }
+  const infer_server::DataLayout &InputLayout(int index) const noexcept override { return input_layouts[index]; }
+  const infer_server::DataLayout &OutputLayout(int index) const noexcept override { return output_layouts[index]; }
+  uint32_t InputNum() const noexcept override { return input_shapes.size(); }
+  uint32_t OutputNum() const noexcept override { return output_shapes.size(); }
+  uint32_t BatchSize() const noexcept override { return input_shapes.empty() ? 0 : input_shapes[0][0]; }
+  std::string GetKey() const noexcept override { return key; }
+
+  std::vector<infer_server::Shape> input_shapes;
+  std::vector<infer_server::Shape> output_shapes;
+  std::vector<infer_server::DataLayout> input_layouts;
+  std::vector<infer_server::DataLayout> output_layouts;
+  std::string key;
+};  // class CpuModelInfo
+
+namespace {
+
+bool ParseShape(const rapidjson::Value &value, std::vector<int64_t> *dims) {
+  if (!value.IsArray() || value.Empty()) return false;
+  dims->clear();
+  for (auto iter = value.Begin(); iter != value.End(); ++iter) {
+    if (!iter->IsInt() || iter->GetInt() <= 0) return false;
+    dims->push_back(iter->GetInt());
+  }
+  return true;
+}
+
+bool ParseDataType(const std::string &str, infer_server::DataType *dtype) {
+  if (str == "UINT8") {
+    *dtype = infer_server::DataType::UINT8;
+  } else if (str == "FLOAT32") {
+    *dtype = infer_server::DataType::FLOAT32;
+  } else if (str == "INT32") {
+    *dtype = infer_server::DataType::INT32;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+size_t DataTypeSize(infer_server::DataType dtype) { return dtype == infer_server::DataType::UINT8 ? 1 : 4; }
+
+// the size of one item of a batch
+size_t ItemBytes(const infer_server::Shape &shape, infer_server::DataType dtype) {
+  return shape.DataCount() / shape[0] * DataTypeSize(dtype);
+}
+
+cnedk::BufSurfWrapperPtr CreateTensor(uint32_t device_id, uint32_t batch_size, size_t bytes) {
+  CnedkBufSurfaceCreateParams create_params;
+  memset(&create_params, 0, sizeof(create_params));
+  create_params.device_id = device_id;
+  create_params.batch_size = batch_size;
+  create_params.size = bytes;
+  create_params.color_format = CNEDK_BUF_COLOR_FORMAT_TENSOR;
+  create_params.mem_type = CNEDK_BUF_MEM_SYSTEM;
+  CnedkBufSurface *surf = nullptr;
+  if (CnedkBufSurfaceCreate(&surf, &create_params) < 0) {
+    LOGE(INFERENCER) << "[CpuInferBackend] Create tensor failed, size " << bytes;
+    return nullptr;
+  }
+  return std::make_shared<cnedk::BufSurfaceWrapper>(surf);
+}
+
+void BusyWait(uint64_t us) {
+  if (!us) return;
+  auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+}  // namespace
+
+bool CpuInferBackend::LoadModel(const std::string &path) {
+  std::ifstream ifs(path);
+  if (!ifs.good()) {
+    LOGE(INFERENCER) << "[CpuInferBackend] Open model description failed: " << path;
+    return false;
+  }
+  std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  rapidjson::Document doc;
+  if (doc.Parse<rapidjson::kParseCommentsFlag>(json.c_str()).HasParseError() || !doc.IsObject()) {
+    LOGE(INFERENCER) << "[CpuInferBackend] Parse model description failed: " << path;
+    return false;
+  }
+
+  std::unique_ptr<CpuModelInfo> model(new CpuModelInfo);
+  model->key = "cpu:" + path;
+  std::vector<int64_t> dims;
+  if (!doc.HasMember("input_shape") || !ParseShape(doc["input_shape"], &dims) || dims.size() != 4) {
+    LOGE(INFERENCER) << "[CpuInferBackend] input_shape should be an array of 4 positive integers.";
+    return false;
+  }
+  infer_server::DataLayout input_layout;
+  input_layout.dtype = infer_server::DataType::UINT8;
+  input_layout.order = infer_server::DimOrder::NHWC;
+  if (doc.HasMember("input_order")) {
+    std::string order = doc["input_order"].IsString() ? doc["input_order"].GetString() : "";
+    if (order == "NCHW") {
+      input_layout.order = infer_server::DimOrder::NCHW;
+    } else if (order != "NHWC") {
+      LOGE(INFERENCER) << "[CpuInferBackend] input_order should be NHWC or NCHW.";
+      return false;
+    }
+  }
+  if (doc.HasMember("input_dtype")) {
+    if (!doc["input_dtype"].IsString() || !ParseDataType(doc["input_dtype"].GetString(), &input_layout.dtype) ||
+        input_layout.dtype == infer_server::DataType::INT32) {
+      LOGE(INFERENCER) << "[CpuInferBackend] input_dtype should be UINT8 or FLOAT32.";
+      return false;
+    }
+  }
+  model->input_shapes.emplace_back(dims);
+  model->input_layouts.push_back(input_layout);
+  batch_size_ = dims[0];
+
+  if (!doc.HasMember("outputs") || !doc["outputs"].IsArray() || doc["outputs"].Empty()) {
+    LOGE(INFERENCER) << "[CpuInferBackend] outputs should be a non-empty array.";
+    return false;
+  }
+  output_values_.clear();
+  const rapidjson::Value &outputs = doc["outputs"];
+  for (auto iter = outputs.Begin(); iter != outputs.End(); ++iter) {
+    if (!iter->IsObject() || !iter->HasMember("shape") || !ParseShape((*iter)["shape"], &dims) ||
+        dims[0] != batch_size_) {
+      LOGE(INFERENCER) << "[CpuInferBackend] The shape of outputs should start with the batch size " << batch_size_;
+      return false;
+    }
+    infer_server::DataLayout layout;
+    layout.dtype = infer_server::DataType::FLOAT32;
+    layout.order = infer_server::DimOrder::NONE;
+    if (iter->HasMember("dtype")) {
+      if (!(*iter)["dtype"].IsString() || !ParseDataType((*iter)["dtype"].GetString(), &layout.dtype) ||
+          layout.dtype == infer_server::DataType::UINT8) {
+        LOGE(INFERENCER) << "[CpuInferBackend] The dtype of outputs should be FLOAT32 or INT32.";
+        return false;
+      }
+    }
+    float value = 0;
+    if (iter->HasMember("value") && (*iter)["value"].IsNumber()) value = (*iter)["value"].GetFloat();
+    model->output_shapes.emplace_back(dims);
+    model->output_layouts.push_back(layout);
+    output_values_.push_back(value);
+  }
+
+  compute_us_ = doc.HasMember("compute_us") && doc["compute_us"].IsUint() ? doc["compute_us"].GetUint() : 0;
+  compute_us_per_item_ = doc.HasMember("compute_us_per_item") && doc["compute_us_per_item"].IsUint()
+                             ? doc["compute_us_per_item"].GetUint()
+                             : 0;
+  model_ = std::move(model);
+  return true;
+}
+
+bool CpuInferBackend::CreateEngine(Engine *engine) {
+  const infer_server::Shape &input_shape = model_->InputShape(0);
+  size_t input_bytes = ItemBytes(input_shape, model_->InputLayout(0).dtype);
+  for (uint32_t i = 0; i < batch_size_; ++i) {
+    engine->inputs.push_back(CreateTensor(params_.device_id, 1, input_bytes));
+    if (!engine->inputs.back()) return false;
+  }
+  for (uint32_t i = 0; i < model_->OutputNum(); ++i) {
+    engine->outputs.push_back(
+        CreateTensor(params_.device_id, batch_size_, ItemBytes(model_->OutputShape(i), model_->OutputLayout(i).dtype)));
+    if (!engine->outputs.back()) return false;
+  }
+  return true;
+}
+
+CpuInferBackend::CpuInferBackend(Inferencer *owner) : owner_(owner) {}
+
+CpuInferBackend::~CpuInferBackend() { Close(); }
+
+bool CpuInferBackend::Open(const InferParams &params) {
+  params_ = params;
+  if (!LoadModel(params.model_path)) return false;
+
+  infer_server::CnPreprocTensorParams tensor_params;
+  tensor_params.input_order = model_->InputLayout(0).order;
+  tensor_params.input_shape = model_->InputShape(0);
+  tensor_params.input_dtype = model_->InputLayout(0).dtype;
+  tensor_params.input_format = params.input_format;
+  if (owner_->OnTensorParams(&tensor_params) != 0) {
+    LOGE(INFERENCER) << "[CpuInferBackend] Set tensor params to preprocessor failed.";
+    return false;
+  }
+
+  uint32_t engine_num = std::max(params.engine_num, 1u);
+  engines_.resize(engine_num);
+  for (auto &engine : engines_) {
+    if (!CreateEngine(&engine)) return false;
+  }
+  BatchAggregator<Item>::Options options;
+  options.batch_size = batch_size_;
+  options.merge = params.batch_strategy == InferBatchStrategy::DYNAMIC;
+  options.timeout_ms = params.batch_timeout;
+  options.latency_budget_ms = params.latency_budget;
+  // requests are blocked if too many inputs are waiting, as infer_server does
+  options.max_pending = static_cast<size_t>(batch_size_) * engine_num * 2;
+  aggregator_.reset(new BatchAggregator<Item>(options));
+  batch_count_ = 0;
+  item_count_ = 0;
+  running_ = true;
+  for (uint32_t i = 0; i < engine_num; ++i) {
+    threads_.emplace_back(&CpuInferBackend::EngineLoop, this, i);
+  }
+  LOGI(INFERENCER) << "[" << owner_->GetName() << "] CPU backend opened, batch size " << batch_size_
+                   << ", engine number " << engine_num;
+  return true;
+}
+
+void CpuInferBackend::Close() {
+  if (!running_.exchange(false)) return;
+  aggregator_->Close();
+  for (auto &thread : threads_) {
+    if (thread.joinable()) thread.join();
+  }
+  threads_.clear();
+  engines_.clear();
+  {
+    std::lock_guard<std::mutex> lk(task_mtx_);
+    stream_tasks_.clear();
+    task_cond_.notify_all();
+  }
+  if (params_.show_stats) {
+    uint64_t batches = batch_count_;
+    LOGI(INFERENCER) << "[" << owner_->GetName() << "] CPU backend: " << item_count_ << " items in " << batches
+                     << " batches, average batch size "
+                     << (batches ? static_cast<double>(item_count_) / batches : 0.0);
+  }
+}
+
+bool CpuInferBackend::Request(const CNFrameInfoPtr &data, std::vector<InferBackendInput> *inputs) {
+  if (!running_) return false;
+  auto task = std::make_shared<Task>();
+  task->data = data;
+  task->remaining = inputs->size();
+  {
+    std::lock_guard<std::mutex> lk(task_mtx_);
+    stream_tasks_[data->stream_id].tasks.push_back(task);
+  }
+  if (inputs->empty()) {
+    OnItemsDone({Item{task, InferBackendInput()}});
+    return true;
+  }
+  std::vector<Item> items;
+  items.reserve(inputs->size());
+  for (auto &input : *inputs) items.push_back(Item{task, std::move(input)});
+  return aggregator_->Push(&items, task.get());
+}
+
+void CpuInferBackend::EngineLoop(size_t engine_idx) {
+  Engine *engine = &engines_[engine_idx];
+  std::vector<Item> batch;
+  while (aggregator_->Pop(&batch)) {
+    auto start = std::chrono::steady_clock::now();
+    RunBatch(engine, batch);
+    aggregator_->OnBatchDone(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+    OnItemsDone(batch);
+  }
+}
+
+void CpuInferBackend::RunBatch(Engine *engine, const std::vector<Item> &batch) {
+  std::vector<CNFrameInfoPtr> packages;
+  std::vector<CNInferObjectPtr> objects;
+  std::vector<CnedkTransformRect> rects;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const Item &item = batch[i];
+    if (item.task->discarded) continue;
+    const InferBackendInput &input = item.input;
+    rects.clear();
+    if (input.has_bbox) {
+      CnedkTransformRect rect;
+      rect.left = input.bbox.x * input.surf->GetWidth();
+      rect.top = input.bbox.y * input.surf->GetHeight();
+      rect.width = input.bbox.w * input.surf->GetWidth();
+      rect.height = input.bbox.h * input.surf->GetHeight();
+      rects.push_back(rect);
+    }
+    cnedk::BufSurfWrapperPtr dst = engine->inputs[packages.size()];
+    if (owner_->OnPreproc(input.surf, dst, rects) != 0) {
+      // the item gets no results, its task is still responded so that the frame is not stuck
+      LOGE(INFERENCER) << "[CpuInferBackend] Preprocessing failed, stream id: " << item.task->data->stream_id;
+      continue;
+    }
+    packages.push_back(item.task->data);
+    if (input.obj) objects.push_back(input.obj);
+  }
+  if (packages.empty()) return;
+
+  BusyWait(compute_us_ + static_cast<uint64_t>(compute_us_per_item_) * packages.size());
+
+  NetOutputs net_outputs;
+  for (size_t i = 0; i < engine->outputs.size(); ++i) {
+    const infer_server::Shape &shape = model_->OutputShape(i);
+    size_t count = ItemBytes(shape, model_->OutputLayout(i).dtype) / 4;
+    for (size_t b = 0; b < packages.size(); ++b) {
+      void *out = engine->outputs[i]->GetHostData(0, b);
+      if (model_->OutputLayout(i).dtype == infer_server::DataType::INT32) {
+        std::fill_n(static_cast<int32_t *>(out), count, static_cast<int32_t>(output_values_[i]));
+      } else {
+        std::fill_n(static_cast<float *>(out), count, output_values_[i]);
+      }
+    }
+    net_outputs.emplace_back(engine->outputs[i], shape);
+  }
+  if (owner_->Postprocess(net_outputs, *model_, packages, objects) != 0) {
+    LOGE(INFERENCER) << "[CpuInferBackend] Postprocessing failed.";
+  }
+  ++batch_count_;
+  item_count_ += packages.size();
+}
+
+void CpuInferBackend::OnItemsDone(const std::vector<Item> &items) {
+  std::unique_lock<std::mutex> lk(task_mtx_);
+  std::vector<std::string> stream_ids;
+  for (const Item &item : items) {
+    if (item.task->remaining) --item.task->remaining;
+    const std::string &stream_id = item.task->data->stream_id;
+    if (std::find(stream_ids.begin(), stream_ids.end(), stream_id) == stream_ids.end()) {
+      stream_ids.push_back(stream_id);
+    }
+  }
+  std::vector<CNFrameInfoPtr> ready;
+  for (const auto &stream_id : stream_ids) {
+    auto iter = stream_tasks_.find(stream_id);
+    // the thread responding the stream picks up the tasks finished meanwhile
+    if (iter == stream_tasks_.end() || iter->second.responding) continue;
+    StreamTasks *stream = &iter->second;
+    stream->responding = true;
+    while (true) {
+      // respond finished tasks in the order of requests
+      ready.clear();
+      while (!stream->tasks.empty() && stream->tasks.front()->remaining == 0) {
+        if (!stream->tasks.front()->discarded) ready.push_back(stream->tasks.front()->data);
+        stream->tasks.pop_front();
+      }
+      if (ready.empty()) break;
+      // transmitting may block on a slow downstream, other streams must not wait for it
+      lk.unlock();
+      for (const auto &data : ready) owner_->OnProcessDone(data);
+      lk.lock();
+    }
+    stream->responding = false;
+  }
+  task_cond_.notify_all();
+}
+
+void CpuInferBackend::WaitTaskDone(const std::string &stream_id) {
+  std::unique_lock<std::mutex> lk(task_mtx_);
+  task_cond_.wait(lk, [&] {
+    auto iter = stream_tasks_.find(stream_id);
+    return !running_ || iter == stream_tasks_.end() || (iter->second.tasks.empty() && !iter->second.responding);
+  });
+  auto iter = stream_tasks_.find(stream_id);
+  if (iter != stream_tasks_.end() && !iter->second.responding) stream_tasks_.erase(iter);
+}
+
+void CpuInferBackend::DiscardTask(const std::string &stream_id) {
+  std::lock_guard<std::mutex> lk(task_mtx_);
+  auto iter = stream_tasks_.find(stream_id);
+  if (iter == stream_tasks_.end()) return;
+  for (auto &task : iter->second.tasks) task->discarded = true;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,121 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cnstream_logging.hpp"
+#include "infer_backend.hpp"
+
+namespace cnstream {
+
+class InferObserver : public infer_server::Observer {
+ public:
+  explicit InferObserver(std::function<void(const CNFrameInfoPtr)> callback) : callback_(callback) {}
+  void Response(infer_server::Status status, infer_server::PackagePtr result,
+                infer_server::any user_data) noexcept override {
+    callback_(infer_server::any_cast<const CNFrameInfoPtr>(user_data));
+  }
+ private:
+  std::function<void(const CNFrameInfoPtr)> callback_;
+};
+
+InferBackend *InferBackend::Create(const std::string &name, Inferencer *owner) {
+  if (name == "infer_server") {
+    return new (std::nothrow) InferServerBackend(owner);
+  } else if (name == "cpu") {
+    return new (std::nothrow) CpuInferBackend(owner);
+  }
+  LOGE(INFERENCER) << "Unknown inference backend: " << name;
+  return nullptr;
+}
+
+bool InferServerBackend::Open(const InferParams &params) {
+  cnrtSetDevice(params.device_id);
+  server_.reset(new infer_server::InferServer(params.device_id));
+
+  infer_server::SessionDesc desc;
+  desc.name = owner_->GetName();
+  desc.strategy = params.batch_strategy;
+  desc.batch_timeout = params.batch_timeout;
+  if (params.latency_budget && params.batch_strategy == infer_server::BatchStrategy::DYNAMIC) {
+    // batches are formed inside infer_server, only the timeout could be limited
+    desc.batch_timeout = std::min(params.batch_timeout, params.latency_budget);
+  }
+  desc.priority = params.priority;
+  desc.engine_num = params.engine_num;
+  desc.show_perf = params.show_stats;
+  desc.model = server_->LoadModel(params.model_path);
+  desc.model_input_format = params.input_format;
+  desc.preproc = infer_server::Preprocessor::Create();
+  infer_server::SetPreprocHandler(desc.model->GetKey(), owner_);
+  desc.postproc = infer_server::Postprocessor::Create();
+  infer_server::SetPostprocHandler(desc.model->GetKey(), owner_);
+
+  observer_ = std::make_shared<InferObserver>(std::bind(&Inferencer::OnProcessDone, owner_, std::placeholders::_1));
+  session_ = server_->CreateSession(desc, observer_);
+  if (!session_) return false;
+  return true;
+}
+
+void InferServerBackend::Close() {
+  if (server_ && session_) {
+    infer_server::RemovePreprocHandler(server_->GetModel(session_)->GetKey());
+    infer_server::RemovePostprocHandler(server_->GetModel(session_)->GetKey());
+    server_->DestroySession(session_);
+    session_ = nullptr;
+    server_.reset();
+  }
+}
+
+bool InferServerBackend::Request(const CNFrameInfoPtr &data, std::vector<InferBackendInput> *inputs) {
+  if (inputs->empty()) {
+    // to keep data in sequence, we pass empty package to infer_server, with CNFrameInfo as user data.
+    // frame won't be inferred, and CNFrameInfo will be responsed in sequence
+    infer_server::PackagePtr in = infer_server::Package::Create(0, data->stream_id);
+    return server_->Request(session_, in, data, -1);
+  }
+
+  // Async inference:
+  // 1. send data to the inferserver
+  // 2. the infer-result will be notified via OnPostproc()
+  // 3. process_done() will be invoked when finished
+  infer_server::PackagePtr request = std::make_shared<infer_server::Package>();
+  request->tag = data->stream_id;
+  for (auto &input : *inputs) {
+    infer_server::PreprocInput tmp;
+    tmp.surf = input.surf;
+    tmp.bbox = input.bbox;
+    tmp.has_bbox = input.has_bbox;
+    request->data.emplace_back(new infer_server::InferData);
+    auto &request_data = request->data.back();
+    request_data->Set(std::move(tmp));
+    request_data->SetUserData(std::make_pair(data, input.obj));
+  }
+  return server_->Request(session_, request, data, -1);
+}
+
+void InferServerBackend::WaitTaskDone(const std::string &stream_id) { server_->WaitTaskDone(session_, stream_id); }
+
+void InferServerBackend::DiscardTask(const std::string &stream_id) { server_->DiscardTask(session_, stream_id); }
+
+}  // namespace cnstream
@@ -0,0 +1,108 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "infer_cache.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cnstream {
+
+static float BboxIoU(const CnInferBbox &a, const CnInferBbox &b) {
+  float w = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+  float h = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+  if (w <= 0 || h <= 0) return 0.f;
+  float inter = w * h;
+  float uni = a.w * a.h + b.w * b.h - inter;
+  return uni > 0 ? inter / uni : 0.f;
+}
+
+static bool HasKey(const std::vector<std::string> &keys, const std::string &key) {
+  return std::find(keys.begin(), keys.end(), key) != keys.end();
+}
+
+InferCache::Keys InferCache::GetKeys(CNInferObject *obj) {
+  Keys keys;
+  for (const auto &attr : obj->GetAttributes()) keys.attributes.push_back(attr.first);
+  for (const auto &attr : obj->GetExtraAttributes()) keys.extra_attributes.push_back(attr.first);
+  for (const auto &feature : obj->GetFeatures()) keys.features.push_back(feature.first);
+  return keys;
+}
+
+bool InferCache::Apply(CNInferObject *obj, uint64_t frame_id) {
+  if (obj->track_id.empty()) return false;
+  CnInferBbox bbox = GetFullFovBbox(obj);
+  std::unique_lock<std::mutex> lk(mtx_);
+  ++lookup_count_;
+  auto iter = entries_.find(obj->track_id);
+  if (iter == entries_.end()) return false;
+  const Entry &entry = iter->second;
+  if (frame_id < entry.frame_id || frame_id - entry.frame_id > options_.ttl || entry.score < options_.refresh_score ||
+      BboxIoU(bbox, entry.bbox) < options_.min_iou) {
+    entries_.erase(iter);
+    return false;
+  }
+  ++hit_count_;
+  Entry result = entry;
+  lk.unlock();
+
+  for (const auto &attr : result.attributes) obj->AddAttribute(attr);
+  obj->AddExtraAttributes(result.extra_attributes);
+  for (const auto &feature : result.features) obj->AddFeature(feature.first, feature.second);
+  return true;
+}
+
+void InferCache::Update(CNInferObject *obj, const Keys &keys, uint64_t frame_id) {
+  if (obj->track_id.empty()) return;
+  Entry entry;
+  for (auto &attr : obj->GetAttributes()) {
+    if (HasKey(keys.attributes, attr.first)) continue;
+    entry.score = std::min(entry.score, attr.second.score);
+    entry.attributes.push_back(std::move(attr));
+  }
+  for (auto &attr : obj->GetExtraAttributes()) {
+    if (!HasKey(keys.extra_attributes, attr.first)) entry.extra_attributes.push_back(std::move(attr));
+  }
+  for (auto &feature : obj->GetFeatures()) {
+    if (!HasKey(keys.features, feature.first)) entry.features.push_back(std::move(feature));
+  }
+  entry.bbox = GetFullFovBbox(obj);
+  entry.frame_id = frame_id;
+
+  std::lock_guard<std::mutex> lk(mtx_);
+  auto iter = entries_.find(obj->track_id);
+  // results of frames inferred out of order are not kept
+  if (iter != entries_.end() && iter->second.frame_id > frame_id) return;
+  entries_[obj->track_id] = std::move(entry);
+}
+
+void InferCache::Purge(uint64_t frame_id) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    if (frame_id > iter->second.frame_id && frame_id - iter->second.frame_id > options_.ttl) {
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+}  // namespace cnstream
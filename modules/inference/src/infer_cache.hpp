@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_INFERENCE_INFER_CACHE_HPP_
+#define MODULES_INFERENCE_INFER_CACHE_HPP_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cnstream_frame_va.hpp"
+
+namespace cnstream {
+
+/**
+ * @brief InferCache keeps the results of secondary inference of the tracked objects of a stream.
+ *
+ * The results are keyed by CNInferObject::track_id. A cached result is reused by the object of the same track if
+ *  - it was inferred at most ttl frames ago,
+ *  - its score is not lower than refresh_score, the min score of the attributes, 1 if there is no attribute,
+ *  - and the IoU of the bounding boxes is not lower than min_iou.
+ * Otherwise the object should be inferred again.
+ *
+ * Lookups and updates could be called from different threads.
+ */
+class InferCache {
+ public:
+  struct Options {
+    uint32_t ttl = 0;           ///< in frames
+    float refresh_score = 0.f;  ///< results with lower scores are not reused
+    float min_iou = 0.f;        ///< results are invalidated if the bounding box changed more than this
+  };
+  /**
+   * @brief The keys of results an object has before inference, which are not cached.
+   */
+  struct Keys {
+    std::vector<std::string> attributes;
+    std::vector<std::string> extra_attributes;
+    std::vector<std::string> features;
+  };
+
+  explicit InferCache(const Options &options) : options_(options) {}
+
+  static Keys GetKeys(CNInferObject *obj);
+
+  /**
+   * @brief Adds the cached results of the track to the object.
+   *
+   * @return Returns false if there is no valid result, then the object should be inferred.
+   */
+  bool Apply(CNInferObject *obj, uint64_t frame_id);
+
+  /**
+   * @brief Caches the results added to the object by inference. Results listed in keys are excluded.
+   */
+  void Update(CNInferObject *obj, const Keys &keys, uint64_t frame_id);
+
+  /**
+   * @brief Removes results which are expired.
+   */
+  void Purge(uint64_t frame_id);
+
+  uint64_t HitCount() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return hit_count_;
+  }
+  uint64_t LookupCount() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return lookup_count_;
+  }
+
+ private:
+  struct Entry {
+    std::vector<std::pair<std::string, CNInferAttr>> attributes;
+    StringPairs extra_attributes;
+    CNInferFeatures features;
+    CnInferBbox bbox;
+    float score = 1.f;
+    uint64_t frame_id = 0;
+  };
+
+  Options options_;
+  mutable std::mutex mtx_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t hit_count_ = 0;
+  uint64_t lookup_count_ = 0;
+};  // class InferCache
+
+}  // namespace cnstream
+
+#endif  // MODULES_INFERENCE_INFER_CACHE_HPP_
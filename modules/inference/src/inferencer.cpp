@@ -20,6 +20,8 @@
 #include "inferencer.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -34,22 +36,32 @@
 #include "rapidjson/writer.h"
 
 
+#include "infer_backend.hpp"
+#include "infer_cache.hpp"
+#include "motion_detector.hpp"
 #include "private/cnstream_param.hpp"
 
 namespace cnstream {
 
-class InferObserver : public infer_server::Observer {
- public:
-  explicit InferObserver(std::function<void(const CNFrameInfoPtr)> callback) : callback_(callback) {}
-  void Response(infer_server::Status status, infer_server::PackagePtr result,
-                infer_server::any user_data) noexcept override {
-    callback_(infer_server::any_cast<const CNFrameInfoPtr>(user_data));
-  }
- private:
-  std::function<void(const CNFrameInfoPtr)> callback_;
+struct Inferencer::StreamContext {
+  std::atomic<uint32_t> frame_count{0};  // for interval
+  std::unique_ptr<MotionDetector> detector;  // used by Process only
+  std::mutex mtx;
+  // inferred frames in flight (true) and frames bypassing the backend behind them (false), in order
+  std::deque<std::pair<CNFrameInfoPtr, bool>> pending;
+  std::vector<CNInferObjectPtr> detections;  // copies of detections of the last inferred frame
+  std::unique_ptr<InferCache> cache;  // results of secondary inference by track
 };
 
-Inferencer::Inferencer(const std::string& name) : ModuleEx(name) {
+static InferCache::Options CacheOptions(const InferParams& params) {
+  InferCache::Options options;
+  options.ttl = params.cache_ttl;
+  options.refresh_score = params.cache_refresh_score;
+  options.min_iou = params.cache_iou;
+  return options;
+}
+
+Inferencer::Inferencer(const std::string& name) : ModuleEx(name), motion_gate_tag_("MotionGate:" + name) {
   param_register_.SetModuleDesc(
       "Inferencer is a module for running offline model inference, preprocessing and "
       "postprocessing based on infer_server.");
@@ -207,6 +219,13 @@ Inferencer::Inferencer(const std::string& name) : ModuleEx(name) {
        "Usually, it could be set to the core number of the device / the core number of the model.",
        PARAM_OPTIONAL, OFFSET(InferParams, engine_num), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
 
+      {"backend", "infer_server",
+       "Optional. The inference backend. The options are infer_server and cpu. "
+       "infer_server: run the offline model on MLU. "
+       "cpu: run a mock model on CPU, which is described by the JSON file set by model_path. "
+       "It is used to run pipelines and benchmarks on machines without MLU.",
+       PARAM_OPTIONAL, OFFSET(InferParams, backend), ModuleParamParser<std::string>::Parser, "string"},
+
       {"show_stats", "false",
        "Optional. Whether show performance statistics. "
        "1/true/TRUE/True/0/false/FALSE/False these values are accepted.",
@@ -221,9 +240,45 @@ Inferencer::Inferencer(const std::string& name) : ModuleEx(name) {
       {"batch_timeout", "300", "The batching timeout. unit[ms].", PARAM_OPTIONAL, OFFSET(InferParams, batch_timeout),
        ModuleParamParser<uint32_t>::Parser, "uint32_t"},
 
+      {"latency_budget", "0",
+       "Optional. The latency budget of batching in dynamic batch strategy. unit[ms]. 0 means disabled. "
+       "With the cpu backend, batches of all streams are sized adaptively by the arrival rate of frames and "
+       "the cost of batches, and are flushed early before the budget runs out. batch_timeout is ignored then. "
+       "With the infer_server backend, it limits batch_timeout.",
+       PARAM_OPTIONAL, OFFSET(InferParams, latency_budget), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
+
       {"interval", "1", "Optional. Inferencing one frame every [interval] frames.", PARAM_OPTIONAL,
        OFFSET(InferParams, interval), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
 
+      {"motion_threshold", "0",
+       "Optional. Enables motion gating if it is larger than 0. Frames selected by interval are compared with "
+       "the last inferred frame of the stream on the downscaled luma plane. A frame is not inferred if the ratio of "
+       "changed regions is not larger than motion_threshold, and the detections of the last inferred frame are "
+       "reused. Lower values are more sensitive, 0.01 to 0.05 are proper for most static scenes. "
+       "Only primary inference on NV12, NV21 and GRAY8 frames is supported.",
+       PARAM_OPTIONAL, OFFSET(InferParams, motion_threshold), ModuleParamParser<float>::Parser, "float"},
+
+      {"motion_max_skip", "30",
+       "Optional. The max number of frames skipped in a row by motion gating. It bounds the delay of detecting "
+       "objects which move slowly. 0 means no limit.",
+       PARAM_OPTIONAL, OFFSET(InferParams, motion_max_skip), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
+
+      {"cache_ttl", "0",
+       "Optional. Enables the cache of secondary inference if it is larger than 0. The results of an object are "
+       "cached by its track id, and reused by the objects of the same track in the next cache_ttl frames instead of "
+       "inferring them. It requires track ids set by an upstream tracker.",
+       PARAM_OPTIONAL, OFFSET(InferParams, cache_ttl), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
+
+      {"cache_refresh_score", "0",
+       "Optional. Cached results whose score is lower than this are not reused, so tracks with uncertain results are "
+       "inferred again. The score of results is the min score of their attributes.",
+       PARAM_OPTIONAL, OFFSET(InferParams, cache_refresh_score), ModuleParamParser<float>::Parser, "float"},
+
+      {"cache_iou", "0.5",
+       "Optional. Cached results are invalidated if the IoU of the bounding box of the object and the bounding box "
+       "the results were inferred on is lower than this.",
+       PARAM_OPTIONAL, OFFSET(InferParams, cache_iou), ModuleParamParser<float>::Parser, "float"},
+
       {"model_input_pixel_format", "RGB24",
        "Optional. The pixel format of the model input image. "
        "For using Custom preproc RGB24/BGR24/GRAY/TENSOR are supported. ",
@@ -283,15 +338,17 @@ bool Inferencer::Open(ModuleParamSet raw_params) {
   }
 
   auto params = param_helper_->GetParams();
-  uint32_t dev_cnt = 0;
-  if (cnrtGetDeviceCount(&dev_cnt) != cnrtSuccess || params.device_id < 0 ||
-      static_cast<uint32_t>(params.device_id) >= dev_cnt) {
-    LOGE(Inferencer) << "[" << GetName() << "] device " << params.device_id << " does not exist.";
-    return false;
+  bool use_mlu = params.backend == "infer_server";
+  if (use_mlu) {
+    uint32_t dev_cnt = 0;
+    if (cnrtGetDeviceCount(&dev_cnt) != cnrtSuccess || params.device_id < 0 ||
+        static_cast<uint32_t>(params.device_id) >= dev_cnt) {
+      LOGE(Inferencer) << "[" << GetName() << "] device " << params.device_id << " does not exist.";
+      return false;
+    }
+    cnrtSetDevice(params.device_id);
   }
 
-  cnrtSetDevice(params.device_id);
-
   preproc_ = std::shared_ptr<Preproc>(Preproc::Create(params.preproc_name));
   if (!preproc_) {
     LOGE(Inferencer) << "Can not find Preproc implemention by name: " << params.preproc_name;
@@ -365,37 +422,43 @@ bool Inferencer::Open(ModuleParamSet raw_params) {
     }
   }
 
-  cnrtSetDevice(params.device_id);
-  server_.reset(new infer_server::InferServer(params.device_id));
-
-  infer_server::SessionDesc desc;
-  desc.name = this->GetName();
-  desc.strategy = params.batch_strategy;
-  desc.batch_timeout = params.batch_timeout;
-  desc.priority = params.priority;
-  desc.engine_num = params.engine_num;
-  desc.show_perf = params.show_stats;
-  desc.model = server_->LoadModel(params.model_path);
-  desc.model_input_format = params.input_format;
-  desc.preproc = infer_server::Preprocessor::Create();
-  infer_server::SetPreprocHandler(desc.model->GetKey(), this);
-  desc.postproc = infer_server::Postprocessor::Create();
-  infer_server::SetPostprocHandler(desc.model->GetKey(), this);
-
-  observer_ = std::make_shared<InferObserver>(std::bind(&Inferencer::OnProcessDone, this, std::placeholders::_1));
-  session_ = server_->CreateSession(desc, observer_);
-  if (!session_) return false;
+  motion_gating_ = params.motion_threshold > 0;
+  if (motion_gating_ && filter_) {
+    LOGW(Inferencer) << "[" << GetName() << "] Motion gating is only supported by primary inference, disabled.";
+    motion_gating_ = false;
+  }
+
+  cache_enabled_ = params.cache_ttl > 0;
+  if (cache_enabled_ && !filter_) {
+    LOGW(Inferencer) << "[" << GetName() << "] The cache is only supported by secondary inference, disabled.";
+    cache_enabled_ = false;
+  }
+
+  stream_ctxs_.clear();
+  for (uint32_t i = 0; i < GetMaxStreamNumber(); ++i) {
+    stream_ctxs_.emplace_back(new StreamContext);
+    if (motion_gating_) {
+      stream_ctxs_.back()->detector.reset(new MotionDetector(params.motion_threshold, params.motion_max_skip));
+    }
+    if (cache_enabled_) stream_ctxs_.back()->cache.reset(new InferCache(CacheOptions(params)));
+  }
+
+  backend_.reset(InferBackend::Create(params.backend, this));
+  if (!backend_) return false;
+  if (!backend_->Open(params)) {
+    LOGE(Inferencer) << "[" << GetName() << "] Open " << params.backend << " backend failed.";
+    backend_.reset();
+    return false;
+  }
   return true;
 }
 
 void Inferencer::Close() {
-  if (server_ && session_) {
-    infer_server::RemovePreprocHandler(server_->GetModel(session_)->GetKey());
-    infer_server::RemovePostprocHandler(server_->GetModel(session_)->GetKey());
-    server_->DestroySession(session_);
-    session_ = nullptr;
-    server_.reset();
+  if (backend_) {
+    backend_->Close();
+    backend_.reset();
   }
+  stream_ctxs_.clear();
 }
 
 int Inferencer::Process(std::shared_ptr<CNFrameInfo> data) {
@@ -404,19 +467,42 @@ int Inferencer::Process(std::shared_ptr<CNFrameInfo> data) {
     return -1;
   }
 
+  if (data->GetStreamIndex() >= stream_ctxs_.size()) {
+    LOGE(INFERENCER) << "[" << this->GetName() << "] Invalid stream index " << data->GetStreamIndex()
+                     << " of stream " << data->stream_id;
+    return -1;
+  }
+  StreamContext* ctx = stream_ctxs_[data->GetStreamIndex()].get();
+  auto params = param_helper_->GetParams();
+
   if (data->IsEos()) {
     if (IsStreamRemoved(data->stream_id)) {
-      server_->DiscardTask(session_, data->stream_id);
-      server_->WaitTaskDone(session_, data->stream_id);
+      backend_->DiscardTask(data->stream_id);
+      backend_->WaitTaskDone(data->stream_id);
     } else {
-      server_->WaitTaskDone(session_, data->stream_id);
+      backend_->WaitTaskDone(data->stream_id);
     }
-    TransmitData(data);
-    std::unique_lock<std::mutex> lock(drop_cnt_map_mtx_);
-    if (drop_cnt_map_.count(data->stream_id) != 0) {
-      drop_cnt_map_.erase(data->stream_id);
+    std::unique_lock<std::mutex> lk(ctx->mtx);
+    // frames discarded by the backend are never responsed
+    ctx->pending.clear();
+    ctx->detections.clear();
+    lk.unlock();
+    ctx->frame_count.store(0, std::memory_order_relaxed);
+    if (ctx->detector) {
+      if (params.show_stats) {
+        LOGI(INFERENCER) << "[" << GetName() << "] stream " << data->stream_id << ": motion gating skipped "
+                         << ctx->detector->SkippedCount() << " of " << ctx->detector->CheckedCount() << " frames.";
+      }
+      ctx->detector.reset(new MotionDetector(params.motion_threshold, params.motion_max_skip));
     }
-    lock.unlock();
+    if (ctx->cache) {
+      if (params.show_stats) {
+        LOGI(INFERENCER) << "[" << GetName() << "] stream " << data->stream_id << ": cache hit "
+                         << ctx->cache->HitCount() << " of " << ctx->cache->LookupCount() << " objects.";
+      }
+      ctx->cache.reset(new InferCache(CacheOptions(params)));
+    }
+    TransmitData(data);
     return 0;
   }
   if (data->IsRemoved()) { /* discard packets from removed-stream */
@@ -425,76 +511,70 @@ int Inferencer::Process(std::shared_ptr<CNFrameInfo> data) {
 
   auto frame = data->collection.Get<CNDataFramePtr>(kCNDataFrameTag);
 
-  auto params = param_helper_->GetParams();
-  if (params.interval > 0) {
-    // for interval
-    uint32_t interval = params.interval;
-    std::unique_lock<std::mutex> lock(drop_cnt_map_mtx_);
-    if (drop_cnt_map_.count(data->stream_id) == 0) {
-      drop_cnt_map_.insert(std::make_pair(data->stream_id, interval - 1));
-    }
-    bool drop_data = drop_cnt_map_[data->stream_id]++ != interval - 1;
-    lock.unlock();
-
-    if (drop_data) {
-      // to keep data in sequence, we pass empty package to infer_server, with CNFrameInfo as user data.
-      // frame won't be inferred, and CNFrameInfo will be responsed in sequence
-      infer_server::PackagePtr in = infer_server::Package::Create(0, data->stream_id);
-      if (!server_->Request(session_, in, data, -1)) {
-        LOGE(INFERENCER) << "[" << this->GetName() << "] Process failed."
-                        << " stream id: " << data->stream_id << " frame id: " << frame->frame_id;
-        return -1;
-      }
-      return 0;
-    }
+  bool skip = false;
+  if (params.interval > 1) {
+    skip = ctx->frame_count.fetch_add(1, std::memory_order_relaxed) % params.interval != 0;
+  }
 
-    drop_cnt_map_[data->stream_id] = 0;
+  if (!skip && ctx->detector) {
+    // skipped frames reuse detections of the last inferred frame in UpdateMotionDetections
+    skip = !DetectMotion(ctx, frame);
+    data->collection.Add(motion_gate_tag_, skip);
   }
 
-  // Async inference:
-  // 1. send data to the inferserver
-  // 2. the infer-result will be notified via OnPostproc()
-  // 3. process_done() will be invoked when finished
-  infer_server::PackagePtr request = std::make_shared<infer_server::Package>();
-  request->tag = data->stream_id;
+  if (skip) {
+    Bypass(ctx, data);
+    return 0;
+  }
+
+  std::vector<InferBackendInput> inputs;
   if (filter_) {
     CNInferObjsPtr objs_holder = nullptr;
     if (data->collection.HasValue(kCNInferObjsTag)) {
       objs_holder = data->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
       std::lock_guard<std::mutex> lk(objs_holder->mutex_);
       auto& objs = objs_holder->objs_;
+      if (ctx->cache && frame->frame_id % params.cache_ttl == 0) ctx->cache->Purge(frame->frame_id);
       for (auto& obj : objs) {
         if (!filter_->Filter(data, obj)) continue;
-        infer_server::PreprocInput tmp;
-        tmp.surf = frame->buf_surf;
-        tmp.bbox = GetFullFovBbox(obj.get());
+        if (ctx->cache && ctx->cache->Apply(obj.get(), frame->frame_id)) continue;
+        InferBackendInput input;
+        input.surf = frame->buf_surf;
+        input.bbox = GetFullFovBbox(obj.get());
         // validate bbox to meet hw requirements,
         //   move to the handlers, some networks do have the cases ... for example, lprnet 94x24
         /*
-        if (tmp.bbox.w * frame->buf_surf->GetWidth() < 64 || tmp.bbox.h * frame->buf_surf->GetHeight() < 64 ) {
+        if (input.bbox.w * frame->buf_surf->GetWidth() < 64 || input.bbox.h * frame->buf_surf->GetHeight() < 64 ) {
           continue;
         }
         */
-        tmp.has_bbox = true;
-        request->data.emplace_back(new infer_server::InferData);
-        auto& request_data = request->data.back();
-        request_data->Set(std::move(tmp));
-        request_data->SetUserData(std::make_pair(data, obj));
+        input.has_bbox = true;
+        input.obj = obj;
+        inputs.push_back(std::move(input));
       }
     }
   } else {
-    request->data.emplace_back(new infer_server::InferData);
-    auto& request_data = request->data.back();
-    infer_server::PreprocInput tmp;
-    tmp.surf = frame->buf_surf;
-    tmp.has_bbox = false;
-    request_data->Set(std::move(tmp));
-    request_data->SetUserData(std::make_pair(data, CNInferObjectPtr(nullptr)));
+    InferBackendInput input;
+    input.surf = frame->buf_surf;
+    input.has_bbox = false;
+    inputs.push_back(std::move(input));
   }
 
-  if (!server_->Request(session_, request, data, -1)) {
+  if (inputs.empty()) {
+    // no object to infer
+    Bypass(ctx, data);
+    return 0;
+  }
+
+  // queued before requesting, the response may come at once
+  std::unique_lock<std::mutex> lk(ctx->mtx);
+  ctx->pending.emplace_back(data, true);
+  lk.unlock();
+  if (!backend_->Request(data, &inputs)) {
     LOGE(INFERENCER) << "[" << this->GetName() << "] Process failed."
                      << " stream id: " << data->stream_id << " frame id: " << frame->frame_id;
+    lk.lock();
+    ctx->pending.pop_back();
     return -1;
   }
   return 0;
@@ -521,6 +601,21 @@ bool Inferencer::CheckParamSet(const ModuleParamSet& param_set) const {
     ret = false;
   }
 
+  if (params.backend != "infer_server" && params.backend != "cpu") {
+    LOGE(Inferencer) << "[backend] : " << params.backend << " is not supported. infer_server and cpu are supported.";
+    ret = false;
+  }
+
+  if (params.motion_threshold < 0 || params.motion_threshold > 1) {
+    LOGE(Inferencer) << "[motion_threshold] : " << params.motion_threshold << " should be in range [0, 1].";
+    ret = false;
+  }
+
+  if (params.cache_iou < 0 || params.cache_iou > 1) {
+    LOGE(Inferencer) << "[cache_iou] : " << params.cache_iou << " should be in range [0, 1].";
+    ret = false;
+  }
+
   ParametersChecker checker;
 
   if (!checker.CheckPath(params.model_path, param_set)) {
@@ -531,6 +626,76 @@ bool Inferencer::CheckParamSet(const ModuleParamSet& param_set) const {
   return ret;
 }
 
+void Inferencer::OnProcessDone(const CNFrameInfoPtr data) {
+  StreamContext* ctx = stream_ctxs_[data->GetStreamIndex()].get();
+  std::lock_guard<std::mutex> lk(ctx->mtx);
+  // responses are in order, frames ahead of it are discarded
+  while (!ctx->pending.empty() && ctx->pending.front().first != data) ctx->pending.pop_front();
+  if (!ctx->pending.empty()) ctx->pending.pop_front();
+  TransmitLocked(ctx, data);
+  while (!ctx->pending.empty() && !ctx->pending.front().second) {
+    TransmitLocked(ctx, ctx->pending.front().first);
+    ctx->pending.pop_front();
+  }
+}
+
+void Inferencer::Bypass(StreamContext* ctx, const CNFrameInfoPtr& data) {
+  std::lock_guard<std::mutex> lk(ctx->mtx);
+  if (!ctx->pending.empty()) {
+    ctx->pending.emplace_back(data, false);
+    return;
+  }
+  TransmitLocked(ctx, data);
+}
+
+void Inferencer::TransmitLocked(StreamContext* ctx, const CNFrameInfoPtr& data) {
+  // transmitted with the lock held, so that frames of a stream are never reordered
+  if (motion_gating_) UpdateMotionDetections(ctx, data);
+  TransmitData(data);
+}
+
+bool Inferencer::DetectMotion(StreamContext* ctx, const CNDataFramePtr& frame) {
+  cnedk::BufSurfWrapperPtr surf = frame->buf_surf;
+  if (!surf) return true;
+  CnedkBufSurfaceColorFormat fmt = surf->GetColorFormat();
+  if (fmt != CNEDK_BUF_COLOR_FORMAT_NV12 && fmt != CNEDK_BUF_COLOR_FORMAT_NV21 &&
+      fmt != CNEDK_BUF_COLOR_FORMAT_GRAY8) {
+    return true;
+  }
+  CnedkBufSurfaceSyncForCpu(surf->GetBufSurface(), -1, -1);
+  return ctx->detector->Check(static_cast<const uint8_t*>(surf->GetHostData(0)), surf->GetStride(0),
+                              surf->GetWidth(), surf->GetHeight());
+}
+
+static CNInferObjectPtr CloneObject(const CNInferObjectPtr& src) {
+  auto obj = std::make_shared<CNInferObject>();
+  obj->id = src->id;
+  obj->track_id = src->track_id;
+  obj->score = src->score;
+  obj->bbox = src->bbox;
+  obj->parent = src->parent;
+  src->collection.CopyTo(&obj->collection);
+  for (const auto& attribute : src->GetAttributes()) obj->AddAttribute(attribute);
+  for (const auto& attribute : src->GetExtraAttributes()) obj->AddExtraAttribute(attribute.first, attribute.second);
+  for (const auto& feature : src->GetFeatures()) obj->AddFeature(feature.first, feature.second);
+  return obj;
+}
+
+void Inferencer::UpdateMotionDetections(StreamContext* ctx, const CNFrameInfoPtr& data) {
+  // frames dropped by interval are not tagged
+  if (!data->collection.HasValue(motion_gate_tag_) || !data->collection.HasValue(kCNInferObjsTag)) return;
+  bool skipped = data->collection.Get<bool>(motion_gate_tag_);
+  CNInferObjsPtr objs_holder = data->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
+  std::lock_guard<std::mutex> lk(objs_holder->mutex_);
+  if (skipped) {
+    for (const auto& detection : ctx->detections) objs_holder->objs_.push_back(CloneObject(detection));
+  } else {
+    // copied before transmitted, modules downstream may modify the objects of the frame
+    ctx->detections.clear();
+    for (const auto& obj : objs_holder->objs_) ctx->detections.push_back(CloneObject(obj));
+  }
+}
+
 int Inferencer::OnPostproc(const std::vector<infer_server::InferData*>& data_vec,
                            const infer_server::ModelIO& model_output,
                            const infer_server::ModelInfo* model_info) {
@@ -551,12 +716,28 @@ int Inferencer::OnPostproc(const std::vector<infer_server::InferData*>& data_vec
     packages.push_back(user_data.first);
     if (user_data.second) objects.push_back(user_data.second);
   }
+  return Postprocess(net_outputs, *model_info, packages, objects);
+}
 
+int Inferencer::Postprocess(const NetOutputs& net_outputs, const infer_server::ModelInfo& model_info,
+                            const std::vector<CNFrameInfoPtr>& packages, const std::vector<CNInferObjectPtr>& objects) {
   if (postproc_) {
     if (objects.size()) {
-      return postproc_->Execute(net_outputs, *model_info, packages, objects, label_strings_);
+      if (!cache_enabled_) return postproc_->Execute(net_outputs, model_info, packages, objects, label_strings_);
+      std::vector<InferCache::Keys> keys;
+      keys.reserve(objects.size());
+      for (const auto& obj : objects) keys.push_back(InferCache::GetKeys(obj.get()));
+      int ret = postproc_->Execute(net_outputs, model_info, packages, objects, label_strings_);
+      if (ret != 0) return ret;
+      // packages and objects are paired in secondary inference
+      for (size_t i = 0; i < objects.size() && i < packages.size(); ++i) {
+        StreamContext* ctx = stream_ctxs_[packages[i]->GetStreamIndex()].get();
+        auto frame = packages[i]->collection.Get<CNDataFramePtr>(kCNDataFrameTag);
+        ctx->cache->Update(objects[i].get(), keys[i], frame->frame_id);
+      }
+      return 0;
     }
-    return postproc_->Execute(net_outputs, *model_info, packages, label_strings_);
+    return postproc_->Execute(net_outputs, model_info, packages, label_strings_);
   }
   return -1;
 }
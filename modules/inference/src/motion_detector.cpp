@@ -0,0 +1,83 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "motion_detector.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace cnstream {
+
+constexpr int MotionDetector::kGridWidth;
+constexpr int MotionDetector::kGridHeight;
+constexpr int MotionDetector::kCellThreshold;
+
+void MotionDetector::Downscale(const uint8_t *y_plane, int stride, int width, int height,
+                               std::vector<uint8_t> *grid) {
+  grid->resize(kGridWidth * kGridHeight);
+  // sample at most about 8x8 pixels of each cell, which is enough to tell the mean luma
+  int step_x = std::max(width / kGridWidth / 8, 1);
+  int step_y = std::max(height / kGridHeight / 8, 1);
+  for (int gy = 0; gy < kGridHeight; ++gy) {
+    int y0 = gy * height / kGridHeight;
+    int y1 = std::max((gy + 1) * height / kGridHeight, y0 + 1);
+    for (int gx = 0; gx < kGridWidth; ++gx) {
+      int x0 = gx * width / kGridWidth;
+      int x1 = std::max((gx + 1) * width / kGridWidth, x0 + 1);
+      uint32_t sum = 0, count = 0;
+      for (int y = y0; y < y1; y += step_y) {
+        const uint8_t *row = y_plane + static_cast<size_t>(y) * stride;
+        for (int x = x0; x < x1; x += step_x) sum += row[x];
+        count += (x1 - x0 + step_x - 1) / step_x;
+      }
+      (*grid)[gy * kGridWidth + gx] = static_cast<uint8_t>(sum / count);
+    }
+  }
+}
+
+float MotionDetector::ChangedRatio(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+  if (a.size() != b.size() || a.empty()) return 1.f;
+  size_t changed = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    changed += std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])) > kCellThreshold;
+  }
+  return static_cast<float>(changed) / a.size();
+}
+
+bool MotionDetector::Check(const uint8_t *y_plane, int stride, int width, int height) {
+  ++checked_total_;
+  if (!y_plane || width < kGridWidth || height < kGridHeight) return true;
+  Downscale(y_plane, stride, width, height, &current_);
+  bool infer = width != width_ || height != height_ || reference_.empty() ||
+               (max_skip_ && skipped_ >= max_skip_) || ChangedRatio(current_, reference_) > threshold_;
+  if (infer) {
+    std::swap(reference_, current_);
+    width_ = width;
+    height_ = height;
+    skipped_ = 0;
+    return true;
+  }
+  ++skipped_;
+  ++skipped_total_;
+  return false;
+}
+
+}  // namespace cnstream
@@ -0,0 +1,84 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef MODULES_INFERENCE_MOTION_DETECTOR_HPP_
+#define MODULES_INFERENCE_MOTION_DETECTOR_HPP_
+
+#include <cstdint>
+#include <vector>
+
+namespace cnstream {
+
+/**
+ * @brief MotionDetector tells whether a frame changed since the last inferred frame of a stream.
+ *
+ * The luma plane is downscaled to a small grid by averaging cells, and compared with the grid of the last inferred
+ * frame. A frame is changed if the ratio of grid cells whose difference exceeds kCellThreshold is larger than the
+ * threshold. The reference grid is only replaced by inferred frames, so slow changes are accumulated.
+ *
+ * Not thread-safe, a detector is used by one stream.
+ */
+class MotionDetector {
+ public:
+  static constexpr int kGridWidth = 64;
+  static constexpr int kGridHeight = 36;
+  static constexpr int kCellThreshold = 12;  ///< luma difference of a cell regarded as changed
+
+  /**
+   * @param threshold The ratio of changed cells in (0, 1].
+   * @param max_skip The max number of frames skipped in a row. 0 means no limit.
+   */
+  MotionDetector(float threshold, uint32_t max_skip) : threshold_(threshold), max_skip_(max_skip) {}
+
+  /**
+   * @brief Checks the luma plane of a frame.
+   *
+   * @return Returns true if the frame should be inferred, i.e. it is changed, it is the first frame, the resolution
+   *         changed or max_skip frames have been skipped. Otherwise returns false and the frame could be skipped.
+   */
+  bool Check(const uint8_t *y_plane, int stride, int width, int height);
+
+  /**
+   * @brief Downscales the luma plane to kGridWidth x kGridHeight by averaging sampled pixels of each cell.
+   */
+  static void Downscale(const uint8_t *y_plane, int stride, int width, int height, std::vector<uint8_t> *grid);
+
+  /**
+   * @brief Returns the ratio of cells whose difference exceeds kCellThreshold.
+   */
+  static float ChangedRatio(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b);
+
+  uint64_t SkippedCount() const { return skipped_total_; }
+  uint64_t CheckedCount() const { return checked_total_; }
+
+ private:
+  float threshold_;
+  uint32_t max_skip_;
+  int width_ = 0;
+  int height_ = 0;
+  uint32_t skipped_ = 0;
+  uint64_t skipped_total_ = 0;
+  uint64_t checked_total_ = 0;
+  std::vector<uint8_t> reference_;
+  std::vector<uint8_t> current_;
+};  // class MotionDetector
+
+}  // namespace cnstream
+
+#endif  // MODULES_INFERENCE_MOTION_DETECTOR_HPP_
@@ -28,6 +28,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -53,11 +54,15 @@ struct OsdParams {
   float box_thickness = 1;
   float label_size = 1;
   bool hw_accel = false;  // whether to use hw to accelrate OSD
+  int tile_num = 0;  // tiles of a frame drawn concurrently, 0 means decided by the frame height
+  bool label_cache = false;  // whether to keep rendered labels of tracked objects
+  bool show_stats = false;
 };
 
 struct OsdContext;
 
-class CnOsd;
+class CnFont;
+class OsdMemPool;
 
 /**
  * @brief Draw objects on image,output is bgr24 images
@@ -125,10 +130,15 @@ class Osd : public Module, public ModuleCreator<Osd> {
   bool CheckParamSet(const ModuleParamSet& paramSet) const override;
 
  private:
-  std::shared_ptr<OsdContext> GetOsdContext(CNFrameInfoPtr data);
+  OsdContext* GetOsdContext(CNFrameInfoPtr data);
   std::unique_ptr<ModuleParamsHelper<OsdParams>> param_helper_ = nullptr;
-  std::map<std::string, std::shared_ptr<OsdContext>> osd_ctxs_;
-  RwLock ctx_lock_;
+  std::shared_ptr<CnFont> font_ = nullptr;
+  std::shared_ptr<OsdMemPool> mempool_ = nullptr;
+  // contexts by stream index, a context is only used by the thread processing its stream
+  std::vector<std::unique_ptr<OsdContext>> contexts_;
+  // stream indexes of the contexts created, to release them at the end of streams
+  std::map<std::string, uint32_t> stream_indexes_;
+  std::mutex stream_indexes_mutex_;
 };  // class Osd
 
 }  // namespace cnstream
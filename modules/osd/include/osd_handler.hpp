@@ -42,6 +42,7 @@ class OsdHandler : virtual public cnstream::ReflexObjectEx<OsdHandler> {
     std::vector<std::string> attributes;
     int label_id;
     bool attr_down = true;
+    std::string track_id;  // optional, labels are cached by track id with the label_cache parameter of Osd
   };
   static OsdHandler *Create(const std::string &name);
   virtual ~OsdHandler() {}
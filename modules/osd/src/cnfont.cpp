@@ -20,7 +20,9 @@
 
 #include "cnfont.hpp"
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
@@ -82,10 +84,13 @@ void CnFont::restoreFont(float font_pixel, float space, float step) {
 
   // Set character size
   FT_Set_Pixel_Sizes(m_face, static_cast<int>(m_fontSize.val[0]), 0);
+  glyphs_.clear();
+  for (wchar_t wc = kFirstAscii; wc <= kLastAscii; ++wc) {
+    ascii_glyphs_[wc - kFirstAscii] = Rasterize(wc);
+  }
 }
 
 uint32_t CnFont::GetFontPixel() {
-  std::unique_lock<std::mutex> guard(mutex_);
   if (!is_initialized_) {
     LOGE(OSD) << " [Osd] Please init CnFont first.";
     return 0;
@@ -93,33 +98,120 @@ uint32_t CnFont::GetFontPixel() {
   return m_fontSize.val[0];
 }
 
-int CnFont::ToWchar(char*& src, wchar_t*& dest, const char* locale) {
-  if (src == NULL) {
-    dest = NULL;
-    return 0;
+namespace {
+
+// Draws the mask with its bottom left at pos, blending color with alpha on the image
+void BlendMask(cv::Mat image, const cv::Mat& mask, const cv::Point& pos, const cv::Scalar& color, float alpha) {
+  cv::Rect rect(pos.x, pos.y - mask.rows + 1, mask.cols, mask.rows);
+  cv::Rect clipped = rect & cv::Rect(0, 0, image.cols, image.rows);
+  if (clipped.area() <= 0) return;
+  cv::Mat dst = image(clipped);
+  cv::Mat roi_mask = mask(clipped - rect.tl());
+  if (alpha >= 1.f) {
+    dst.setTo(color, roi_mask);
+    return;
+  }
+  cv::Mat blended;
+  cv::addWeighted(dst, 1 - alpha, cv::Mat(dst.size(), dst.type(), color), alpha, 0, blended);
+  blended.copyTo(dst, roi_mask);
+}
+
+// Decodes the UTF-8 string, returns false if it is not valid
+bool DecodeUtf8(const char* text, std::vector<wchar_t>* w_str) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+  while (*p) {
+    uint32_t code = *p;
+    int trail = 0;
+    if (code < 0x80) {
+      trail = 0;
+    } else if ((code & 0xE0) == 0xC0) {
+      code &= 0x1F, trail = 1;
+    } else if ((code & 0xF0) == 0xE0) {
+      code &= 0x0F, trail = 2;
+    } else if ((code & 0xF8) == 0xF0) {
+      code &= 0x07, trail = 3;
+    } else {
+      return false;
+    }
+    ++p;
+    for (int i = 0; i < trail; ++i, ++p) {
+      if ((*p & 0xC0) != 0x80) return false;
+      code = (code << 6) | (*p & 0x3F);
+    }
+    w_str->push_back(static_cast<wchar_t>(code));
   }
+  return true;
+}
 
-  // Set the locale according to the environment variable
-  setlocale(LC_CTYPE, locale);
+}  // namespace
 
-  // Gets the required wide character size to convert to
-  int w_size = mbstowcs(NULL, src, 0) + 1;
+constexpr size_t CnFont::kMaxGlyphCacheSize;
+constexpr wchar_t CnFont::kFirstAscii;
+constexpr wchar_t CnFont::kLastAscii;
 
-  if (w_size == 0) {
-    dest = NULL;
-    return -1;
+CnFont::GlyphPtr CnFont::GetGlyph(wchar_t wc) {
+  uint64_t key = (static_cast<uint64_t>(m_fontSize.val[0]) << 32) | static_cast<uint32_t>(wc);
+  auto iter = glyphs_.find(key);
+  if (iter != glyphs_.end()) return iter->second;
+
+  GlyphPtr glyph = Rasterize(wc);
+  if (glyphs_.size() >= kMaxGlyphCacheSize) glyphs_.clear();
+  glyphs_.emplace(key, glyph);
+  return glyph;
+}
+
+CnFont::GlyphPtr CnFont::Rasterize(wchar_t wc) {
+  // Generate a binary bitmap of a font based on unicode
+  FT_UInt glyph_index = FT_Get_Char_Index(m_face, wc);
+  FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
+  FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_MONO);
+
+  FT_GlyphSlot slot = m_face->glyph;
+
+  // Cols and rows
+  int rows = slot->bitmap.rows;
+  int cols = slot->bitmap.width;
+
+  std::shared_ptr<Glyph> glyph = std::make_shared<Glyph>();
+  if (rows > 0 && cols > 0) {
+    glyph->mask = cv::Mat(rows, cols, CV_8UC1, cv::Scalar(0));
+    for (int i = 0; i < rows; ++i) {
+      uchar* dst = glyph->mask.ptr<uchar>(i);
+      for (int j = 0; j < cols; ++j) {
+        int off = i * slot->bitmap.pitch + j / 8;
+        if (slot->bitmap.buffer[off] & (0xC0 >> (j % 8))) dst[j] = 255;
+      }
+    }
   }
 
-  dest = new (std::nothrow) wchar_t[w_size];
-  if (!dest) {
-    return -1;
+  return glyph;
+}
+
+bool CnFont::GetGlyphs(char* text, std::vector<GlyphPtr>* glyphs, double* space, double* sep) {
+  if (!is_initialized_) {
+    LOGE(OSD) << " [Osd] Please init CnFont first.";
+    return false;
   }
 
-  int ret = mbstowcs(dest, src, strlen(src) + 1);
-  if (ret <= 0) {
-    return -1;
+  std::vector<wchar_t> w_str;
+  if (!DecodeUtf8(text, &w_str)) {
+    LOGE(OSD) << "[CnFont] [DecodeUtf8] failed.";
+    return false;
   }
-  return 0;
+
+  glyphs->reserve(glyphs->size() + w_str.size());
+  std::unique_lock<std::mutex> guard(mutex_, std::defer_lock);
+  for (wchar_t wc : w_str) {
+    if (wc >= kFirstAscii && wc <= kLastAscii) {
+      glyphs->push_back(ascii_glyphs_[wc - kFirstAscii]);
+      continue;
+    }
+    if (!guard.owns_lock()) guard.lock();
+    glyphs->push_back(GetGlyph(wc));
+  }
+  *space = m_fontSize.val[0] * m_fontSize.val[1];
+  *sep = m_fontSize.val[0] * m_fontSize.val[2];
+  return true;
 }
 
 bool CnFont::GetTextSize(char* text, uint32_t* width, uint32_t* height) {
@@ -127,24 +219,17 @@ bool CnFont::GetTextSize(char* text, uint32_t* width, uint32_t* height) {
     LOGE(OSD) << " [CnFont] [GetTextSize] The text, width or height is nullptr.";
     return false;
   }
-  std::unique_lock<std::mutex> guard(mutex_);
 
-  if (!is_initialized_) {
-    LOGE(OSD) << " [CnFont] [GetTextSize] Please init CnFont first.";
+  std::vector<GlyphPtr> glyphs;
+  double space, sep;
+  if (!GetGlyphs(text, &glyphs, &space, &sep)) {
+    LOGE(OSD) << "[CnFont] [GetTextSize] failed.";
     return false;
   }
-  wchar_t* w_str;
-  if (ToWchar(text, w_str) == -1) {
-    LOGE(OSD) << "[CnFont] [GetTextSize] [ToWchar] failed.";
-    return -1;
-  }
-
-  uint32_t w_char_width = 0, w_char_height = 0;
-  double space = m_fontSize.val[0] * m_fontSize.val[1];
-  double sep = m_fontSize.val[0] * m_fontSize.val[2];
 
-  for (int i = 0; w_str[i] != '\0'; ++i) {
-    GetWCharSize(w_str[i], &w_char_width, &w_char_height);
+  for (const GlyphPtr& glyph : glyphs) {
+    uint32_t w_char_width = glyph->mask.cols;
+    uint32_t w_char_height = glyph->mask.rows;
     if (*height < w_char_height) {
       *height = w_char_height;
     }
@@ -158,174 +243,65 @@ bool CnFont::GetTextSize(char* text, uint32_t* width, uint32_t* height) {
   return true;
 }
 
-void CnFont::GetWCharSize(wchar_t wc, uint32_t* width, uint32_t* height) {
-  if (!width || !height) {
-    LOGE(OSD) << " [CnFont] [GetWCharSize] The width or height is nullptr.";
-    return;
-  }
-
-  FT_UInt glyph_index = FT_Get_Char_Index(m_face, wc);
-  FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-  FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_MONO);
-
-  FT_GlyphSlot slot = m_face->glyph;
-
-  // height and width
-  *height = slot->bitmap.rows;
-  *width = slot->bitmap.width;
+int CnFont::putText(CNDataFramePtr frame, char* text, cv::Point pos, cv::Scalar color) {
+  return putText(frame->ImageBGR(), text, pos, color);
 }
 
-int CnFont::putText(CNDataFramePtr frame, char* text, cv::Point pos, cv::Scalar color) {
-  /*cv::Mat img = frame->ImageBGR();
-  if (img.data == nullptr) {
-    LOGE(OSD) << "[CnFont] [putText] img.data is nullptr.";
-    return -1;
-  }
-  */
-  std::unique_lock<std::mutex> guard(mutex_);
+int CnFont::putText(cv::Mat image, char* text, cv::Point pos, cv::Scalar color) {
   if (text == nullptr) {
     LOGE(OSD) << "[CnFont] [putText] text is nullptr.";
-  }
-
-  if (!is_initialized_) {
-    LOGE(OSD) << " [Osd] Please init CnFont first.";
     return -1;
   }
 
-  wchar_t* w_str;
-  if (ToWchar(text, w_str) == -1) {
-    LOGE(OSD) << "[CnFont] [putText] [ToWchar] failed.";
+  std::vector<GlyphPtr> glyphs;
+  double space, sep;
+  if (!GetGlyphs(text, &glyphs, &space, &sep)) {
+    LOGE(OSD) << "[CnFont] [putText] failed.";
     return -1;
   }
 
-  for (int i = 0; w_str[i] != '\0'; ++i) {
-    putWChar(frame, w_str[i], pos, color);
+  for (const GlyphPtr& glyph : glyphs) {
+    int cols = glyph->mask.cols;
+    if (cols) BlendMask(image, glyph->mask, pos, color, m_fontDiaphaneity);
+    // Modify the output position of the next word
+    pos.x += static_cast<int>((cols ? cols : space) + sep);
   }
 
   return 0;
 }
 
-// Output the current character and update the m pos position
-void CnFont::putWChar(CNDataFramePtr frame, wchar_t wc, cv::Point& pos, cv::Scalar color) {
-  // Generate a binary bitmap of a font based on unicode
-  FT_UInt glyph_index = FT_Get_Char_Index(m_face, wc);
-  FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-  FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_MONO);
-
-  FT_GlyphSlot slot = m_face->glyph;
-
-  // Cols and rows
-  int rows = slot->bitmap.rows;
-  int cols = slot->bitmap.width;
-
-  for (int i = 0; i < rows; ++i) {
-    for (int j = 0; j < cols; ++j) {
-      int off = i * slot->bitmap.pitch + j / 8;
-      if (slot->bitmap.buffer[off] & (0xC0 >> (j % 8))) {
-        int r = pos.y - (rows - 1 - i);
-        int c = pos.x + j;
-
-        cv::Mat img = frame->ImageBGR();
-        if (r >= 0 && r < static_cast<int>(frame->buf_surf->GetHeight()) &&
-            c >= 0 && c < static_cast<int>(frame->buf_surf->GetWidth())) {
-          cv::Vec3b pixel = img.at<cv::Vec3b>(cv::Point(c, r));
-          cv::Scalar scalar = cv::Scalar(pixel.val[0], pixel.val[1], pixel.val[2]);
-
-          // Color fusion
-          float p = m_fontDiaphaneity;
-          for (int k = 0; k < 4; ++k) {
-            scalar.val[k] = scalar.val[k] * (1 - p) + color.val[k] * p;
-          }
-          img.at<cv::Vec3b>(cv::Point(c, r))[0] = (uint8_t)(scalar.val[0]);
-          img.at<cv::Vec3b>(cv::Point(c, r))[1] = (uint8_t)(scalar.val[1]);
-          img.at<cv::Vec3b>(cv::Point(c, r))[2] = (uint8_t)(scalar.val[2]);
-        }
-      }
-    }
-  }
-  // Modify the output position of the next word
-  double space = m_fontSize.val[0] * m_fontSize.val[1];
-  double sep = m_fontSize.val[0] * m_fontSize.val[2];
-
-  pos.x += static_cast<int>((cols ? cols : space) + sep);
-}
-
 int CnFont::putText(char* text, cv::Scalar color, cv::Scalar bg_color, void* bitmap, cv::Size size) {
   if (text == nullptr || bitmap == nullptr) {
     LOGE(OSD) << "[CnFont] [putText] text or bitmap is nullptr.";
-  }
-
-  std::unique_lock<std::mutex> guard(mutex_);
-  if (!is_initialized_) {
-    LOGE(OSD) << " [Osd] Please init CnFont first.";
     return -1;
   }
 
-  wchar_t* w_str;
-  if (ToWchar(text, w_str) == -1) {
-    LOGE(OSD) << "[CnFont] [putText] [ToWchar] failed.";
+  std::vector<GlyphPtr> glyphs;
+  double space, sep;
+  if (!GetGlyphs(text, &glyphs, &space, &sep)) {
+    LOGE(OSD) << "[CnFont] [putText] failed.";
     return -1;
   }
 
+  uint8_t b = static_cast<uint8_t>(color.val[0]);
+  uint8_t g = static_cast<uint8_t>(color.val[1]);
+  uint8_t r = static_cast<uint8_t>(color.val[2]);
+  uint16_t argb1555 =
+      0x8000 + (b >> 3) + (static_cast<uint16_t>(g >> 3) << 5) + (static_cast<uint16_t>(r >> 3) << 10);
+  size_t pitch = (size.width * 2 + 63) / 64 * 64;
+  cv::Mat argb(size.height, size.width, CV_16UC1, bitmap, pitch);
+
   cv::Point pos(0, size.height - 1);
-  for (int i = 0; w_str[i] != '\0'; ++i) {
-    putWChar(w_str[i], pos, color, bg_color, bitmap, size);
+  for (const GlyphPtr& glyph : glyphs) {
+    int cols = glyph->mask.cols;
+    if (cols) BlendMask(argb, glyph->mask, pos, cv::Scalar(argb1555), 1.f);
+    // Modify the output position of the next word
+    pos.x += static_cast<int>((cols ? cols : space) + sep);
   }
 
   return 0;
 }
 
-// Output the current character and update the m pos position
-void CnFont::putWChar(wchar_t wc, cv::Point& pos, cv::Scalar color, cv::Scalar bg_color, void* bitmap, cv::Size size) {
-  // Generate a binary bitmap of a font based on unicode
-  FT_UInt glyph_index = FT_Get_Char_Index(m_face, wc);
-  FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-  FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_MONO);
-
-  FT_GlyphSlot slot = m_face->glyph;
-
-  // Cols and rows
-  int rows = slot->bitmap.rows;
-  int cols = slot->bitmap.width;
-
-  uint8_t* base = static_cast<uint8_t*>(bitmap);
-  uint32_t pitch = (size.width * 2 + 63) / 64 * 64;
-  for (int i = 0; i < rows; ++i) {
-    for (int j = 0; j < cols; ++j) {
-      int off = i * slot->bitmap.pitch + j / 8;
-      if (slot->bitmap.buffer[off] & (0xC0 >> (j % 8))) {
-        int r = pos.y - (rows - 1 - i);
-        int c = pos.x + j;
-        if (r >= 0 && r < size.height && c >= 0 && c < size.width) {
-          uint8_t* pixel = base + r * pitch + c * 2;
-
-#if 0
-          cv::Scalar scalar = bg_color;
-           // Color fusion
-          float p = m_fontDiaphaneity;
-          for (int k = 0; k < 4; ++k) {
-            scalar.val[k] = scalar.val[k] * (1 - p) + color.val[k] * p;
-          }
-#else
-          cv::Scalar scalar = color;
-#endif
-          uint8_t b = static_cast<uint8_t>(scalar.val[0]);
-          uint8_t g = static_cast<uint8_t>(scalar.val[1]);
-          uint8_t r = static_cast<uint8_t>(scalar.val[2]);
-          uint16_t argb1555 =
-              0x8000 + (b >> 3) + (static_cast<uint16_t>(g >> 3) << 5) + (static_cast<uint16_t>(r >> 3) << 10);
-          *reinterpret_cast<uint16_t*>(pixel) = argb1555;
-        }
-      }
-    }
-  }
-  // Modify the output position of the next word
-  double space = m_fontSize.val[0] * m_fontSize.val[1];
-  double sep = m_fontSize.val[0] * m_fontSize.val[2];
-
-  pos.x += static_cast<int>((cols ? cols : space) + sep);
-}
-
 #endif
 
 }  // namespace cnstream
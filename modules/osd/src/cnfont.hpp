@@ -27,7 +27,12 @@
 #include <locale.h>
 #include <wchar.h>
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include FT_FREETYPE_H
 #endif
 
@@ -38,6 +43,10 @@ namespace cnstream {
 
 /**
  * @brief Show chinese label in the image
+ *
+ * Glyphs are rasterized once and cached by font size and character, the cache is shared by all threads using the
+ * font. Glyphs of printable ASCII characters are rasterized at initialization and are read without lock, only the
+ * lookup of other characters is serialized. Drawing glyphs is done without lock.
  */
 class CnFont {
 #ifdef HAVE_FREETYPE
@@ -60,6 +69,8 @@ class CnFont {
 
   /**
    * @brief Configure font Settings
+   *
+   * @note It should not be called when the font is used by other threads.
    */
   void restoreFont(float font_pixel = 30, float space = 0.4, float step = 0.15);
   /**
@@ -72,36 +83,33 @@ class CnFont {
    * @return Size of the string
    */
   int putText(CNDataFramePtr frame, char* text, cv::Point pos, cv::Scalar color);
+  /**
+   * @brief Displays the string on a BGR image, or on a CV_8UC1 mask with color Scalar(255)
+   */
+  int putText(cv::Mat image, char* text, cv::Point pos, cv::Scalar color);
   bool GetTextSize(char* text, uint32_t* width, uint32_t* height);
   uint32_t GetFontPixel();
 
   int putText(char* text, cv::Scalar color, cv::Scalar bg_color, void* argb1555, cv::Size size);
 
  private:
-  void GetWCharSize(wchar_t wc, uint32_t* width, uint32_t* height);
   /**
-   * @brief Converts character to wide character
-   * @param
-   *   src: The original string
-   *   dst: The Destination wide string
-   *   locale: Coded form
-   * @return
-   *   -1: Conversion failure
-   *    0: Conversion success
+   * @brief Pre-rasterized glyph, the mask is 255 where the glyph is drawn and its bottom row is on the baseline
    */
-  int ToWchar(char*& src, wchar_t*& dest, const char* locale = "C.UTF-8");  // NOLINT
+  struct Glyph {
+    cv::Mat mask;
+  };
+  using GlyphPtr = std::shared_ptr<const Glyph>;
 
   /**
-   * @brief Print single wide character in the image
-   * @param
-   *   img: source image
-   *   wc: single wide character
-   *   pos: the show of position
-   *   color: the color of font
+   * @brief Gets glyphs of the text, and the advance of space characters and the separation between characters
    */
-  void putWChar(CNDataFramePtr frame, wchar_t wc, cv::Point& pos, cv::Scalar color);  // NOLINT
-  void putWChar(wchar_t wc, cv::Point& pos, cv::Scalar color, cv::Scalar bg_color, void* bitmap,  // NOLINT
-                cv::Size size);
+  bool GetGlyphs(char* text, std::vector<GlyphPtr>* glyphs, double* space, double* sep);
+  // rasterizes the glyph at the first use, mutex_ must be held
+  GlyphPtr GetGlyph(wchar_t wc);
+  // rasterizes the glyph with the current font size, mutex_ must be held
+  GlyphPtr Rasterize(wchar_t wc);
+
   CnFont& operator=(const CnFont&);
 
   FT_Library m_library;
@@ -115,12 +123,20 @@ class CnFont {
   float m_fontDiaphaneity;
 
   std::mutex mutex_;
+  // glyphs by font size and character
+  std::unordered_map<uint64_t, GlyphPtr> glyphs_;
+  static constexpr size_t kMaxGlyphCacheSize = 8192;
+  // printable ASCII characters, immutable after initialization
+  static constexpr wchar_t kFirstAscii = 0x20;
+  static constexpr wchar_t kLastAscii = 0x7E;
+  GlyphPtr ascii_glyphs_[kLastAscii - kFirstAscii + 1];
 #else
 
  public:
   explicit CnFont(const char* font_path) {}
   ~CnFont() {}
   int putText(CNDataFramePtr frame, char* text, cv::Point pos, cv::Scalar color) { return 0; }  // NOLINT
+  int putText(cv::Mat image, char* text, cv::Point pos, cv::Scalar color) { return 0; }  // NOLINT
   bool GetTextSize(char* text, uint32_t* width, uint32_t* height) { return true; }
   uint32_t GetFontPixel() { return 0; }
   int putText(char* text, cv::Scalar color, cv::Scalar bg_color, void* argb1555, cv::Size size) { return 0; }  // NOLINT
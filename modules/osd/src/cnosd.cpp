@@ -21,6 +21,7 @@
 #include "cnosd.hpp"
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -33,6 +34,9 @@
 
 #define CLIP(x) x < 0 ? 0 : (x > 1 ? 1 : x)
 
+// frames are split into tiles of about these rows to be painted concurrently, if tile_num is not set
+static constexpr int kAutoTileRows = 540;
+
 // #define LOCAL_DEBUG_DUMP_IMAGE 1
 
 #ifdef LOCAL_DEBUG_DUMP_IMAGE
@@ -97,6 +101,22 @@ static cv::Scalar HSV2RGB(const float h, const float s, const float v) {
   return cv::Scalar(r * 255, g * 255, b * 255);
 }
 
+// Key of a label in the label cache, labels of untracked objects are not cached
+static std::string LabelCacheKey(const std::string &track_id, const std::string &line) {
+  if (track_id.empty() || track_id[0] == '-') return "";
+  return track_id + "/" + line;
+}
+
+// Runs the function on ranges in the opencv pool, parallel_for_ of opencv 2 does not take lambdas
+class ParallelBody : public cv::ParallelLoopBody {
+ public:
+  explicit ParallelBody(const std::function<void(const cv::Range &)> &func) : func_(func) {}
+  void operator()(const cv::Range &range) const override { func_(range); }
+
+ private:
+  std::function<void(const cv::Range &)> func_;
+};
+
 static std::vector<cv::Scalar> GenerateColorsForCategories(const int n) {
   std::vector<cv::Scalar> colors;
   cv::RNG rng(12345);
@@ -110,16 +130,207 @@ static std::vector<cv::Scalar> GenerateColorsForCategories(const int n) {
   return colors;
 }
 
+OsdMemPool::OsdMemPool() {
+  CnedkBufSurfaceCreateParams create_params;
+  memset(&create_params, 0, sizeof(create_params));
+  create_params.device_id = 0;  // TODO(gaoyujia)
+  create_params.batch_size = 1;
+  create_params.size = kOsdBlockSize;
+  create_params.mem_type = CNEDK_BUF_MEM_UNIFIED;
+  pool_.CreatePool(&create_params, kOsdBlockNum);
+}
+
+OsdMemPool::~OsdMemPool() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  pool_.DestroyPool(5000);
+}
+
+cnedk::BufSurfWrapperPtr OsdMemPool::GetMem(size_t nSize) {
+  cnedk::BufSurfWrapperPtr surfPtr = nullptr;
+  if (nSize <= kOsdBlockSize) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    surfPtr = pool_.GetBufSurfaceWrapper(0);
+  }
+
+  if (!surfPtr) {
+    CnedkBufSurfaceCreateParams create_params;
+    memset(&create_params, 0, sizeof(create_params));
+    create_params.device_id = 0;
+    create_params.batch_size = 1;
+    create_params.size = nSize;
+    create_params.mem_type = CNEDK_BUF_MEM_UNIFIED;
+    CnedkBufSurface *surf = nullptr;
+    if (CnedkBufSurfaceCreate(&surf, &create_params) < 0) {
+      LOGE(OSD) << "GetMem(): Create BufSurface failed";
+      return nullptr;
+    }
+    surfPtr = std::make_shared<cnedk::BufSurfaceWrapper>(surf);
+  }
+
+  memset(surfPtr->GetMappedData(0), 0, nSize);
+  return surfPtr;
+}
+
 CnOsd::CnOsd(const std::vector<std::string> &labels) : labels_(labels) {
   colors_ = GenerateColorsForCategories(labels_.size());
 }
 
+bool CnOsd::PrepareFrame(CNDataFramePtr frame) {
+  if (cur_frame_.lock() == frame) return draw_yuv_;
+  cur_frame_ = frame;
+  painter_.Unbind();
+  paint_ops_.clear();
+  draw_yuv_ = false;
+  if (hw_accel_) return false;
+  CnedkBufSurfaceColorFormat fmt = frame->buf_surf->GetColorFormat();
+  if (fmt != CNEDK_BUF_COLOR_FORMAT_NV12 && fmt != CNEDK_BUF_COLOR_FORMAT_NV21) return false;
+  if (frame->HasBGRImage()) return false;
+
+  CnedkBufSurfaceSyncForCpu(frame->buf_surf->GetBufSurface(), -1, -1);
+  painter_.Bind(static_cast<uint8_t *>(frame->buf_surf->GetHostData(0)), frame->buf_surf->GetStride(0),
+                static_cast<uint8_t *>(frame->buf_surf->GetHostData(1)), frame->buf_surf->GetStride(1),
+                frame->buf_surf->GetWidth(), frame->buf_surf->GetHeight(), fmt == CNEDK_BUF_COLOR_FORMAT_NV21);
+  draw_yuv_ = true;
+  return true;
+}
+
+void CnOsd::AddTextOp(const std::string &text, const cv::Point &pos, double scale, int thickness,
+                      const cv::Scalar &color, const std::string &cache_key) {
+  PaintOp op;
+  op.type = PaintOp::DRAW_TEXT;
+  op.color = color;
+  op.thickness = thickness;
+  op.text = text;
+  op.text_pos = pos;
+  op.text_scale = scale;
+  op.cache_key = cache_key;
+  paint_ops_.push_back(std::move(op));
+}
+
+void CnOsd::AddCnFontTextOp(const std::string &text, const cv::Point &pos, const cv::Size &size,
+                            const cv::Scalar &color, const std::string &cache_key) {
+  PaintOp op;
+  op.type = PaintOp::DRAW_TEXT;
+  op.color = color;
+  op.text = text;
+  op.text_pos = pos;
+  op.use_cn_font = true;
+  op.text_size = size;
+  op.cache_key = cache_key;
+  paint_ops_.push_back(std::move(op));
+}
+
+void CnOsd::RenderText(PaintOp *op) const {
+  if (op->use_cn_font) {
+    if (op->text_size.area() <= 0) return;
+    // glyphs of CnFont are drawn with their bottom on the position
+    op->mask = cv::Mat(op->text_size.height, op->text_size.width, CV_8UC1, cv::Scalar(0));
+    op->top_left = op->text_pos - cv::Point(0, op->text_size.height - 1);
+    cn_font_->putText(op->mask, const_cast<char *>(op->text.c_str()), cv::Point(0, op->text_size.height - 1),
+                      cv::Scalar(255));
+    return;
+  }
+  int baseline = 0;
+  cv::Size size = cv::getTextSize(op->text, font_, op->text_scale, op->thickness, &baseline);
+  // the mask covers the glyphs above and below the baseline with their strokes
+  cv::Rect rect(op->text_pos.x - op->thickness, op->text_pos.y - size.height - op->thickness,
+                size.width + 2 * op->thickness, size.height + baseline + 2 * op->thickness);
+  op->mask = cv::Mat(rect.height, rect.width, CV_8UC1, cv::Scalar(0));
+  op->top_left = rect.tl();
+  cv::putText(op->mask, op->text, op->text_pos - rect.tl(), font_, op->text_scale, cv::Scalar(255), op->thickness);
+}
+
+bool CnOsd::FindCachedLabel(PaintOp *op) {
+  ++label_lookups_;
+  auto iter = cached_labels_.find(op->cache_key);
+  if (iter == cached_labels_.end()) return false;
+  CachedLabel &label = iter->second;
+  if (label.text != op->text || label.text_scale != op->text_scale || label.thickness != op->thickness ||
+      label.use_cn_font != op->use_cn_font || label.text_size != op->text_size) {
+    return false;
+  }
+  ++label_hits_;
+  label.last_used = paint_count_;
+  op->mask = label.mask;
+  op->top_left = op->text_pos + label.offset;
+  return true;
+}
+
+void CnOsd::CacheLabel(const PaintOp &op) {
+  CachedLabel &label = cached_labels_[op.cache_key];
+  label.text = op.text;
+  label.text_scale = op.text_scale;
+  label.thickness = op.thickness;
+  label.use_cn_font = op.use_cn_font;
+  label.text_size = op.text_size;
+  label.mask = op.mask;
+  label.offset = op.top_left - op.text_pos;
+  label.last_used = paint_count_;
+}
+
+void CnOsd::PaintFrame() {
+  if (paint_ops_.empty() || !painter_.IsBound()) return;
+  ++paint_count_;
+  std::vector<PaintOp *> texts;
+  for (auto &op : paint_ops_) {
+    if (op.type != PaintOp::DRAW_TEXT) continue;
+    if (label_cache_ && !op.cache_key.empty() && FindCachedLabel(&op)) continue;
+    texts.push_back(&op);
+  }
+  cv::parallel_for_(cv::Range(0, static_cast<int>(texts.size())), ParallelBody([&](const cv::Range &range) {
+                      for (int i = range.start; i < range.end; ++i) RenderText(texts[i]);
+                    }));
+  if (label_cache_) {
+    for (PaintOp *op : texts) {
+      if (!op->cache_key.empty()) CacheLabel(*op);
+    }
+    for (auto iter = cached_labels_.begin(); iter != cached_labels_.end();) {
+      if (paint_count_ - iter->second.last_used > kLabelCacheMaxIdle) {
+        iter = cached_labels_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+
+  // tiles start at even rows, so they do not share chroma
+  int height = painter_.Height();
+  int tiles = tile_num_ > 0 ? tile_num_ : height / kAutoTileRows;
+  tiles = std::max(1, std::min(tiles, height / 2));
+  int tile_rows = ((height + tiles - 1) / tiles + 1) & ~1;
+  tiles = (height + tile_rows - 1) / tile_rows;
+  cv::parallel_for_(cv::Range(0, tiles), ParallelBody([&](const cv::Range &range) {
+                      for (int tile = range.start; tile < range.end; ++tile) {
+                        YuvPainter painter = painter_;
+                        painter.SetClip(cv::Rect(0, tile * tile_rows, painter.Width(), tile_rows));
+                        for (const auto &op : paint_ops_) {
+                          switch (op.type) {
+                            case PaintOp::FILL_RECT:
+                              painter.FillRect(cv::Rect(op.top_left, op.bottom_right + cv::Point(1, 1)), op.color);
+                              break;
+                            case PaintOp::DRAW_RECT:
+                              painter.DrawRect(op.top_left, op.bottom_right, op.color, op.thickness);
+                              break;
+                            case PaintOp::DRAW_TEXT:
+                              painter.DrawMask(op.mask, op.top_left, op.color);
+                              break;
+                          }
+                        }
+                      }
+                    }));
+}
+
 void CnOsd::DrawLogo(CNDataFramePtr frame, std::string logo) /*const*/ {
-  cv::Mat image = frame->ImageBGR();
-  cv::Point logo_pos(5, image.rows - 5);
   uint32_t scale = 1;
   uint32_t thickness = 2;
   cv::Scalar color(200, 200, 200);
+  if (PrepareFrame(frame)) {
+    cv::Point logo_pos(5, (frame->buf_surf->GetHeight() & ~1) - 5);
+    AddTextOp(logo, logo_pos, scale, thickness, color, "logo");
+    return;
+  }
+  cv::Mat image = frame->ImageBGR();
+  cv::Point logo_pos(5, image.rows - 5);
   cv::putText(image, logo, logo_pos, font_, scale, color, thickness);
 }
 
@@ -165,7 +376,7 @@ void CnOsd::DrawLabel(CNDataFramePtr frame, const cnstream::CNObjsVec &objects,
     } else {
       VLOG5(OSD) << "Draw Label and Score: " << text;
     }
-    DrawText(frame, bottom_left, text, color);
+    DrawText(frame, bottom_left, text, color, 1, nullptr, true, LabelCacheKey(object->track_id, ""));
 
     // draw secondary inference information
     int label_bottom_y = 0;
@@ -176,13 +387,15 @@ void CnOsd::DrawLabel(CNDataFramePtr frame, const cnstream::CNObjsVec &objects,
         std::string attr_value = object->GetExtraAttribute(key);
         if (attr_value.empty()) continue;
         std::string secondary_text = key + " : " + attr_value;
-        DrawText(frame, top_left + cv::Point(0, label_bottom_y), secondary_text, color, 0.5, &text_height);
+        DrawText(frame, top_left + cv::Point(0, label_bottom_y), secondary_text, color, 0.5, &text_height, true,
+                 LabelCacheKey(object->track_id, key));
       } else {
         std::string secondary_label = secondary_labels_[infer_attr.value];
         std::string secondary_score = std::to_string(infer_attr.score);
         secondary_score = secondary_score.substr(0, std::min(size_t(4), secondary_score.size()));
         std::string secondary_text = key + " : " + secondary_label + " score[" + secondary_score + "]";
-        DrawText(frame, top_left + cv::Point(0, label_bottom_y), secondary_text, color, 0.5, &text_height);
+        DrawText(frame, top_left + cv::Point(0, label_bottom_y), secondary_text, color, 0.5, &text_height, true,
+                 LabelCacheKey(object->track_id, key));
       }
       label_bottom_y += text_height;
     }
@@ -224,14 +437,15 @@ void CnOsd::DrawLabel(CNDataFramePtr frame, const std::vector<DrawInfo> &info) /
     DrawBox(frame, top_left, bottom_right, color);
 
     // Draw Basic Info
-    DrawText(frame, bottom_left, item.basic_info, color);
+    DrawText(frame, bottom_left, item.basic_info, color, 1, nullptr, true, LabelCacheKey(item.track_id, ""));
 
     // draw secondary inference infomation
     int label_bottom_y = 0;
     int text_height = 0;
 
-    for (auto &attribute : item.attributes) {
-      DrawText(frame, top_left + cv::Point(0, label_bottom_y), attribute, color, 0.7, &text_height, item.attr_down);
+    for (size_t j = 0; j < item.attributes.size(); ++j) {
+      DrawText(frame, top_left + cv::Point(0, label_bottom_y), item.attributes[j], color, 0.7, &text_height,
+               item.attr_down, LabelCacheKey(item.track_id, std::to_string(j)));
       label_bottom_y += text_height;
     }
   }
@@ -273,12 +487,23 @@ void CnOsd::DrawBox(CNDataFramePtr frame, const cv::Point &top_left, const cv::P
     DoDrawRect(frame, &bbox_info);
     return;
   }
+  if (PrepareFrame(frame)) {
+    PaintOp op;
+    op.type = PaintOp::DRAW_RECT;
+    op.top_left = top_left;
+    op.bottom_right = bottom_right;
+    op.color = color;
+    op.thickness = CalcThickness(frame->buf_surf->GetWidth(), box_thickness_);
+    paint_ops_.push_back(std::move(op));
+    return;
+  }
   cv::Mat image = frame->ImageBGR();
   cv::rectangle(image, top_left, bottom_right, color, CalcThickness(frame->buf_surf->GetWidth(), box_thickness_));
 }
 
 void CnOsd::DrawText(CNDataFramePtr frame, const cv::Point &bottom_left, const std::string &text,
-                     const cv::Scalar &color, float scale, int *text_height, bool down) /*const*/ {
+                     const cv::Scalar &color, float scale, int *text_height, bool down,
+                     const std::string &cache_key) /*const*/ {
   if (text.empty()) {
     return;
   }
@@ -335,6 +560,13 @@ void CnOsd::DrawText(CNDataFramePtr frame, const cv::Point &bottom_left, const s
     bg.bottom_right = label_bottom_right;
     bg.color = color;
     DoFillRect(frame, &bg);
+  } else if (PrepareFrame(frame)) {
+    PaintOp op;
+    op.type = PaintOp::FILL_RECT;
+    op.top_left = label_top_left;
+    op.bottom_right = label_bottom_right;
+    op.color = color;
+    paint_ops_.push_back(std::move(op));
   } else {
     cv::Mat image = frame->ImageBGR();
     cv::rectangle(image, label_top_left, label_bottom_right, color, CV_FILLED);
@@ -345,13 +577,17 @@ void CnOsd::DrawText(CNDataFramePtr frame, const cv::Point &bottom_left, const s
   cv::Scalar text_color = cv::Scalar(255, 255, 255) - color;
   if (cn_font_ == nullptr) {
     double txt_scale = CalcScale(frame->buf_surf->GetWidth(), text_scale_) * scale;
-    cv::Mat image = frame->ImageBGR();
-    cv::putText(image, text, text_left_bottom, font_, txt_scale, text_color, txt_thickness);
+    if (PrepareFrame(frame)) {
+      AddTextOp(text, text_left_bottom, txt_scale, txt_thickness, text_color, cache_key);
+    } else {
+      cv::Mat image = frame->ImageBGR();
+      cv::putText(image, text, text_left_bottom, font_, txt_scale, text_color, txt_thickness);
+    }
   } else {
     char *str = const_cast<char *>(text.data());
     if (hw_accel_) {
       int text_bitmap_size = text_size.width * 2 * text_size.height;
-      cnedk::BufSurfWrapperPtr text_bitmap = GetMem(text_bitmap_size);
+      cnedk::BufSurfWrapperPtr text_bitmap = mempool_->GetMem(text_bitmap_size);
       if (!text_bitmap) return;
 
       cn_font_->putText(str, text_color, color, text_bitmap->GetMappedData(0), text_size);
@@ -368,6 +604,8 @@ void CnOsd::DrawText(CNDataFramePtr frame, const cv::Point &bottom_left, const s
         LOGW(OSD) << "Text is too long, discard it";
         // abort();
       }
+    } else if (PrepareFrame(frame)) {
+      AddCnFontTextOp(text, text_left_bottom, text_size, text_color, cache_key);
     } else {
       cn_font_->putText(frame, str, text_left_bottom, text_color);
     }
@@ -477,6 +715,19 @@ void CnOsd::DoDrawBitmap(CNDataFramePtr frame, TextInfo *info, bool last) {
 
 void CnOsd::update_vframe(CNDataFramePtr frame) {
   if (!hw_accel_) {
+    bool drawn_on_planes = cur_frame_.lock() == frame && draw_yuv_;
+    if (drawn_on_planes) PaintFrame();
+    paint_ops_.clear();
+    painter_.Unbind();
+    cur_frame_.reset();
+    draw_yuv_ = false;
+    if (drawn_on_planes) {
+      frame->buf_surf->SyncHostToDevice();
+      return;
+    }
+    // nothing is drawn on the frame
+    if (!frame->HasBGRImage()) return;
+
     /*update frame->vframe for vout, venc etc...  FIXME
      *  BGR->yuv420sp
      */
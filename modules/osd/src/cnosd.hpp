@@ -27,6 +27,7 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -34,6 +35,7 @@
 #include "cnstream_frame_va.hpp"
 #include "osd.hpp"
 #include "osd_handler.hpp"
+#include "yuv_painter.hpp"
 
 using DrawInfo = cnstream::OsdHandler::DrawInfo;
 
@@ -46,29 +48,54 @@ namespace cnstream {
 
 class CnFont;
 
+/**
+ * @brief Pool of text bitmaps of hardware OSD, shared by the processors of all streams of a module.
+ *
+ * Bitmaps larger than a block, or requested while all blocks are in use, are allocated separately.
+ */
+class OsdMemPool {
+ public:
+  OsdMemPool();
+  ~OsdMemPool();
+  cnedk::BufSurfWrapperPtr GetMem(size_t size);
+
+ private:
+  cnedk::BufPool pool_;
+  std::mutex mutex_;
+};
+
 class CnOsd {
  public:
   CnOsd() = delete;
   explicit CnOsd(const std::vector<std::string> &labels);
-  ~CnOsd() {
-    std::unique_lock<std::mutex> lk(pool_mutex_);
-    if (hw_accel_) mempool_.DestroyPool(5000);
-  }
+  ~CnOsd() = default;
 
   inline void SetTextScale(float scale) { text_scale_ = scale; }
   inline void SetTextThickness(float thickness) { text_thickness_ = thickness; }
   inline void SetBoxThickness(float thickness) { box_thickness_ = thickness; }
   inline void SetSecondaryLabels(std::vector<std::string> labels) { secondary_labels_ = labels; }
   inline void SetCnFont(std::shared_ptr<CnFont> cn_font) { cn_font_ = cn_font; }
-  inline void SetHwAccel(bool hw_accel) {
+  inline void SetTileNum(int tile_num) { tile_num_ = tile_num; }
+  inline void SetLabelCache(bool label_cache) { label_cache_ = label_cache; }
+  /**
+   * @brief Enables hardware OSD. Text bitmaps are taken from the mempool, a mempool is created if it is not given.
+   */
+  inline void SetHwAccel(bool hw_accel, std::shared_ptr<OsdMemPool> mempool = nullptr) {
     hw_accel_ = hw_accel;
-    if (hw_accel_) InitMempool();
+    mempool_ = hw_accel_ ? (mempool ? mempool : std::make_shared<OsdMemPool>()) : nullptr;
   }
 
   void DrawLabel(CNDataFramePtr frame, const CNObjsVec &objects, std::vector<std::string> attr_keys = {}) /*const*/;
   void DrawLabel(CNDataFramePtr frame, const std::vector<DrawInfo> &info) /*const*/;
   void DrawLogo(CNDataFramePtr frame, std::string logo) /*const*/;
   void update_vframe(CNDataFramePtr frame);
+  /**
+   * @brief Gets the numbers of labels looked up in the label cache and found, since the processor is created.
+   */
+  void GetLabelCacheStats(uint64_t *lookups, uint64_t *hits) const {
+    *lookups = label_lookups_;
+    *hits = label_hits_;
+  }
 
  private:
   std::pair<cv::Point, cv::Point> GetBboxCorner(const cnstream::CNInferObject &object, int img_width,
@@ -78,13 +105,72 @@ class CnOsd {
   void DrawBox(CNDataFramePtr frame, const cv::Point &top_left, const cv::Point &bottom_right,
                const cv::Scalar &color);  // const;
   void DrawText(CNDataFramePtr frame, const cv::Point &bottom_left, const std::string &text, const cv::Scalar &color,
-                float scale = 1, int *text_height = nullptr, bool down = true);  // const;
+                float scale = 1, int *text_height = nullptr, bool down = true,
+                const std::string &cache_key = "");  // const;
   int CalcThickness(int image_width, float thickness) const {
     int result = thickness * image_width / 300;
     if (result <= 0) result = 1;
     return result;
   }
   double CalcScale(int image_width, float scale) const { return scale * image_width / 1000; }
+  /**
+   * @brief Binds the painter to the frame when it is drawn the first time.
+   *
+   * NV12 and NV21 frames are drawn on their planes in place, unless hardware osd is used or the frame already has a BGR
+   * image, which is drawn on and converted back to keep the drawings of other modules.
+   *
+   * @return Returns true if the frame is drawn on its planes.
+   */
+  bool PrepareFrame(CNDataFramePtr frame);
+
+  // drawings on the planes are recorded and painted together by update_vframe
+  struct PaintOp {
+    enum Type { FILL_RECT, DRAW_RECT, DRAW_TEXT } type;
+    cv::Point top_left;  // top left of the rectangle, or of the mask of the text after it is rendered
+    cv::Point bottom_right;
+    cv::Scalar color;
+    int thickness = 1;
+    std::string text;
+    cv::Point text_pos;  // bottom left of the text as cv::putText
+    double text_scale = 1;
+    bool use_cn_font = false;
+    cv::Size text_size;  // size of the text drawn by CnFont
+    std::string cache_key;  // key of the rendered text in the label cache, not cached if empty
+    cv::Mat mask;
+  };
+  void AddTextOp(const std::string &text, const cv::Point &pos, double scale, int thickness, const cv::Scalar &color,
+                 const std::string &cache_key = "");
+  void AddCnFontTextOp(const std::string &text, const cv::Point &pos, const cv::Size &size, const cv::Scalar &color,
+                       const std::string &cache_key);
+  // renders the text to its mask, can be called concurrently
+  void RenderText(PaintOp *op) const;
+  // renders texts and paints the frame by horizontal tiles concurrently
+  void PaintFrame();
+
+  /**
+   * Labels of tracked objects usually keep their texts across frames. With the label cache, the rendered mask of a
+   * label is kept by track id and line, and is blitted again while the text is the same, instead of rendering it.
+   */
+  struct CachedLabel {
+    std::string text;
+    double text_scale;
+    int thickness;
+    bool use_cn_font;
+    cv::Size text_size;
+    cv::Mat mask;
+    cv::Point offset;  // top left of the mask from the position of the text
+    uint64_t last_used;
+  };
+  // takes the mask from the cache, returns false if it is not cached
+  bool FindCachedLabel(PaintOp *op);
+  void CacheLabel(const PaintOp &op);
+  // labels not used in these frames are removed, as their tracks are likely lost
+  static constexpr uint64_t kLabelCacheMaxIdle = 30;
+  bool label_cache_ = false;
+  std::unordered_map<std::string, CachedLabel> cached_labels_;
+  uint64_t paint_count_ = 0;
+  uint64_t label_lookups_ = 0;
+  uint64_t label_hits_ = 0;
 
   float text_scale_ = 1;
   float text_thickness_ = 1;
@@ -95,47 +181,15 @@ class CnOsd {
   int font_ = cv::FONT_HERSHEY_SIMPLEX;
   std::shared_ptr<CnFont> cn_font_;
   bool hw_accel_ = false;
+  int tile_num_ = 0;
+  YuvPainter painter_;
+  std::weak_ptr<CNDataFrame> cur_frame_;
+  bool draw_yuv_ = false;
+  std::vector<PaintOp> paint_ops_;
 
  private:
-  cnedk::BufPool mempool_;
-  std::mutex pool_mutex_;
-
-  int InitMempool() {
-    std::unique_lock<std::mutex> lk(pool_mutex_);
-    CnedkBufSurfaceCreateParams create_params;
-    memset(&create_params, 0, sizeof(create_params));
-    create_params.device_id = 0;  // TODO(gaoyujia)
-    create_params.batch_size = 1;
-    create_params.size = kOsdBlockSize;
-    create_params.mem_type = CNEDK_BUF_MEM_UNIFIED;
-    mempool_.CreatePool(&create_params, kOsdBlockNum);
-    return 0;
-  }
-  cnedk::BufSurfWrapperPtr GetMem(size_t nSize) {
-    std::unique_lock<std::mutex> lk(pool_mutex_);
-    cnedk::BufSurfWrapperPtr surfPtr = nullptr;
-    if (nSize <= kOsdBlockSize) {
-      surfPtr = mempool_.GetBufSurfaceWrapper(0);
-    }
-
-    if (!surfPtr) {
-      CnedkBufSurfaceCreateParams create_params;
-      memset(&create_params, 0, sizeof(create_params));
-      create_params.device_id = 0;
-      create_params.batch_size = 1;
-      create_params.size = nSize;
-      create_params.mem_type = CNEDK_BUF_MEM_UNIFIED;
-      CnedkBufSurface *surf = nullptr;
-      if (CnedkBufSurfaceCreate(&surf, &create_params) < 0) {
-        LOGE(OSD) << "GetMem(): Create BufSurface failed";
-        return nullptr;
-      }
-      surfPtr = std::make_shared<cnedk::BufSurfaceWrapper>(surf);
-    }
-
-    memset(surfPtr->GetMappedData(0), 0, nSize);
-    return surfPtr;
-  }
+  // released after the bitmaps taken from it
+  std::shared_ptr<OsdMemPool> mempool_;
 
  private:
   struct BBoxInfo {
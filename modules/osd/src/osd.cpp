@@ -34,23 +34,15 @@
 
 namespace cnstream {
 
-// local var,
-//   init in Open() and destroy in Close()
-static std::shared_ptr<CnFont> s_font = nullptr;
-
-struct OsdThreadLocalContext {
-  std::shared_ptr<CnOsd> processor_ = nullptr;
-};
-
 /**
  *@brief osd context structure
  */
 struct OsdContext {
+  std::unique_ptr<CnOsd> processor_ = nullptr;
   OsdHandler *handler_ = nullptr;
+  ~OsdContext() { delete handler_; }
 };
 
-static thread_local OsdThreadLocalContext g_osd_tl_context;
-
 static std::vector<std::string> LoadLabels(const std::string &label_path) {
   std::vector<std::string> labels;
   std::ifstream ifs(label_path);
@@ -151,50 +143,65 @@ Osd::Osd(const std::string &name) : Module(name) {
       {"label_size", "normal",
        "The size of the label, support value: "
        "normal, large, larger, small, smaller and number. The default value is normal.",
-       PARAM_OPTIONAL, OFFSET(OsdParams, label_size), label_size_parser, "float"}};
+       PARAM_OPTIONAL, OFFSET(OsdParams, label_size), label_size_parser, "float"},
+      {"tile_num", "0",
+       "The number of horizontal tiles of a frame drawn concurrently, only used when drawing on NV12 or NV21 frames "
+       "without hw_accel. 0 means about one tile per 540 rows. The default value is 0.",
+       PARAM_OPTIONAL, OFFSET(OsdParams, tile_num), ModuleParamParser<int>::Parser, "int"},
+      {"label_cache", "false",
+       "Whether to keep the rendered labels of tracked objects by track id, and draw them again while their texts are "
+       "not changed. Only used when drawing on NV12 or NV21 frames without hw_accel. The default value is false.",
+       PARAM_OPTIONAL, OFFSET(OsdParams, label_cache), ModuleParamParser<bool>::Parser, "bool"},
+      {"show_stats", "false",
+       "Whether show statistics. Hits of the label cache of streams are shown at EOS. The default value is false.",
+       PARAM_OPTIONAL, OFFSET(OsdParams, show_stats), ModuleParamParser<bool>::Parser, "bool"}};
   param_helper_->Register(register_param, &param_register_);
 }
 
 Osd::~Osd() { Close(); }
 
-std::shared_ptr<OsdContext> Osd::GetOsdContext(CNFrameInfoPtr data) {
-  auto params = param_helper_->GetParams();
-  if (!g_osd_tl_context.processor_) {
-    g_osd_tl_context.processor_ = std::make_shared<CnOsd>(params.labels);
-    if (!g_osd_tl_context.processor_) {
-      LOGE(OSD) << "Osd::GetOsdContext() create g_osd_tl_context processor Failed";
-      return nullptr;
-    }
-    g_osd_tl_context.processor_->SetTextScale(params.label_size * params.text_scale);
-    g_osd_tl_context.processor_->SetTextThickness(params.label_size * params.text_thickness);
-    g_osd_tl_context.processor_->SetBoxThickness(params.label_size * params.box_thickness);
-    g_osd_tl_context.processor_->SetSecondaryLabels(params.secondary_labels);
-
-    if (s_font) {
-      g_osd_tl_context.processor_->SetCnFont(s_font);
-    }
-    if (params.hw_accel) {
-      g_osd_tl_context.processor_->SetHwAccel(true);
-    }
+OsdContext *Osd::GetOsdContext(CNFrameInfoPtr data) {
+  uint32_t stream_idx = data->GetStreamIndex();
+  if (stream_idx >= contexts_.size()) {
+    LOGE(OSD) << "Osd::GetOsdContext() invalid stream index " << stream_idx;
+    return nullptr;
   }
+  OsdContext *ctx = contexts_[stream_idx].get();
+  if (ctx) return ctx;
 
-  std::shared_ptr<OsdContext> ctx = nullptr;
-  std::string stream_id = data->stream_id;
-  {
-    RwLockReadGuard lg(ctx_lock_);
-    auto search = osd_ctxs_.find(stream_id);
-    if (search != osd_ctxs_.end()) {
-      // context exists
-      ctx = search->second;
-    }
+  auto params = param_helper_->GetParams();
+  std::unique_ptr<OsdContext> new_ctx(new (std::nothrow) OsdContext);
+  if (!new_ctx) {
+    LOGE(OSD) << "Osd::GetOsdContext() create context Failed";
+    return nullptr;
+  }
+  new_ctx->processor_.reset(new (std::nothrow) CnOsd(params.labels));
+  if (!new_ctx->processor_) {
+    LOGE(OSD) << "Osd::GetOsdContext() create processor Failed";
+    return nullptr;
+  }
+  new_ctx->processor_->SetTextScale(params.label_size * params.text_scale);
+  new_ctx->processor_->SetTextThickness(params.label_size * params.text_thickness);
+  new_ctx->processor_->SetBoxThickness(params.label_size * params.box_thickness);
+  new_ctx->processor_->SetSecondaryLabels(params.secondary_labels);
+  new_ctx->processor_->SetTileNum(params.tile_num);
+  new_ctx->processor_->SetLabelCache(params.label_cache);
+  if (font_) {
+    new_ctx->processor_->SetCnFont(font_);
   }
-  if (!ctx) {
-    ctx = std::make_shared<OsdContext>();
-    RwLockWriteGuard lg(ctx_lock_);
-    osd_ctxs_[stream_id] = ctx;
+  if (params.hw_accel) {
+    new_ctx->processor_->SetHwAccel(true, mempool_);
+  }
+  if (!params.osd_handler_name.empty()) {
+    new_ctx->handler_ = OsdHandler::Create(params.osd_handler_name);
   }
 
-  return ctx;
+  {
+    std::lock_guard<std::mutex> lk(stream_indexes_mutex_);
+    stream_indexes_[data->stream_id] = stream_idx;
+  }
+  contexts_[stream_idx] = std::move(new_ctx);
+  return contexts_[stream_idx].get();
 }
 
 bool Osd::Open(cnstream::ModuleParamSet param_set) {
@@ -202,21 +209,31 @@ bool Osd::Open(cnstream::ModuleParamSet param_set) {
     return false;
   }
 
+  {
+    std::lock_guard<std::mutex> lk(stream_indexes_mutex_);
+    stream_indexes_.clear();
+  }
+  contexts_.clear();
+  contexts_.resize(GetMaxStreamNumber());
+  // text bitmaps of hardware OSD are taken from one mempool for all streams, instead of one for each stream
+  mempool_.reset();
+  if (param_helper_->GetParams().hw_accel) mempool_ = std::make_shared<OsdMemPool>();
+
   // preload font library
+  font_.reset();
 #ifdef HAVE_FREETYPE
   auto params = param_helper_->GetParams();
   if (!params.font_path.empty()) {
-    s_font = std::make_shared<CnFont>();
+    font_ = std::make_shared<CnFont>();
     float font_size = params.label_size * params.text_scale * 30;
     float space = font_size / 75;
     float step = font_size / 200;
     LOGI(OSD) << "FontPath = " << params.font_path << std::endl;
-    if (s_font && s_font->Init(params.font_path, font_size, space, step)) {
+    if (font_ && font_->Init(params.font_path, font_size, space, step)) {
       // do nothing
     } else {
       LOGE(OSD) << "Create and initialize CnFont failed.";
-      s_font.reset();
-      s_font = nullptr;
+      font_.reset();
     }
   }
 #endif
@@ -224,11 +241,13 @@ bool Osd::Open(cnstream::ModuleParamSet param_set) {
 }
 
 void Osd::Close() {
-  osd_ctxs_.clear();
-  if (s_font) {
-    s_font.reset();
-    s_font = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(stream_indexes_mutex_);
+    stream_indexes_.clear();
   }
+  contexts_.clear();
+  mempool_.reset();
+  font_.reset();
 }
 
 int Osd::Process(std::shared_ptr<CNFrameInfo> data) {
@@ -240,7 +259,7 @@ int Osd::Process(std::shared_ptr<CNFrameInfo> data) {
     return 0;
   }
 
-  std::shared_ptr<OsdContext> ctx = GetOsdContext(data);
+  OsdContext *ctx = GetOsdContext(data);
   if (ctx == nullptr) {
     LOGE(OSD) << "Get Osd Context Failed.";
     return -1;
@@ -258,11 +277,7 @@ int Osd::Process(std::shared_ptr<CNFrameInfo> data) {
   }
 
   if (!params.logo.empty()) {
-    g_osd_tl_context.processor_->DrawLogo(frame, params.logo);
-  }
-
-  if (!ctx->handler_ && !params.osd_handler_name.empty()) {
-    ctx->handler_ = OsdHandler::Create(params.osd_handler_name);
+    ctx->processor_->DrawLogo(frame, params.logo);
   }
 
   if (ctx->handler_) {
@@ -270,31 +285,38 @@ int Osd::Process(std::shared_ptr<CNFrameInfo> data) {
     std::unique_lock<std::mutex> lk(objs_holder->mutex_);
     const CNObjsVec &input_objs = objs_holder->objs_;
     if (0 == ctx->handler_->GetDrawInfo(input_objs, params.labels, &info)) {
-      g_osd_tl_context.processor_->DrawLabel(frame, info);
-      g_osd_tl_context.processor_->update_vframe(frame);
+      ctx->processor_->DrawLabel(frame, info);
+      ctx->processor_->update_vframe(frame);
     }
   } else {
     std::unique_lock<std::mutex> lk(objs_holder->mutex_);
     const CNObjsVec &input_objs = objs_holder->objs_;
-    g_osd_tl_context.processor_->DrawLabel(frame, input_objs, params.attr_keys);
-    g_osd_tl_context.processor_->update_vframe(frame);
+    ctx->processor_->DrawLabel(frame, input_objs, params.attr_keys);
+    ctx->processor_->update_vframe(frame);
   }
   return 0;
 }
 
 void Osd::OnEos(const std::string &stream_id) {
   LOGI(OSD) << this->GetName() << " OnEos flow-EOS arrived:  " << stream_id;
+  uint32_t stream_idx;
   {
-    RwLockWriteGuard lg(ctx_lock_);
-    auto search = osd_ctxs_.find(stream_id);
-    if (search != osd_ctxs_.end()) {
-      if (search->second->handler_) {
-        delete search->second->handler_;
-        search->second->handler_ = nullptr;
-      }
-      osd_ctxs_.erase(stream_id);
-    }
+    std::lock_guard<std::mutex> lk(stream_indexes_mutex_);
+    auto search = stream_indexes_.find(stream_id);
+    if (search == stream_indexes_.end()) return;
+    stream_idx = search->second;
+    stream_indexes_.erase(search);
+  }
+  // called by the thread processing the stream, the context is not in use
+  if (stream_idx >= contexts_.size() || !contexts_[stream_idx]) return;
+  auto params = param_helper_->GetParams();
+  if (params.label_cache && params.show_stats) {
+    uint64_t lookups, hits;
+    contexts_[stream_idx]->processor_->GetLabelCacheStats(&lookups, &hits);
+    LOGI(OSD) << "[" << GetName() << "] stream " << stream_id << ": label cache hit " << hits << " of " << lookups
+              << " labels.";
   }
+  contexts_[stream_idx].reset();
 }
 
 bool Osd::CheckParamSet(const ModuleParamSet& param_set) const {
@@ -0,0 +1,139 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "yuv_painter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cnstream {
+
+void YuvPainter::Bind(uint8_t *y_plane, int y_stride, uint8_t *uv_plane, int uv_stride, int width, int height,
+                      bool nv21) {
+  y_plane_ = y_plane;
+  y_stride_ = y_stride;
+  uv_plane_ = uv_plane;
+  uv_stride_ = uv_stride;
+  width_ = width;
+  height_ = height;
+  nv21_ = nv21;
+  clip_ = cv::Rect(0, 0, width, height);
+}
+
+YuvPainter::YuvColor YuvPainter::ToYuv(const cv::Scalar &color) {
+  auto clamp = [](double val) { return std::min(std::max(static_cast<int>(val), 0), 255); };
+  int b = clamp(color.val[0]);
+  int g = clamp(color.val[1]);
+  int r = clamp(color.val[2]);
+  // the same as libyuv RGB24ToNV12, which is used to convert the BGR image back to the frame
+  YuvColor yuv;
+  yuv.y = static_cast<uint8_t>((66 * r + 129 * g + 25 * b + 0x1080) >> 8);
+  yuv.u = static_cast<uint8_t>((112 * b - 74 * g - 38 * r + 0x8080) >> 8);
+  yuv.v = static_cast<uint8_t>((112 * r - 94 * g - 18 * b + 0x8080) >> 8);
+  return yuv;
+}
+
+cv::Rect YuvPainter::Clip(const cv::Rect &rect) const { return rect & clip_; }
+
+void YuvPainter::FillRect(const cv::Rect &rect, const cv::Scalar &color) {
+  if (!IsBound()) return;
+  cv::Rect roi = Clip(rect);
+  if (roi.area() <= 0) return;
+  YuvColor yuv = ToYuv(color);
+  uint8_t first = nv21_ ? yuv.v : yuv.u;
+  uint8_t second = nv21_ ? yuv.u : yuv.v;
+
+  for (int y = roi.y; y < roi.y + roi.height; ++y) {
+    memset(y_plane_ + y * y_stride_ + roi.x, yuv.y, roi.width);
+  }
+  // chroma of every 2x2 block touched by the rectangle
+  int cx0 = roi.x / 2, cx1 = (roi.x + roi.width - 1) / 2;
+  int cy0 = roi.y / 2, cy1 = (roi.y + roi.height - 1) / 2;
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    uint8_t *uv = uv_plane_ + cy * uv_stride_;
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      uv[2 * cx] = first;
+      uv[2 * cx + 1] = second;
+    }
+  }
+}
+
+void YuvPainter::DrawRect(const cv::Point &top_left, const cv::Point &bottom_right, const cv::Scalar &color,
+                          int thickness) {
+  if (thickness <= 0) thickness = 1;
+  int half = thickness / 2;
+  // outer bounds of the lines centered on the edges, inclusive
+  int x0 = std::min(top_left.x, bottom_right.x) - half;
+  int y0 = std::min(top_left.y, bottom_right.y) - half;
+  int x1 = std::max(top_left.x, bottom_right.x) - half + thickness - 1;
+  int y1 = std::max(top_left.y, bottom_right.y) - half + thickness - 1;
+  int w = x1 - x0 + 1;
+  int h = y1 - y0 + 1;
+  if (w <= 2 * thickness || h <= 2 * thickness) {
+    FillRect(cv::Rect(x0, y0, w, h), color);
+    return;
+  }
+  FillRect(cv::Rect(x0, y0, w, thickness), color);
+  FillRect(cv::Rect(x0, y1 - thickness + 1, w, thickness), color);
+  FillRect(cv::Rect(x0, y0 + thickness, thickness, h - 2 * thickness), color);
+  FillRect(cv::Rect(x1 - thickness + 1, y0 + thickness, thickness, h - 2 * thickness), color);
+}
+
+void YuvPainter::DrawMask(const cv::Mat &mask, const cv::Point &pos, const cv::Scalar &color) {
+  if (!IsBound() || mask.empty() || mask.type() != CV_8UC1) return;
+  cv::Rect rect(pos.x, pos.y, mask.cols, mask.rows);
+  cv::Rect roi = Clip(rect);
+  if (roi.area() <= 0) return;
+  YuvColor yuv = ToYuv(color);
+  uint8_t first = nv21_ ? yuv.v : yuv.u;
+  uint8_t second = nv21_ ? yuv.u : yuv.v;
+
+  for (int y = roi.y; y < roi.y + roi.height; ++y) {
+    const uint8_t *m = mask.ptr<uint8_t>(y - rect.y) + (roi.x - rect.x);
+    uint8_t *dst = y_plane_ + y * y_stride_ + roi.x;
+    for (int x = 0; x < roi.width; ++x) {
+      dst[x] = m[x] ? yuv.y : dst[x];
+    }
+  }
+  // a 2x2 block takes the color if at least half of its pixels covered by the mask are set
+  int cx0 = roi.x / 2, cx1 = (roi.x + roi.width - 1) / 2;
+  int cy0 = roi.y / 2, cy1 = (roi.y + roi.height - 1) / 2;
+  for (int cy = cy0; cy <= cy1; ++cy) {
+    uint8_t *uv = uv_plane_ + cy * uv_stride_;
+    int ys = std::max(2 * cy, roi.y), ye = std::min(2 * cy + 2, roi.y + roi.height);
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      int xs = std::max(2 * cx, roi.x), xe = std::min(2 * cx + 2, roi.x + roi.width);
+      int covered = 0, count = 0;
+      for (int y = ys; y < ye; ++y) {
+        const uint8_t *m = mask.ptr<uint8_t>(y - rect.y);
+        for (int x = xs; x < xe; ++x) {
+          ++covered;
+          count += m[x - rect.x] != 0;
+        }
+      }
+      if (count && count * 2 >= covered) {
+        uv[2 * cx] = first;
+        uv[2 * cx + 1] = second;
+      }
+    }
+  }
+}
+
+}  // namespace cnstream
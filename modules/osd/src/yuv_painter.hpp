@@ -0,0 +1,90 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef _YUV_PAINTER_HPP_
+#define _YUV_PAINTER_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+
+namespace cnstream {
+
+/**
+ * @brief Draws on the planes of a YUV420SP (NV12 or NV21) image in place.
+ *
+ * Colors are given in BGR order, the same as for cv::Mat, and are converted with the BT.601 limited range matrix used
+ * by libyuv. Chroma is shared by 2x2 pixels, so shapes with odd edges are drawn with their chroma rounded to the
+ * covered blocks.
+ */
+class YuvPainter {
+ public:
+  YuvPainter() = default;
+
+  /**
+   * @brief Binds the planes to draw on. The planes are not owned, they must be valid until the painter is unbound.
+   */
+  void Bind(uint8_t *y_plane, int y_stride, uint8_t *uv_plane, int uv_stride, int width, int height, bool nv21);
+  void Unbind() { y_plane_ = uv_plane_ = nullptr; }
+  bool IsBound() const { return y_plane_ != nullptr; }
+
+  int Width() const { return width_; }
+  int Height() const { return height_; }
+  /**
+   * @brief Limits the drawings to the region, which is the whole image after binding.
+   *
+   * Painters bound to the same image can draw concurrently when their regions start and end at even rows, as they do
+   * not share chroma.
+   */
+  void SetClip(const cv::Rect &clip) { clip_ = clip & cv::Rect(0, 0, width_, height_); }
+
+  /**
+   * @brief Fills the rectangle, it is clipped to the region of the painter.
+   */
+  void FillRect(const cv::Rect &rect, const cv::Scalar &color);
+  /**
+   * @brief Draws the outline of the rectangle, the same as cv::rectangle does with the thickness.
+   */
+  void DrawRect(const cv::Point &top_left, const cv::Point &bottom_right, const cv::Scalar &color, int thickness);
+  /**
+   * @brief Draws color where the CV_8UC1 mask is not zero, with the top left of the mask at pos.
+   */
+  void DrawMask(const cv::Mat &mask, const cv::Point &pos, const cv::Scalar &color);
+
+ private:
+  struct YuvColor {
+    uint8_t y, u, v;
+  };
+  static YuvColor ToYuv(const cv::Scalar &color);
+  cv::Rect Clip(const cv::Rect &rect) const;
+
+  uint8_t *y_plane_ = nullptr;
+  uint8_t *uv_plane_ = nullptr;
+  int y_stride_ = 0;
+  int uv_stride_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  bool nv21_ = false;
+  cv::Rect clip_;
+};  // class YuvPainter
+
+}  // namespace cnstream
+
+#endif  // _YUV_PAINTER_HPP_
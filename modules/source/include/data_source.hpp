@@ -179,6 +179,7 @@ struct FileSourceParam {
   Resolution max_res;         /*!< The maximum input resolution. */
   Resolution out_res;         /*!< The output resolution. */
   bool only_key_frame = false;    /*!< Only decode key frame. */
+  bool max_speed = false;     /*!< Feeds the stream as fast as the pipeline can absorb it, framerate is ignored. */
 };  // FileSourceParam
 /*!
  * @struct RtspSourceParam
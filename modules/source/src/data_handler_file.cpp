@@ -17,6 +17,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  *************************************************************************/
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <sstream>
@@ -88,7 +89,6 @@ class FileHandlerImpl : public IParserResult, public IDecodeResult, public Sourc
   /**/
   std::atomic<int> running_{0};
   std::thread thread_;
-  bool eos_sent_ = false;
 
  private:
   FFParser parser_;
@@ -102,9 +102,12 @@ class FileHandlerImpl : public IParserResult, public IDecodeResult, public Sourc
 
   uint64_t timestamp_ = 0;
   uint64_t timestamp_base_ = 0;
+  uint64_t max_timestamp_ = 0;
   bool first_pts_set_ = false;
   uint64_t first_pts_ = 0;
-  uint64_t pts_gap_ = 3003;  // FIXME
+  uint64_t pts_gap_ = 3003;  // updated by the container frame rate in OnParserInfo()
+  uint64_t loop_count_ = 0;
+  uint64_t packet_count_ = 0;
   ModuleProfiler *module_profiler_ = nullptr;
   PipelineProfiler *pipeline_profiler_ = nullptr;
 };  // class FileHandlerImpl
@@ -229,24 +232,30 @@ void FileHandlerImpl::Loop() {
       module_->PostEvent(e);
     }
     LOGE(SOURCE) << "[FileHandlerImpl] Loop(): [" << stream_id_ << "]: PrepareResources failed.";
+    this->SendFlowEos();
     return;
   }
 
   set_thread_name("demux_decode");
 
-  FrController controller(handle_param_.framerate);
-  if (handle_param_.framerate > 0) controller.Start();
+  // In max speed mode the pipeline throttles the source by back pressure only.
+  bool throttled = !handle_param_.max_speed && handle_param_.framerate > 0;
+  FrController controller(throttled ? handle_param_.framerate : 0);
+  if (throttled) controller.Start();
 
   VLOG1(SOURCE) << "[FileHandlerImpl] Loop(): [" << stream_id_ << "]: DecoderLoop";
   while (running_.load()) {
     if (!Process()) {
       break;
     }
-    if (handle_param_.framerate > 0) controller.Control();
+    if (throttled) controller.Control();
   }
 
   VLOG1(SOURCE) << "[FileHandlerImpl] Loop(): [" << stream_id_ << "]: DecoderLoop Exit.";
   ClearResources();
+  // The decoder is destroyed, no more callbacks. Make sure the stream is always completed, even if decoding failed
+  // or the decoder did not flush.
+  this->SendFlowEos();
 }
 
 bool FileHandlerImpl::PrepareResources(bool demux_only) {
@@ -290,7 +299,11 @@ bool FileHandlerImpl::Process() {
         return false;
       }
       eos_reached_ = false;
-      timestamp_base_ = timestamp_ + pts_gap_;
+      // continue after the last presented frame, not the last one in decoding order
+      timestamp_base_ = max_timestamp_ + pts_gap_;
+      loop_count_++;
+      VLOG1(SOURCE) << "[FileHandlerImpl] Process(): [" << stream_id_ << "]: Loop " << loop_count_
+                    << " finished, timestamp base " << timestamp_base_;
       return true;
     } else {
       LOGI(SOURCE) << "[FileHandlerImpl] Process(): loop false, eos_reached";
@@ -308,6 +321,9 @@ bool FileHandlerImpl::Process() {
 
 // IParserResult methods
 void FileHandlerImpl::OnParserInfo(VideoInfo *info) {
+  if (info && info->frame_duration > 0) {
+    pts_gap_ = info->frame_duration;
+  }
   if (decoder_) {
     return;  // for the case:  loop and reset demux only
   }
@@ -340,13 +356,15 @@ void FileHandlerImpl::OnParserFrame(VideoEsFrame *frame) {
   pkt.data = frame->data;
   pkt.len = frame->len;
   pkt.pts = frame->pts;
+  packet_count_++;
 
   if (this->handle_param_.loop) {
     if (!first_pts_set_) {
       first_pts_ = pkt.pts, first_pts_set_ = true;
     }
-    // for loop case, correct PTS, TODO(liujian)
+    // for loop case, shift PTS so that they keep increasing across loops
     timestamp_ = timestamp_base_ + (pkt.pts - first_pts_);
+    max_timestamp_ = std::max(max_timestamp_, timestamp_);
     pkt.pts = timestamp_;
   }
 
@@ -407,7 +425,9 @@ void FileHandlerImpl::OnDecodeFrame(cnedk::BufSurfWrapperPtr wrapper) {
 
 void FileHandlerImpl::OnDecodeEos() {
   this->SendFlowEos();
-  LOGI(SOURCE) << "[FileHandlerImpl] OnDecodeEos(): called";
+  LOGI(SOURCE) << "[FileHandlerImpl] OnDecodeEos(): [" << stream_id_ << "]: " << packet_count_ << " packets parsed, "
+               << frame_count_ << " frames decoded, " << frame_id_ << " frames sent, " << loop_count_
+               << " loops finished";
 }
 
 int FileHandlerImpl::CreatePool(CnedkBufSurfaceCreateParams *params, uint32_t block_count) {
@@ -209,6 +209,13 @@ class FFParserImpl {
       info->extra_data.resize(extradata_size);
       memcpy(info->extra_data.data(), extradata, extradata_size);
     }
+
+    AVRational frame_rate = st->avg_frame_rate;
+    if (frame_rate.num <= 0 || frame_rate.den <= 0) frame_rate = st->r_frame_rate;
+    if (frame_rate.num > 0 && frame_rate.den > 0) {
+      info->frame_duration = av_rescale_q(1, av_inv_q(frame_rate), {1, 90000});
+    }
+    pts_gap_ = info->frame_duration > 0 ? info->frame_duration : 3003;
     // bitstream filter
     bsf_ctx_ = nullptr;
     if (strstr(fmt_ctx_->iformat->name, "mp4") || strstr(fmt_ctx_->iformat->name, "flv") ||
@@ -306,7 +313,7 @@ class FFParserImpl {
         packet_.pts = av_rescale_q(packet_.pts, vstream->time_base, {1, 90000});
       }
       if (!find_pts_) {
-        packet_.pts = pts_, pts_ += 3003;  // FIXME
+        packet_.pts = pts_, pts_ += pts_gap_;
       }
 
       if (result_) {
@@ -349,6 +356,7 @@ class FFParserImpl {
   uint8_t max_receive_time_out_ = 3;
   bool find_pts_ = false;
   uint64_t pts_ = 0;
+  int64_t pts_gap_ = 3003;
   std::string stream_id_ = "";
   std::string url_name_;
   IParserResult* result_ = nullptr;
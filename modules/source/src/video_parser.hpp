@@ -50,6 +50,7 @@ struct VideoInfo {
   int height;
 #endif
   int progressive;
+  int64_t frame_duration = 0;  // in 90kHz units, derived from the container frame rate, 0 if unknown
   std::vector<unsigned char> extra_data;
 };
 
@@ -26,9 +26,14 @@
  *  This file contains a declaration of struct Tracker
  */
 
-#include <map>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "cnstream_frame.hpp"
 #include "cnstream_module.hpp"
@@ -51,8 +56,14 @@ typedef struct TrackParams {
   uint32_t batch_timeout = 1000;  ///< only support in dynamic batch strategy
   bool show_stats = false;
   float max_cosine_distance = 0.2;
+  uint32_t nn_budget = 100;
+  float feature_prune_distance = 0;
+  float max_iou_distance = 0.7;
+  uint32_t max_age = 30;
+  uint32_t n_init = 3;
   std::string model_path = "";
   std::string track_name = "";
+  uint32_t worker_num = 0;
 } TrackParams;
 
 
@@ -63,6 +74,8 @@ struct TrackerContext;
  *
  * @brief Tracker is a module for realtime tracking.
  *   It would be MLU feature extracting if the model_path is provided, otherwise it would be done on CPU.
+ *   If worker_num is set, streams are tracked in parallel by a pool of workers, frames of a stream are tracked
+ *   one at a time in order.
  */
 class Tracker : public ModuleEx, public ModuleCreator<Tracker> {
  public:
@@ -124,11 +137,30 @@ class Tracker : public ModuleEx, public ModuleCreator<Tracker> {
   std::unique_ptr<ModuleParamsHelper<TrackParams>> param_helper_ = nullptr;
   bool InitFeatureExtractor(const CNFrameInfoPtr &data);
   TrackerContext *GetContext(const CNFrameInfoPtr &data);
-  std::map<int, TrackerContext *> contexts_;
+  void Dispatch(const CNFrameInfoPtr &data);
+  /**
+   * @brief Dispatches a frame after its features are extracted, and the frames without objects behind it.
+   */
+  void OnFeatureDone(const CNFrameInfoPtr &data, bool valid);
+  /**
+   * @brief Dispatches a frame which is not passed to the feature extractor. It is dispatched after the frames of the
+   *        stream ahead of it are extracted.
+   */
+  void Bypass(const CNFrameInfoPtr &data);
+  void TrackFrame(const CNFrameInfoPtr &data);
+  void WorkerLoop();
+  void StopWorkers();
+  // indexed by stream index, created in Open
+  std::vector<std::unique_ptr<TrackerContext>> contexts_;
   std::shared_ptr<infer_server::ModelInfo> model_ = nullptr;
-  std::mutex mutex_;
   std::function<void(const CNFrameInfoPtr, bool)> match_func_;
   bool need_feature_ = true;
+  // indices of streams with pending frames, a stream is queued once and served by one worker at a time
+  std::mutex ready_mtx_;
+  std::condition_variable ready_cond_;
+  std::deque<uint32_t> ready_;
+  bool running_ = false;
+  std::vector<std::thread> workers_;
 };  // class Tracker
 extern int tracker_priority_;
 
@@ -20,13 +20,14 @@
 
 /**
  * @file easy_track.h
- * This file contains FeatureMatchTrack class and KcfTrack class.
+ * This file contains FeatureMatchTrack class and SortTrack class.
  * Its purpose is to achieve object tracking.
  */
 
 #ifndef EASYTRACK_EASY_TRACK_H_
 #define EASYTRACK_EASY_TRACK_H_
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <ostream>
@@ -69,6 +70,20 @@ struct DetectObject {
 /// Alias of vector stored DetectObject
 using Objects = std::vector<DetectObject>;
 
+/**
+ * @brief Statistics of the tracks kept by a tracker.
+ */
+struct TrackStats {
+  /// Number of alive tracks
+  uint32_t track_num = 0;
+  /// Number of confirmed tracks
+  uint32_t confirmed_num = 0;
+  /// Number of features kept in the galleries of all tracks
+  uint64_t feature_num = 0;
+  /// Size of the largest gallery
+  uint32_t max_gallery_size = 0;
+};
+
 
 /**
  * @brief EasyTrack class, help for tracking objects.
@@ -87,6 +102,11 @@ class EasyTrack {
    * @param tracks Tracked objects
    */
   virtual void UpdateFrame(const Objects &detects, Objects *tracks) noexcept(false) = 0;
+
+  /**
+   * @brief Get statistics of the tracks kept currently
+   */
+  virtual TrackStats GetStats() const = 0;
 };  // class EasyTrack
 
 class FeatureMatchPrivate;
@@ -117,8 +137,11 @@ class FeatureMatchTrack : public EasyTrack {
    * @param max_iou_distance Threshold of iou distance
    * @param max_age Object stay alive for [max_age] after disappeared
    * @param n_init After matched [n_init] times in a row, object is turned from TENTATIVE to CONFIRMED
+   * @param prune_distance A feature within [prune_distance] cosine distance of a saved sample replaces it instead of
+   *                       being saved as a new sample, 0 disables it
    */
-  void SetParams(float max_cosine_distance, int nn_budget, float max_iou_distance, int max_age, int n_init);
+  void SetParams(float max_cosine_distance, int nn_budget, float max_iou_distance, int max_age, int n_init,
+                 float prune_distance = 0);
 
   /**
    * @brief Update object status and do tracking using cascade matching and IOU matching.
@@ -128,6 +151,8 @@ class FeatureMatchTrack : public EasyTrack {
    */
   void UpdateFrame(const Objects &detects, Objects *tracks) override;
 
+  TrackStats GetStats() const override;
+
  private:
   FeatureMatchPrivate *fm_p_;
   friend class FeatureMatchPrivate;
@@ -136,8 +161,57 @@ class FeatureMatchTrack : public EasyTrack {
   int max_age_ = 30;
   int n_init_ = 3;
   uint32_t nn_budget_ = 100;
+  float prune_distance_ = 0;
 };  // class FeatureMatchTrack
 
+class SortPrivate;
+
+/**
+ * @brief Track objects based on IOU, as SORT does.
+ *
+ * @note Detections are matched with the bounding boxes of tracks predicted by Kalman filters using IOU and
+ *       an optimal assignment. Features are not used. Pairs which do not overlap enough are never matched, so the
+ *       assignment is solved for each group of overlapping objects, which keeps it cheap with hundreds of objects.
+ */
+class SortTrack : public EasyTrack {
+ public:
+  /**
+   * @brief Constructor of the SortTrack class.
+   */
+  SortTrack();
+
+  /**
+   * @brief Destroy the SortTrack object.
+   */
+  ~SortTrack();
+
+  /**
+   * @brief Set params related to Tracking algorithm.
+   *
+   * @param max_iou_distance Threshold of iou distance
+   * @param max_age Object stay alive for [max_age] after disappeared
+   * @param n_init After matched [n_init] times in a row, object is turned from TENTATIVE to CONFIRMED
+   */
+  void SetParams(float max_iou_distance, int max_age, int n_init);
+
+  /**
+   * @brief Update object status and do tracking using IOU matching.
+   *
+   * @param detects Detected objects
+   * @param tracks Tracked objects
+   */
+  void UpdateFrame(const Objects &detects, Objects *tracks) override;
+
+  TrackStats GetStats() const override;
+
+ private:
+  SortPrivate *sort_p_;
+  friend class SortPrivate;
+  float max_iou_distance_ = 0.7;
+  int max_age_ = 30;
+  int n_init_ = 3;
+};  // class SortTrack
+
 /**
  * @brief Insert DetectObject into the ostream
  *
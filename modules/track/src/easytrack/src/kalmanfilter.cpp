@@ -19,134 +19,230 @@
  *************************************************************************/
 
 #include "kalmanfilter.h"
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <vector>
 
 namespace cnstream {
 
-const Matrix KalmanFilter::motion_mat_{
-    std::vector<float>{1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1,
-                       0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-    8u, 8u};
-const Matrix KalmanFilter::update_mat_{
-    std::vector<float>{1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0},
-    4u, 8u};
+namespace {
 
-const Matrix KalmanFilter::update_mat_trans_{KalmanFilter::update_mat_.Trans()};
-const Matrix KalmanFilter::motion_mat_trans_{KalmanFilter::motion_mat_.Trans()};
+constexpr float kStdWeightPosition = 1. / 20;
+constexpr float kStdWeightVelocity = 1. / 160;
 
-KalmanFilter::KalmanFilter()
-    : mean_(1, 8), covariance_(8, 8), std_weight_position_(1. / 20), std_weight_velocity_(1. / 160) {}
+// lane of covariance element (r, c) in the upper triangle, after the 8 lanes of mean
+inline int CovLane(int r, int c) {
+  if (r > c) std::swap(r, c);
+  return 8 + r * 8 - r * (r - 1) / 2 + (c - r);
+}
 
-void KalmanFilter::Initiate(const BoundingBox &measurement) {
-  // initial state X(k-1|k-1)
-  mean_(0, 0) = measurement.x;
-  mean_(0, 1) = measurement.y;
-  mean_(0, 2) = measurement.width;
-  mean_(0, 3) = measurement.height;
-  for (int i = 4; i < 8; ++i) {
-    mean_(0, i) = 0;
+// S = L * L^T, S is symmetric positive definite
+void Cholesky4(const float s[4][4], float l[4][4]) {
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      float sum = s[i][j];
+      for (int k = 0; k < j; ++k) sum -= l[i][k] * l[j][k];
+      if (i == j) {
+        l[i][i] = std::sqrt(std::max(sum, 1e-12f));
+      } else {
+        l[i][j] = sum / l[j][j];
+      }
+    }
+    for (int j = i + 1; j < 4; ++j) l[i][j] = 0;
   }
+}
 
-  std::vector<float> std(8, 0);
-  std[2] = 1e-2;
-  std[0] = std[1] = std[3] = 2 * std_weight_position_ * measurement.height;
-
-  std[6] = 1e-5;
-  std[4] = std[5] = std[7] = 10 * std_weight_velocity_ * measurement.height;
+// solve L * y = b
+inline void ForwardSubstitute4(const float l[4][4], const float b[4], float y[4]) {
+  for (int i = 0; i < 4; ++i) {
+    float sum = b[i];
+    for (int k = 0; k < i; ++k) sum -= l[i][k] * y[k];
+    y[i] = sum / l[i][i];
+  }
+}
 
-  // init MMSE P(k-1|k-1)
-  for (int i = 0; i < 8; ++i) covariance_(i, i) = std[i] * std[i];
+// solve L^T * x = y
+inline void BackSubstitute4(const float l[4][4], const float y[4], float x[4]) {
+  for (int i = 3; i >= 0; --i) {
+    float sum = y[i];
+    for (int k = i + 1; k < 4; ++k) sum -= l[k][i] * x[k];
+    x[i] = sum / l[i][i];
+  }
 }
 
-void KalmanFilter::Predict() {
-  std::vector<float> std(8, 0);
-  Matrix motion_cov(8, 8);
+// cholesky factor of the projected covariance H * P * H^T + R
+void ProjectedCovarianceFactor(const float mean[8], const float covariance[8][8], float l[4][4]) {
+  // measurement noise R
+  float std_pos = kStdWeightPosition * mean[3];
+  float noise[4] = {std_pos * std_pos, std_pos * std_pos, 1e-1f * 1e-1f, std_pos * std_pos};
+  float s[4][4];
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) s[i][j] = covariance[i][j];
+    s[i][i] += noise[i];
+  }
+  Cholesky4(s, l);
+}
 
-  // process noise covariance Q
+}  // namespace
 
-  std[2] = 1e-2;
-  std[0] = std[1] = std[3] = std_weight_position_ * mean_(0, 3);
-  std[6] = 1e-5;
-  std[4] = std[5] = std[7] = std_weight_velocity_ * mean_(0, 3);
+void KalmanFilterBatch::Reserve(size_t capacity) {
+  if (capacity <= capacity_) return;
+  std::vector<float> data(kLaneNum * capacity);
+  for (int lane = 0; lane < kLaneNum; ++lane) {
+    std::copy(Lane(lane), Lane(lane) + size_, data.data() + lane * capacity);
+  }
+  data_.swap(data);
+  capacity_ = capacity;
+}
 
-  for (int i = 0; i < 8; ++i) {
-    motion_cov(i, i) = std[i] * std[i];
+void KalmanFilterBatch::Gather(size_t idx, float mean[8], float covariance[8][8]) const {
+  for (int i = 0; i < 8; ++i) mean[i] = Lane(i)[idx];
+  for (int r = 0; r < 8; ++r) {
+    for (int c = r; c < 8; ++c) covariance[r][c] = covariance[c][r] = Lane(CovLane(r, c))[idx];
   }
+}
 
-  // formula 1：x(k|k-1)=A*x(k-1|k-1)
-  // mean_ = (motion_mat_ * mean_.Trans()).Trans();
-  Matrix mean1 = mean_ * motion_mat_trans_;
-  // formula 2：P(k|k-1)=A*P(k-1|k-1)A^T +Q
-  Matrix covariance1 = motion_mat_ * covariance_ * motion_mat_trans_ + motion_cov;
-
-  mean_ = std::move(mean1);
-  covariance_ = std::move(covariance1);
-  need_recalc_project_ = true;
+void KalmanFilterBatch::Scatter(size_t idx, const float mean[8], const float covariance[8][8]) {
+  for (int i = 0; i < 8; ++i) Lane(i)[idx] = mean[i];
+  for (int r = 0; r < 8; ++r) {
+    for (int c = r; c < 8; ++c) Lane(CovLane(r, c))[idx] = covariance[r][c];
+  }
 }
 
-void KalmanFilter::Project(const Matrix &mean, const Matrix &covariance) {
-  if (!need_recalc_project_) return;
-  float cov_val1 = 1e-1 * 1e-1;
-  float cov_val2 = std_weight_position_ * mean(0, 3);
-  cov_val2 *= cov_val2;
+void KalmanFilterBatch::Initiate(const BoundingBox &measurement) {
+  if (size_ == capacity_) Reserve(std::max<size_t>(16, capacity_ * 2));
+  size_t idx = size_++;
 
-  // measurement noise R
-  Matrix innovation_cov(4, 4);
+  // initial state X(k-1|k-1)
+  float mean[8] = {measurement.x, measurement.y, measurement.width, measurement.height, 0, 0, 0, 0};
 
-  innovation_cov(0, 0) = cov_val2;
-  innovation_cov(1, 1) = cov_val2;
-  innovation_cov(3, 3) = cov_val2;
+  float std[8];
+  std[2] = 1e-2;
+  std[0] = std[1] = std[3] = 2 * kStdWeightPosition * measurement.height;
+  std[6] = 1e-5;
+  std[4] = std[5] = std[7] = 10 * kStdWeightVelocity * measurement.height;
 
-  innovation_cov(2, 2) = cov_val1;
+  // init MMSE P(k-1|k-1)
+  float covariance[8][8];
+  std::memset(covariance, 0, sizeof(covariance));
+  for (int i = 0; i < 8; ++i) covariance[i][i] = std[i] * std[i];
+  Scatter(idx, mean, covariance);
+}
 
-  // project_mean_ = (update_mat_ * mean_.Trans()).Trans();
-  project_mean_ = mean_ * update_mat_trans_;
+void KalmanFilterBatch::Predict() {
+  const size_t num = size_;
+
+  // formula 2：P(k|k-1)=A*P(k-1|k-1)A^T +Q, A = [I I; 0 I]
+  // the position block takes both cross blocks and the velocity block, read before the cross blocks are updated
+  for (int r = 0; r < 4; ++r) {
+    for (int c = r; c < 4; ++c) {
+      float *p = Lane(CovLane(r, c));
+      const float *cross0 = Lane(CovLane(r, c + 4));
+      const float *cross1 = Lane(CovLane(r + 4, c));
+      const float *vel = Lane(CovLane(r + 4, c + 4));
+      for (size_t i = 0; i < num; ++i) p[i] += cross0[i] + cross1[i] + vel[i];
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 4; c < 8; ++c) {
+      float *p = Lane(CovLane(r, c));
+      const float *vel = Lane(CovLane(r + 4, c));
+      for (size_t i = 0; i < num; ++i) p[i] += vel[i];
+    }
+  }
 
-  // part of formula 3：(H*P(k|k-1)*H^T + R)
-  project_covariance_ = update_mat_ * covariance * update_mat_trans_ + innovation_cov;
-  need_recalc_project_ = false;
+  // process noise covariance Q, depends on the height before prediction
+  const float *h = Lane(3);
+  float *p00 = Lane(CovLane(0, 0)), *p11 = Lane(CovLane(1, 1)), *p22 = Lane(CovLane(2, 2));
+  float *p33 = Lane(CovLane(3, 3)), *p44 = Lane(CovLane(4, 4)), *p55 = Lane(CovLane(5, 5));
+  float *p66 = Lane(CovLane(6, 6)), *p77 = Lane(CovLane(7, 7));
+  for (size_t i = 0; i < num; ++i) {
+    float std_pos = kStdWeightPosition * h[i];
+    float std_vel = kStdWeightVelocity * h[i];
+    float var_pos = std_pos * std_pos;
+    float var_vel = std_vel * std_vel;
+    p00[i] += var_pos;
+    p11[i] += var_pos;
+    p22[i] += 1e-2f * 1e-2f;
+    p33[i] += var_pos;
+    p44[i] += var_vel;
+    p55[i] += var_vel;
+    p66[i] += 1e-5f * 1e-5f;
+    p77[i] += var_vel;
+  }
+
+  // formula 1：x(k|k-1)=A*x(k-1|k-1)
+  for (int k = 0; k < 4; ++k) {
+    float *pos = Lane(k);
+    const float *vel = Lane(k + 4);
+    for (size_t i = 0; i < num; ++i) pos[i] += vel[i];
+  }
 }
 
-void KalmanFilter::Update(const BoundingBox &bbox) {
-  Project(mean_, covariance_);
+void KalmanFilterBatch::Update(size_t idx, const BoundingBox &bbox) {
+  float mean[8];
+  float covariance[8][8];
+  Gather(idx, mean, covariance);
 
-  Matrix measurement(1, 4);
-  measurement(0, 0) = bbox.x;
-  measurement(0, 1) = bbox.y;
-  measurement(0, 2) = bbox.width;
-  measurement(0, 3) = bbox.height;
+  // part of formula 3：(H*P(k|k-1)*H^T + R)
+  float l[4][4];
+  ProjectedCovarianceFactor(mean, covariance, l);
+
+  // formula 3: Kg = P(k|k-1) * H^T * (H*P(k|k-1)*H^T + R)^(-1), solved by rows of Kg
+  float gain[8][4];
+  for (int r = 0; r < 8; ++r) {
+    float y[4];
+    ForwardSubstitute4(l, covariance[r], y);
+    BackSubstitute4(l, y, gain[r]);
+  }
 
-  // formula 3: Kg = P(k|k-1) * H^T * (H*P(k|k-1)*H^T + R)^(-1)
-  Matrix kalman_gain = covariance_ * update_mat_trans_ * project_covariance_.Inv();
   // formula 4: x(k|k) = x(k|k-1) + Kg * (m - H * x(k|k-1))
-  mean_ += (measurement - project_mean_) * kalman_gain.Trans();
-  // formula 5: P(k|k) = P(k|k-1) - Kg * H * P(k|k-1)
-  covariance_ = covariance_ - kalman_gain * update_mat_ * covariance_;
-  // covariance_ = covariance_ - kalman_gain * projected_cov * kalman_gain.Trans();
+  float innovation[4] = {bbox.x - mean[0], bbox.y - mean[1], bbox.width - mean[2], bbox.height - mean[3]};
+  for (int r = 0; r < 8; ++r) {
+    for (int k = 0; k < 4; ++k) mean[r] += gain[r][k] * innovation[k];
+  }
 
-  need_recalc_project_ = true;
+  // formula 5: P(k|k) = P(k|k-1) - Kg * H * P(k|k-1)
+  float updated[8][8];
+  for (int r = 0; r < 8; ++r) {
+    for (int c = r; c < 8; ++c) {
+      float sum = covariance[r][c];
+      for (int k = 0; k < 4; ++k) sum -= gain[r][k] * covariance[k][c];
+      updated[r][c] = updated[c][r] = sum;
+    }
+  }
+  Scatter(idx, mean, updated);
 }
 
-Matrix KalmanFilter::GatingDistance(const std::vector<BoundingBox> &measurements) {
-  Project(mean_, covariance_);
-  Matrix const &mean1 = project_mean_;
-  Matrix covariance1_inv = project_covariance_.Inv();
-
-  int num = measurements.size();
-  Matrix d(1, 4);
-  Matrix square_maha(1, num);
-  for (int i = 0; i < num; i++) {
-    d(0, 0) = measurements[i].x - mean1(0, 0);
-    d(0, 1) = measurements[i].y - mean1(0, 1);
-    d(0, 2) = measurements[i].width - mean1(0, 2);
-    d(0, 3) = measurements[i].height - mean1(0, 3);
-
-    square_maha(0, i) = (d * covariance1_inv * d.Trans())(0, 0);
+void KalmanFilterBatch::GatingDistance(size_t idx, const std::vector<BoundingBox> &measurements,
+                                       float *distances) const {
+  float mean[8];
+  float covariance[8][8];
+  Gather(idx, mean, covariance);
+  float l[4][4];
+  ProjectedCovarianceFactor(mean, covariance, l);
+
+  // d^T * S^(-1) * d = |L^(-1) * d|^2
+  for (size_t i = 0; i < measurements.size(); ++i) {
+    float d[4] = {measurements[i].x - mean[0], measurements[i].y - mean[1], measurements[i].width - mean[2],
+                  measurements[i].height - mean[3]};
+    float y[4];
+    ForwardSubstitute4(l, d, y);
+    distances[i] = y[0] * y[0] + y[1] * y[1] + y[2] * y[2] + y[3] * y[3];
   }
-  return square_maha;
 }
 
-BoundingBox KalmanFilter::GetCurPos() { return {mean_(0, 0), mean_(0, 1), mean_(0, 2), mean_(0, 3)}; }
+BoundingBox KalmanFilterBatch::GetCurPos(size_t idx) const {
+  return {Lane(0)[idx], Lane(1)[idx], Lane(2)[idx], Lane(3)[idx]};
+}
+
+void KalmanFilterBatch::Move(size_t src, size_t dst) {
+  if (src == dst) return;
+  for (int lane = 0; lane < kLaneNum; ++lane) Lane(lane)[dst] = Lane(lane)[src];
+}
+
+void KalmanFilterBatch::Shrink(size_t size) { size_ = std::min(size_, size); }
 
 }  // namespace cnstream
@@ -21,69 +21,72 @@
 #ifndef EASYTRACK_KALMANFILTER_H
 #define EASYTRACK_KALMANFILTER_H
 
-#include <utility>
+#include <cstddef>
 #include <vector>
 
 #include "../include/easy_track.h"
-#include "matrix.h"
 
 namespace cnstream {
 
-using KalHData = std::pair<Matrix, Matrix>;
-
 /**
- * @brief Implementation of Kalman filter
+ * @brief Kalman filters of a group of tracks, on state (x, y, a, h, vx, vy, va, vh) and measurement (x, y, a, h).
+ *
+ * States are stored as structure of arrays, the same element of all filters is contiguous, so the prediction of all
+ * tracks is done in one pass of simple loops. The update and the gating work on fixed-size matrices on stack.
  */
-class KalmanFilter {
+class KalmanFilterBatch {
  public:
   /**
-   * @brief Initialize the state transition matrix and measurement matrix
+   * @brief Number of filters
    */
-  KalmanFilter();
+  size_t Size() const { return size_; }
 
   /**
-   * @brief Initialize the initial state X(k-1|k-1) and MMSE P(k-1|k-1)
+   * @brief Append a filter, initialize the initial state X(k-1|k-1) and MMSE P(k-1|k-1) by measurement
    */
   void Initiate(const BoundingBox& measurement);
 
   /**
-   * @brief Predict the x(k|k-1) and P(k|k-1)
+   * @brief Predict the x(k|k-1) and P(k|k-1) of all filters
    */
   void Predict();
 
   /**
-   * @brief Calculate measurement noise R
+   * @brief Calculate the Kalman gain and update the state and MMSE of filter idx
    */
-  void Project(const Matrix& mean, const Matrix& covariance);
+  void Update(size_t idx, const BoundingBox& measurement);
 
   /**
-   * @brief Calculate the Kalman gain and update the state and MMSE
+   * @brief Calculate the squared mahalanobis distance between measurements and the projected state of filter idx
    */
-  void Update(const BoundingBox& measurement);
+  void GatingDistance(size_t idx, const std::vector<BoundingBox>& measurements, float* distances) const;
+
+  BoundingBox GetCurPos(size_t idx) const;
 
   /**
-   * @brief Calculate the mahalanobis distance
+   * @brief Move filter src to position dst, the filter at dst is overwritten
    */
-  Matrix GatingDistance(const std::vector<BoundingBox>& measurements);
+  void Move(size_t src, size_t dst);
 
-  BoundingBox GetCurPos();
+  /**
+   * @brief Keep the first size filters
+   */
+  void Shrink(size_t size);
 
  private:
-  static const Matrix motion_mat_;
-  static const Matrix update_mat_;
-  static const Matrix motion_mat_trans_;
-  static const Matrix update_mat_trans_;
-  Matrix mean_;
-  Matrix covariance_;
-
-  Matrix project_mean_;
-  Matrix project_covariance_;
-
-  float std_weight_position_;
-  float std_weight_velocity_;
-
-  bool need_recalc_project_{true};
-};  // class KalmanFilter
+  // 8 elements of mean and the upper triangle of covariance
+  static constexpr int kLaneNum = 8 + 36;
+
+  float* Lane(int lane) { return data_.data() + lane * capacity_; }
+  const float* Lane(int lane) const { return data_.data() + lane * capacity_; }
+  void Gather(size_t idx, float mean[8], float covariance[8][8]) const;
+  void Scatter(size_t idx, const float mean[8], const float covariance[8][8]);
+  void Reserve(size_t capacity);
+
+  std::vector<float> data_;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+};  // class KalmanFilterBatch
 
 }  // namespace cnstream
 
@@ -0,0 +1,170 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "lapjv.h"
+
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "cnstream_logging.hpp"
+
+namespace cnstream {
+
+void LapjvAlgorithm::BuildGraph(const Matrix &cost, float max_cost) {
+  rows_ = cost.Rows();
+  cols_ = cost.Cols();
+  row_start_.assign(1, 0);
+  col_idx_.clear();
+  costs_.clear();
+  for (int i = 0; i < rows_; ++i) {
+    for (int j = 0; j < cols_; ++j) {
+      if (cost(i, j) <= max_cost) {
+        col_idx_.push_back(j);
+        costs_.push_back(cost(i, j));
+      }
+    }
+    // the column standing for unassigned
+    col_idx_.push_back(cols_ + i);
+    costs_.push_back(max_cost);
+    row_start_.push_back(col_idx_.size());
+  }
+}
+
+void LapjvAlgorithm::RowReduction() {
+  // columns may stay unassigned, so their duals start from 0 and only decrease once assigned
+  u_.assign(rows_, 0.);
+  v_.assign(cols_ + rows_, 0.);
+  x_.assign(rows_, -1);
+  y_.assign(cols_ + rows_, -1);
+  // assign each row to its cheapest column if the column is still free
+  for (int i = 0; i < rows_; ++i) {
+    int best = row_start_[i];
+    for (int e = row_start_[i] + 1; e < row_start_[i + 1]; ++e) {
+      if (costs_[e] < costs_[best]) best = e;
+    }
+    u_[i] = costs_[best];
+    int j = col_idx_[best];
+    if (y_[j] < 0) {
+      x_[i] = j;
+      y_[j] = i;
+    }
+  }
+}
+
+void LapjvAlgorithm::Augment(int free_row) {
+  using Item = std::pair<double, int>;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+  touched_.clear();
+  reached_rows_.clear();
+
+  // Dijkstra on reduced costs c(i, j) - u(i) - v(j) from the free row, through assigned pairs which are tight
+  int row = free_row;
+  double row_dist = 0.;
+  int end_col = -1;
+  double end_dist = 0.;
+  while (true) {
+    reached_rows_.push_back(row);
+    for (int e = row_start_[row]; e < row_start_[row + 1]; ++e) {
+      int j = col_idx_[e];
+      if (scanned_[j]) continue;
+      double d = row_dist + costs_[e] - u_[row] - v_[j];
+      if (d < dist_[j]) {
+        if (dist_[j] == std::numeric_limits<double>::max()) touched_.push_back(j);
+        dist_[j] = d;
+        pred_[j] = row;
+        heap.emplace(d, j);
+      }
+    }
+    // pop the nearest unscanned column
+    int col = -1;
+    while (!heap.empty()) {
+      Item top = heap.top();
+      heap.pop();
+      if (!scanned_[top.second] && top.first == dist_[top.second]) {
+        col = top.second;
+        break;
+      }
+    }
+    // never happens, the column standing for unassigned is always reachable
+    if (col < 0) LOGF(TRACK) << "LAPJV: no augmenting path";
+    scanned_[col] = 1;
+    if (y_[col] < 0) {
+      end_col = col;
+      end_dist = dist_[col];
+      break;
+    }
+    row = y_[col];
+    row_dist = dist_[col];
+  }
+
+  // update duals so that the edges on shortest paths become tight
+  for (int j : touched_) {
+    if (scanned_[j]) v_[j] -= end_dist - dist_[j];
+  }
+  u_[free_row] += end_dist;
+  for (size_t k = 1; k < reached_rows_.size(); ++k) {
+    int i = reached_rows_[k];
+    u_[i] += end_dist - dist_[x_[i]];
+  }
+
+  // flip the path
+  int col = end_col;
+  while (true) {
+    int i = pred_[col];
+    int next = x_[i];
+    x_[i] = col;
+    y_[col] = i;
+    if (i == free_row) break;
+    col = next;
+  }
+
+  for (int j : touched_) {
+    dist_[j] = std::numeric_limits<double>::max();
+    scanned_[j] = 0;
+  }
+}
+
+float LapjvAlgorithm::Solve(const Matrix &cost, float max_cost, std::vector<int> *assignment) {
+  assignment->assign(cost.Rows(), -1);
+  if (cost.Rows() == 0 || cost.Cols() == 0) return 0.f;
+
+  BuildGraph(cost, max_cost);
+  RowReduction();
+  dist_.assign(cols_ + rows_, std::numeric_limits<double>::max());
+  pred_.assign(cols_ + rows_, -1);
+  scanned_.assign(cols_ + rows_, 0);
+  for (int i = 0; i < rows_; ++i) {
+    if (x_[i] < 0) Augment(i);
+  }
+
+  float total = 0.f;
+  for (int i = 0; i < rows_; ++i) {
+    if (x_[i] < cols_) {
+      (*assignment)[i] = x_[i];
+      total += cost(i, x_[i]);
+    }
+  }
+  return total;
+}
+
+}  // namespace cnstream
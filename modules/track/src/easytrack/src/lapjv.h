@@ -0,0 +1,71 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef EASYTRACK_LAPJV_H_
+#define EASYTRACK_LAPJV_H_
+
+#include <vector>
+
+#include "matrix.h"
+
+namespace cnstream {
+
+/**
+ * Jonker-Volgenant shortest augmenting path solver for the linear assignment problem on a sparse cost matrix.
+ *
+ * Entries costing more than `max_cost` are left out, and each row gets a private column standing for unassigned,
+ * which costs `max_cost`. So the result has the same total cost as HungarianAlgorithm on the matrix with gated
+ * entries set to `max_cost`. Only allowed entries are visited while searching augmenting paths, which keeps crowded
+ * scenes with sparse overlaps cheap.
+ */
+class LapjvAlgorithm {
+ public:
+  /**
+   * Solves the assignment on `cost`. `assignment` is resized to cost.Rows(), and holds the assigned column of each
+   * row, or -1 if the row is unassigned. Returns total cost of assigned pairs.
+   */
+  float Solve(const Matrix &cost, float max_cost, std::vector<int> *assignment);
+
+ private:
+  void BuildGraph(const Matrix &cost, float max_cost);
+  void RowReduction();
+  void Augment(int free_row);
+
+  int rows_ = 0;
+  int cols_ = 0;
+  // rows x (cols + rows) sparse matrix in CSR
+  std::vector<int> row_start_;
+  std::vector<int> col_idx_;
+  std::vector<float> costs_;
+  // dual variables
+  std::vector<double> u_, v_;
+  // x_[row] is the column assigned to row, y_[col] is the row assigned to col
+  std::vector<int> x_, y_;
+  // shortest path search state
+  std::vector<double> dist_;
+  std::vector<int> pred_;
+  std::vector<char> scanned_;
+  std::vector<int> touched_;
+  std::vector<int> reached_rows_;
+};  // class LapjvAlgorithm
+
+}  // namespace cnstream
+
+#endif  // EASYTRACK_LAPJV_H_
@@ -25,10 +25,126 @@
 #include <string>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CNS_TRACK_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CNS_TRACK_NEON
+#endif
+
 #include "matrix.h"
 
 namespace cnstream {
 
+namespace {
+
+// Dot products of `a` with four rows `b[0..3]`, each of `dim` floats. One row of `a` is loaded once for four
+// detections, so a gallery is read det_num / 4 times instead of det_num times.
+using Dot4Func = void (*)(const float *a, const float *const b[4], uint32_t dim, float out[4]);
+
+void Dot4Scalar(const float *a, const float *const b[4], uint32_t dim, float out[4]) {
+  float sum[4] = {0.f, 0.f, 0.f, 0.f};
+  for (uint32_t i = 0; i < dim; ++i) {
+    for (int k = 0; k < 4; ++k) sum[k] += a[i] * b[k][i];
+  }
+  for (int k = 0; k < 4; ++k) out[k] = sum[k];
+}
+
+#ifdef CNS_TRACK_X86
+__attribute__((target("avx2,fma"))) void Dot4Avx2(const float *a, const float *const b[4], uint32_t dim,
+                                                   float out[4]) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+  uint32_t i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256 va = _mm256_loadu_ps(a + i);
+    acc0 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[0] + i), acc0);
+    acc1 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[1] + i), acc1);
+    acc2 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[2] + i), acc2);
+    acc3 = _mm256_fmadd_ps(va, _mm256_loadu_ps(b[3] + i), acc3);
+  }
+  // each 128-bit lane of `sum` holds partial sums of the four rows in order
+  __m256 sum = _mm256_hadd_ps(_mm256_hadd_ps(acc0, acc1), _mm256_hadd_ps(acc2, acc3));
+  _mm_storeu_ps(out, _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+  for (; i < dim; ++i) {
+    for (int k = 0; k < 4; ++k) out[k] += a[i] * b[k][i];
+  }
+}
+#endif  // CNS_TRACK_X86
+
+#ifdef CNS_TRACK_NEON
+inline float ReduceAdd(float32x4_t v) {
+#if defined(__aarch64__)
+  return vaddvq_f32(v);
+#else
+  float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+  return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+
+void Dot4Neon(const float *a, const float *const b[4], uint32_t dim, float out[4]) {
+  float32x4_t acc[4] = {vdupq_n_f32(0.f), vdupq_n_f32(0.f), vdupq_n_f32(0.f), vdupq_n_f32(0.f)};
+  uint32_t i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    float32x4_t va = vld1q_f32(a + i);
+    for (int k = 0; k < 4; ++k) acc[k] = vmlaq_f32(acc[k], va, vld1q_f32(b[k] + i));
+  }
+  for (int k = 0; k < 4; ++k) out[k] = ReduceAdd(acc[k]);
+  for (; i < dim; ++i) {
+    for (int k = 0; k < 4; ++k) out[k] += a[i] * b[k][i];
+  }
+}
+#endif  // CNS_TRACK_NEON
+
+Dot4Func SelectDot4() {
+#if defined(CNS_TRACK_X86)
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Dot4Avx2;
+  return Dot4Scalar;
+#elif defined(CNS_TRACK_NEON)
+  return Dot4Neon;
+#else
+  return Dot4Scalar;
+#endif
+}
+
+}  // namespace
+
+bool NormalizeFeature(const std::vector<float>& feature, float* out) {
+  float mold = L2Norm(feature);
+  if (mold == 0.f) {
+    std::fill(out, out + feature.size(), 0.f);
+    return false;
+  }
+  float inv_mold = 1.f / mold;
+  for (size_t i = 0; i < feature.size(); ++i) out[i] = feature[i] * inv_mold;
+  return true;
+}
+
+void CosineDistanceMatrix(const std::vector<const FeatureGallery*>& galleries, const float* det_feats,
+                          uint32_t det_num, uint32_t dim, Matrix* cost) {
+  static const Dot4Func dot4 = SelectDot4();
+  cost->Resize(galleries.size(), det_num);
+  cost->Fill(1.f);
+  for (uint32_t t = 0; t < galleries.size(); ++t) {
+    const FeatureGallery* gallery = galleries[t];
+    if (!gallery || !gallery->Size() || gallery->Dim() != dim) continue;
+    for (uint32_t d = 0; d < det_num; d += 4) {
+      // pad the last block with the last detection, its results are dropped
+      uint32_t n = std::min(4u, det_num - d);
+      const float* rows[4];
+      for (uint32_t k = 0; k < 4; ++k) rows[k] = det_feats + static_cast<size_t>(d + std::min(k, n - 1)) * dim;
+      float max_simi[4] = {0.f, 0.f, 0.f, 0.f};
+      for (uint32_t f = 0; f < gallery->Size(); ++f) {
+        float simi[4];
+        dot4(gallery->Data() + static_cast<size_t>(f) * dim, rows, dim, simi);
+        for (int k = 0; k < 4; ++k) max_simi[k] = std::max(max_simi[k], simi[k]);
+      }
+      for (uint32_t k = 0; k < n; ++k) (*cost)(t, d + k) = 1.f - std::min(max_simi[k], 1.f);
+    }
+  }
+}
+
 static float CosineDistance(const std::vector<Feature>& track_feats, const Feature& det) {
   float cos_simi, x_y, y_mold, x_mold;
   float max_simi = 0.f;
@@ -52,12 +168,37 @@ static float CosineDistance(const std::vector<Feature>& track_feats, const Featu
 }
 
 thread_local detail::HungarianWorkspace MatchAlgorithm::workspace_;
+thread_local LapjvAlgorithm MatchAlgorithm::lapjv_;
+
+// above this size or under half density, LAPJV outruns the O(n^3) Hungarian algorithm
+static constexpr uint32_t kHungarianMaxSize = 16;
 
 MatchAlgorithm* MatchAlgorithm::Instance(const std::string& func) {
   static std::map<std::string, MatchAlgorithm> algos{{"Cosine", MatchAlgorithm(CosineDistance)}};
   return &(algos.at(func));
 }
 
+void MatchAlgorithm::GatedMatch(const Matrix& cost_matrix, float max_cost, std::vector<int>* assignment) {
+  uint32_t rows = cost_matrix.Rows(), cols = cost_matrix.Cols();
+  if (std::max(rows, cols) <= kHungarianMaxSize) {
+    uint32_t allowed = 0;
+    for (uint32_t i = 0; i < rows; ++i) {
+      for (uint32_t j = 0; j < cols; ++j) {
+        if (cost_matrix(i, j) <= max_cost) ++allowed;
+      }
+    }
+    if (allowed * 2 >= rows * cols) {
+      HungarianMatch(cost_matrix, assignment);
+      for (uint32_t i = 0; i < assignment->size(); ++i) {
+        int& col = (*assignment)[i];
+        if (col >= 0 && cost_matrix(i, col) > max_cost) col = -1;
+      }
+      return;
+    }
+  }
+  lapjv_.Solve(cost_matrix, max_cost, assignment);
+}
+
 inline float MatchAlgorithm::IoU(const Rect& a, const Rect& b) {
   float tl_x = std::max(a.xmin, b.xmin);
   float tl_y = std::max(a.ymin, b.ymin);
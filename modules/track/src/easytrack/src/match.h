@@ -29,6 +29,7 @@
 #include "../include/easy_track.h"
 #include "cnstream_logging.hpp"
 #include "hungarian.h"
+#include "lapjv.h"
 #include "matrix.h"
 #include "track_data_type.h"
 
@@ -75,6 +76,21 @@ static inline float L2Norm(const std::vector<float>& feature) {
   return std::sqrt(InnerProduct(feature, feature));
 }
 
+/**
+ * Writes L2-normalized `feature` to `out`, which has room for feature.size() floats. Returns false and writes
+ * zeros if the feature is all zero.
+ */
+bool NormalizeFeature(const std::vector<float>& feature, float* out);
+
+/**
+ * Computes the cosine distance between each track and each detection, which is the distance to the nearest feature
+ * in the gallery of the track. `det_feats` holds `det_num` L2-normalized features of `dim` floats, row by row.
+ * `cost` is resized to galleries.size() x det_num. Tracks with an empty gallery or a gallery of another dimension get
+ * distance 1 to all detections.
+ */
+void CosineDistanceMatrix(const std::vector<const FeatureGallery*>& galleries, const float* det_feats,
+                          uint32_t det_num, uint32_t dim, Matrix* cost);
+
 class MatchAlgorithm {
  public:
   static MatchAlgorithm *Instance(const std::string &dist_func = "Cosine");
@@ -86,6 +102,12 @@ class MatchAlgorithm {
     hungarian_.Solve(cost_matrix, assignment, workspace_.ptr);
   }
 
+  /**
+   * Solves the assignment on `cost_matrix`, entries over `max_cost` are never assigned (-1 in `assignment`).
+   * Small dense problems are solved by HungarianMatch, others by LAPJV which only visits entries within `max_cost`.
+   */
+  void GatedMatch(const Matrix &cost_matrix, float max_cost, std::vector<int> *assignment);
+
   template <class... Args>
   float Distance(Args &&... args) {
     return dist_func_(std::forward<Args>(args)...);
@@ -95,6 +117,7 @@ class MatchAlgorithm {
   explicit MatchAlgorithm(DistanceFunc func) : dist_func_(func) {}
   float IoU(const Rect &a, const Rect &b);
   static thread_local detail::HungarianWorkspace workspace_;
+  static thread_local LapjvAlgorithm lapjv_;
   HungarianAlgorithm hungarian_;
   DistanceFunc dist_func_;
 };  // class MatchAlgorithm
@@ -21,6 +21,8 @@
 #ifndef EASYTRACK_TRACK_DATA_TYPE_H_
 #define EASYTRACK_TRACK_DATA_TYPE_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -64,6 +66,69 @@ struct Feature {
   Feature() = delete;
 };
 
+/**
+ * L2-normalized features of a track stored contiguously, one row per feature.
+ * At most `budget` rows are kept, the oldest one is overwritten when it is full.
+ * A feature within `prune_distance` (cosine distance) of a kept one replaces it instead of taking a new row, so the
+ * gallery keeps distinct appearances and stays small while the appearance of the track does not change.
+ */
+class FeatureGallery {
+ public:
+  void Reset(uint32_t dim, uint32_t budget, float prune_distance = 0.f) {
+    dim_ = dim;
+    budget_ = budget ? budget : 1;
+    prune_similarity_ = 1.f - prune_distance;
+    prune_ = prune_distance > 0.f;
+    size_ = 0;
+    added_ = 0;
+    data_.clear();
+    stamps_.clear();
+  }
+  void Add(const float *normalized) {
+    uint32_t row = size_;
+    if (prune_ && size_) {
+      // the nearest kept feature is replaced if it is close enough
+      float best = -2.f;
+      uint32_t nearest = 0;
+      for (uint32_t f = 0; f < size_; ++f) {
+        const float *kept = data_.data() + static_cast<size_t>(f) * dim_;
+        float simi = 0.f;
+        for (uint32_t k = 0; k < dim_; ++k) simi += kept[k] * normalized[k];
+        if (simi > best) {
+          best = simi;
+          nearest = f;
+        }
+      }
+      if (best >= prune_similarity_) row = nearest;
+    }
+    if (row == size_) {
+      if (size_ < budget_) {
+        ++size_;
+        data_.resize(static_cast<size_t>(dim_) * size_);
+        stamps_.resize(size_);
+      } else {
+        row = std::min_element(stamps_.begin(), stamps_.end()) - stamps_.begin();
+      }
+    }
+    std::copy(normalized, normalized + dim_, data_.begin() + static_cast<size_t>(row) * dim_);
+    stamps_[row] = added_++;
+  }
+  uint32_t Size() const { return size_; }
+  uint32_t Dim() const { return dim_; }
+  const float *Data() const { return data_.data(); }
+
+ private:
+  std::vector<float> data_;
+  // order of adding of each row, the smallest one is the oldest
+  std::vector<uint64_t> stamps_;
+  uint32_t dim_ = 0;
+  uint32_t budget_ = 1;
+  uint32_t size_ = 0;
+  uint64_t added_ = 0;
+  float prune_similarity_ = 1.f;
+  bool prune_ = false;
+};
+
 struct MatchResult {
   std::vector<MatchData> matches;
   std::vector<int> unmatched_tracks;
@@ -18,6 +18,7 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -59,8 +60,7 @@ static cnstream::BoundingBox to_tlwh(const cnstream::BoundingBox &xyah) {
 namespace cnstream {
 
 struct FeatureMatchTrackObject {
-  KalmanFilter kf;
-  std::vector<Feature> features;
+  FeatureGallery gallery;
   Rect pos;
   int class_id;
   int track_id = -1;
@@ -83,9 +83,10 @@ class FeatureMatchPrivate {
     fm_ = fm;
     match_algo_ = MatchAlgorithm::Instance();
   }
+  void NormalizeFeatures(const Objects &detects);
   void MatchCascade();
   void MatchIou(const std::vector<int> &detect_matrices, const std::vector<int> &track_matrices);
-  void InitNewTrack(const DetectObject &obj);
+  void InitNewTrack(const DetectObject &obj, int detect_idx);
   void MarkMiss(FeatureMatchTrackObject *track);
   void UpdateFrame(const Objects &detects, Objects *tracks);
 
@@ -93,9 +94,18 @@ class FeatureMatchPrivate {
 
   MatchAlgorithm *match_algo_;
   std::vector<FeatureMatchTrackObject> tracks_;
+  // kalman filters of tracks, filter i belongs to tracks_[i]
+  KalmanFilterBatch kf_;
   std::vector<int> unconfirmed_track_;
   std::vector<int> confirmed_track_;
   std::vector<int> assignments_;
+  // L2-normalized features of detections in current frame, one row per detection
+  std::vector<float> det_feats_;
+  std::vector<bool> det_has_feature_;
+  uint32_t feat_dim_ = 0;
+  std::vector<const FeatureGallery *> galleries_;
+  Matrix feature_cost_;
+  std::vector<float> gating_dist_;
   MatchResult res_feature_;
   MatchResult res_iou_;
   const Objects *detects_ = nullptr;
@@ -109,20 +119,42 @@ FeatureMatchTrack::FeatureMatchTrack() { fm_p_ = new FeatureMatchPrivate(this);
 FeatureMatchTrack::~FeatureMatchTrack() { delete fm_p_; }
 
 void FeatureMatchTrack::SetParams(float max_cosine_distance, int nn_budget, float max_iou_distance, int max_age,
-                                  int n_init) {
+                                  int n_init, float prune_distance) {
   // clang-format off
   VLOG1(TRACK) << "FeatureMatchTrack Params -----\n"
                << "\n\t max cosine distance: " << max_cosine_distance
                << "\n\t max IoU distance: " << max_iou_distance
                << "\n\t max age: " << max_age
                << "\n\t nn budget: " << nn_budget
-               << "\n\t n_init: " << n_init;
+               << "\n\t n_init: " << n_init
+               << "\n\t prune distance: " << prune_distance;
   // clang-format on
   max_cosine_distance_ = max_cosine_distance;
   max_iou_distance_ = max_iou_distance;
   nn_budget_ = nn_budget;
   max_age_ = max_age;
   n_init_ = n_init;
+  prune_distance_ = prune_distance;
+}
+
+void FeatureMatchPrivate::NormalizeFeatures(const Objects &detects) {
+  feat_dim_ = 0;
+  for (auto &det : detects) {
+    if (!det.feature.empty()) {
+      feat_dim_ = det.feature.size();
+      break;
+    }
+  }
+  det_feats_.resize(detects.size() * feat_dim_);
+  det_has_feature_.assign(detects.size(), false);
+  for (size_t i = 0; i < detects.size(); ++i) {
+    float *row = det_feats_.data() + i * feat_dim_;
+    if (detects[i].feature.size() == feat_dim_) {
+      det_has_feature_[i] = NormalizeFeature(detects[i].feature, row);
+    } else {
+      std::fill(row, row + feat_dim_, 0.f);
+    }
+  }
 }
 
 void FeatureMatchPrivate::MatchCascade() {
@@ -137,18 +169,22 @@ void FeatureMatchPrivate::MatchCascade() {
 
   if (confirmed_track_.empty() || det_objs.empty()) return;
 
-  for (auto &det_obj : det_objs) {
-    det_obj.feat_mold = L2Norm(det_obj.feature);
+  // feature distance between all confirmed tracks and detections, cascade rounds pick from it
+  galleries_.clear();
+  for (int idx : confirmed_track_) {
+    galleries_.push_back(&tracks_[idx].gallery);
   }
+  CosineDistanceMatrix(galleries_, det_feats_.data(), det_objs.size(), feat_dim_, &feature_cost_);
 
   std::set<int> remained_detections;
   remained_detections.insert(res.unmatched_detections.begin(), res.unmatched_detections.end());
   VLOG5(TRACK) << "MatchCascade) Match scale, detects " << det_objs.size() << " tracks " << confirmed_track_.size();
 
+  // positions in confirmed_track_, grouped by age
   std::map<int, std::vector<int>> age_track_indices;
   for (size_t t = 0; t < confirmed_track_.size(); ++t) {
     int age = tracks_[confirmed_track_[t]].time_since_last_update - 1;
-    age_track_indices[age].push_back(confirmed_track_[t]);
+    age_track_indices[age].push_back(t);
   }
 
   for (int age = 0; age < fm_->max_age_; ++age) {
@@ -166,6 +202,7 @@ void FeatureMatchPrivate::MatchCascade() {
     size_t det_num = res.unmatched_detections.size();
     size_t tra_num = track_indices.size();
     cost_matrix.Resize(tra_num, det_num);
+    gating_dist_.resize(det_num);
 
     // calculate cost matrix
     std::vector<BoundingBox> measurements;
@@ -174,12 +211,10 @@ void FeatureMatchPrivate::MatchCascade() {
       measurements.emplace_back(to_xyah(det_objs[res.unmatched_detections[i]].bbox));
     }
     for (size_t i = 0; i < tra_num; ++i) {
-      Matrix gating_dist = tracks_[track_indices[i]].kf.GatingDistance(measurements);
+      kf_.GatingDistance(confirmed_track_[track_indices[i]], measurements, gating_dist_.data());
       for (size_t j = 0; j < det_num; ++j) {
-        auto &det = det_objs[res.unmatched_detections[j]];
-        cost_matrix(i, j) =
-            match_algo_->Distance(tracks_[track_indices[i]].features, Feature(det.feature, det.feat_mold));
-        if (cost_matrix(i, j) > fm_->max_cosine_distance_ || gating_dist(0, j) > gating_threshold) {
+        cost_matrix(i, j) = feature_cost_(track_indices[i], res.unmatched_detections[j]);
+        if (cost_matrix(i, j) > fm_->max_cosine_distance_ || gating_dist_[j] > gating_threshold) {
           VLOG5(TRACK) << "object " << i << " - " << j << " feature distance is larger than max_cosine_distance";
           cost_matrix(i, j) = fm_->max_cosine_distance_ + 1e-5;
         }
@@ -187,14 +222,15 @@ void FeatureMatchPrivate::MatchCascade() {
     }
 
     // min cost match
-    match_algo_->HungarianMatch(cost_matrix, &assignments_);
+    match_algo_->GatedMatch(cost_matrix, fm_->max_cosine_distance_, &assignments_);
 
     // arrange match result
     for (size_t i = 0; i < assignments_.size(); ++i) {
       if (assignments_[i] < 0 || cost_matrix(i, assignments_[i]) > fm_->max_cosine_distance_) {
-        res.unmatched_tracks.push_back(track_indices[i]);
+        res.unmatched_tracks.push_back(confirmed_track_[track_indices[i]]);
       } else {
-        res.matches.emplace_back(std::make_pair(res.unmatched_detections[assignments_[i]], track_indices[i]));
+        res.matches.emplace_back(
+            std::make_pair(res.unmatched_detections[assignments_[i]], confirmed_track_[track_indices[i]]));
         remained_detections.erase(res.unmatched_detections[assignments_[i]]);
       }
     }
@@ -237,7 +273,7 @@ void FeatureMatchPrivate::MatchIou(const std::vector<int> &detect_indices, const
     tra_rects.emplace_back(tracks_[idx].pos);
   }
   Matrix cost_matrix = match_algo_->IoUCost(tra_rects, det_rects);
-  match_algo_->HungarianMatch(cost_matrix, &assignments_);
+  match_algo_->GatedMatch(cost_matrix, fm_->max_iou_distance_, &assignments_);
 
   for (size_t i = 0; i < assignments_.size(); ++i) {
     if (assignments_[i] < 0 || cost_matrix(i, assignments_[i]) > fm_->max_iou_distance_) {
@@ -252,23 +288,19 @@ void FeatureMatchPrivate::MatchIou(const std::vector<int> &detect_indices, const
                                   remained_detections.end());
 }
 
-void FeatureMatchPrivate::InitNewTrack(const DetectObject &det) {
+void FeatureMatchPrivate::InitNewTrack(const DetectObject &det, int detect_idx) {
   FeatureMatchTrackObject obj;
   obj.age = 1;
   obj.class_id = det.label;
   obj.score = det.score;
   obj.pos = BoundingBox2Rect(det.bbox);
   obj.state = TrackState::TENTATIVE;
-  if (!det.feature.empty()) {
-    for (auto &val : det.feature) {
-      if (val != 0) {
-        obj.has_feature = true;
-        obj.features.emplace_back(det.feature, det.feat_mold);
-        break;
-      }
-    }
+  if (det_has_feature_[detect_idx]) {
+    obj.has_feature = true;
+    obj.gallery.Reset(feat_dim_, fm_->nn_budget_, fm_->prune_distance_);
+    obj.gallery.Add(det_feats_.data() + detect_idx * feat_dim_);
   }
-  obj.kf.Initiate(to_xyah(det.bbox));
+  kf_.Initiate(to_xyah(det.bbox));
   tracks_.emplace_back(std::move(obj));
 }
 
@@ -279,10 +311,7 @@ void FeatureMatchPrivate::MarkMiss(FeatureMatchTrackObject *track) {
 }
 
 void FeatureMatchPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
-  // set feat_mold to -1 means mold has not been computed
-  for (auto &obj : detects) {
-    obj.feat_mold = -1;
-  }
+  NormalizeFeatures(detects);
 
   uint32_t detect_num = detects.size();
   uint32_t track_num = tracks_.size();
@@ -291,7 +320,7 @@ void FeatureMatchPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
   if (tracks_.empty()) {
     tracks_.reserve(detect_num);
     for (size_t i = 0; i < detect_num; ++i) {
-      InitNewTrack(detects[i]);
+      InitNewTrack(detects[i], i);
       tracks->emplace_back(detects[i]);
       tracks->rbegin()->track_id = -1;
       tracks->rbegin()->detect_id = i;
@@ -308,8 +337,10 @@ void FeatureMatchPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
         unconfirmed_track_.push_back(i);
       }
       tracks_[i].time_since_last_update++;
-      tracks_[i].kf.Predict();
-      tracks_[i].pos = BoundingBox2Rect(to_tlwh(tracks_[i].kf.GetCurPos()));
+    }
+    kf_.Predict();
+    for (size_t i = 0; i < track_num; ++i) {
+      tracks_[i].pos = BoundingBox2Rect(to_tlwh(kf_.GetCurPos(i)));
     }
 
     // match with features
@@ -344,18 +375,19 @@ void FeatureMatchPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
     for (auto &pair : res_feature_.matches) {
       ptrack_obj = &(tracks_[pair.second]);
       pdetect_obj = &detects[pair.first];
-      ptrack_obj->kf.Update(to_xyah(pdetect_obj->bbox));
+      kf_.Update(pair.second, to_xyah(pdetect_obj->bbox));
 
       // fill the output
       tracks->emplace_back(*pdetect_obj);
       tracks->rbegin()->track_id = ptrack_obj->track_id;
       tracks->rbegin()->detect_id = pair.first;
 
-      if (ptrack_obj->has_feature) {
-        ptrack_obj->features.emplace_back(pdetect_obj->feature, pdetect_obj->feat_mold);
-        if (ptrack_obj->features.size() > fm_->nn_budget_) {
-          ptrack_obj->features.erase(ptrack_obj->features.begin());
+      if (ptrack_obj->has_feature && det_has_feature_[pair.first]) {
+        // features of another dimension, e.g. the extractor is changed, are not comparable with the kept ones
+        if (ptrack_obj->gallery.Dim() != feat_dim_) {
+          ptrack_obj->gallery.Reset(feat_dim_, fm_->nn_budget_, fm_->prune_distance_);
         }
+        ptrack_obj->gallery.Add(det_feats_.data() + pair.first * feat_dim_);
       }
 
       ptrack_obj->time_since_last_update = 0;
@@ -369,7 +401,7 @@ void FeatureMatchPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
 
     // unmatched detections: init new track
     for (auto &idx : res_iou_.unmatched_detections) {
-      InitNewTrack(detects[idx]);
+      InitNewTrack(detects[idx], idx);
       tracks->emplace_back(detects[idx]);
       tracks->rbegin()->track_id = tracks_.rbegin()->track_id;
       tracks->rbegin()->detect_id = idx;
@@ -381,16 +413,33 @@ void FeatureMatchPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
       MarkMiss(&(tracks_[idx]));
     }
 
-    // erase dead track object
-    for (auto iter = tracks_.begin(); iter != tracks_.end();) {
-      if (iter->state == TrackState::DELETED || iter->time_since_last_update > fm_->max_age_) {
-        VLOG4(TRACK) << "delete track: " << iter->track_id;
-        iter = tracks_.erase(iter);
-      } else {
-        iter++;
+    // erase dead track object, keeping the order of alive ones and their kalman filters
+    size_t alive = 0;
+    for (size_t i = 0; i < tracks_.size(); ++i) {
+      if (tracks_[i].state == TrackState::DELETED || tracks_[i].time_since_last_update > fm_->max_age_) {
+        VLOG4(TRACK) << "delete track: " << tracks_[i].track_id;
+        continue;
       }
+      if (alive != i) {
+        tracks_[alive] = std::move(tracks_[i]);
+        kf_.Move(i, alive);
+      }
+      ++alive;
     }
+    tracks_.erase(tracks_.begin() + alive, tracks_.end());
+    kf_.Shrink(alive);
+  }
+}
+
+TrackStats FeatureMatchTrack::GetStats() const {
+  TrackStats stats;
+  for (const FeatureMatchTrackObject &track : fm_p_->tracks_) {
+    ++stats.track_num;
+    if (track.state == TrackState::CONFIRMED) ++stats.confirmed_num;
+    stats.feature_num += track.gallery.Size();
+    stats.max_gallery_size = std::max(stats.max_gallery_size, track.gallery.Size());
   }
+  return stats;
 }
 
 void FeatureMatchTrack::UpdateFrame(const Objects &detects, Objects *tracks) {
@@ -0,0 +1,363 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "../include/easy_track.h"
+#include "cnstream_logging.hpp"
+#include "match.h"
+#include "matrix.h"
+#include "track_data_type.h"
+
+namespace cnstream {
+
+namespace {
+
+constexpr float kStdWeightPosition = 1. / 20;
+constexpr float kStdWeightVelocity = 1. / 160;
+
+/*
+ * Kalman filter with the same constant velocity model on (center x, center y, aspect ratio, height) as
+ * KalmanFilterBatch. Motion and measurement of the four coordinates are independent, so the 8x8 filter splits into four
+ * 2x2 ones, which gives the same result without any matrix operation.
+ */
+struct SortKalman {
+  // x, y, a, h, vx, vy, va, vh
+  float mean[8];
+  // var(pos), cov(pos, vel), var(vel) of each coordinate
+  float cov[4][3];
+
+  void Initiate(const BoundingBox &xyah) {
+    float std_pos[4] = {2 * kStdWeightPosition * xyah.height, 2 * kStdWeightPosition * xyah.height, 1e-2f,
+                        2 * kStdWeightPosition * xyah.height};
+    float std_vel[4] = {10 * kStdWeightVelocity * xyah.height, 10 * kStdWeightVelocity * xyah.height, 1e-5f,
+                        10 * kStdWeightVelocity * xyah.height};
+    mean[0] = xyah.x;
+    mean[1] = xyah.y;
+    mean[2] = xyah.width;
+    mean[3] = xyah.height;
+    for (int i = 0; i < 4; ++i) {
+      mean[i + 4] = 0;
+      cov[i][0] = std_pos[i] * std_pos[i];
+      cov[i][1] = 0;
+      cov[i][2] = std_vel[i] * std_vel[i];
+    }
+  }
+
+  void Predict() {
+    float h = mean[3];
+    float std_pos[4] = {kStdWeightPosition * h, kStdWeightPosition * h, 1e-2f, kStdWeightPosition * h};
+    float std_vel[4] = {kStdWeightVelocity * h, kStdWeightVelocity * h, 1e-5f, kStdWeightVelocity * h};
+    for (int i = 0; i < 4; ++i) {
+      float *c = cov[i];
+      mean[i] += mean[i + 4];
+      // P = F * P * F^T + Q, F = [1 1; 0 1]
+      c[0] += 2 * c[1] + c[2] + std_pos[i] * std_pos[i];
+      c[1] += c[2];
+      c[2] += std_vel[i] * std_vel[i];
+    }
+  }
+
+  void Update(const BoundingBox &xyah) {
+    float h = mean[3];
+    float std_meas[4] = {kStdWeightPosition * h, kStdWeightPosition * h, 1e-1f, kStdWeightPosition * h};
+    float z[4] = {xyah.x, xyah.y, xyah.width, xyah.height};
+    for (int i = 0; i < 4; ++i) {
+      float *c = cov[i];
+      float s = c[0] + std_meas[i] * std_meas[i];
+      float k0 = c[0] / s, k1 = c[1] / s;
+      float innovation = z[i] - mean[i];
+      mean[i] += k0 * innovation;
+      mean[i + 4] += k1 * innovation;
+      // P = (I - K * H) * P
+      c[2] -= k1 * c[1];
+      c[1] -= k0 * c[1];
+      c[0] -= k0 * c[0];
+    }
+  }
+
+  Rect GetRect() const {
+    Rect rect;
+    float w = mean[2] * mean[3];
+    rect.xmin = mean[0] - w / 2;
+    rect.ymin = mean[1] - mean[3] / 2;
+    rect.xmax = rect.xmin + w;
+    rect.ymax = rect.ymin + mean[3];
+    return rect;
+  }
+};
+
+inline BoundingBox ToXyah(const BoundingBox &bbox) {
+  BoundingBox xyah;
+  xyah.x = bbox.x + bbox.width / 2;
+  xyah.y = bbox.y + bbox.height / 2;
+  xyah.width = bbox.width / bbox.height;
+  xyah.height = bbox.height;
+  return xyah;
+}
+
+inline float IoU(const Rect &a, const Rect &b) {
+  float iw = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
+  float ih = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
+  if (iw <= 0 || ih <= 0) return 0;
+  float inter = iw * ih;
+  float uni = (a.xmax - a.xmin) * (a.ymax - a.ymin) + (b.xmax - b.xmin) * (b.ymax - b.ymin) - inter;
+  return uni > 0 ? inter / uni : 0;
+}
+
+struct SortTrackObject {
+  SortKalman kf;
+  Rect pos;
+  int track_id = -1;
+  TrackState state = TrackState::TENTATIVE;
+  int age = 1;
+  int time_since_last_update = 0;
+};
+
+struct Candidate {
+  int track;
+  int detect;
+  float cost;
+  int group;
+};
+
+}  // namespace
+
+class SortPrivate {
+ private:
+  explicit SortPrivate(SortTrack *sort) : sort_(sort), match_algo_(MatchAlgorithm::Instance()) {}
+  int FindRoot(int node);
+  void Match(const std::vector<Rect> &det_rects);
+  void InitNewTrack(const DetectObject &det);
+  void UpdateFrame(const Objects &detects, Objects *tracks);
+
+  SortTrack *sort_;
+
+  MatchAlgorithm *match_algo_;
+  std::vector<SortTrackObject> tracks_;
+  MatchResult res_;
+  std::vector<Candidate> candidates_;
+  // union-find forest over tracks and detections, detection i is node (track number + i)
+  std::vector<int> parent_;
+  std::vector<int> group_tracks_;
+  std::vector<int> group_detects_;
+  std::vector<int> local_idx_;
+  std::vector<int> assignments_;
+  Matrix cost_matrix_;
+
+  uint64_t next_id_ = 0;
+  friend class SortTrack;
+};  // class SortPrivate
+
+SortTrack::SortTrack() { sort_p_ = new SortPrivate(this); }
+
+SortTrack::~SortTrack() { delete sort_p_; }
+
+void SortTrack::SetParams(float max_iou_distance, int max_age, int n_init) {
+  // clang-format off
+  VLOG1(TRACK) << "SortTrack Params -----\n"
+               << "\n\t max IoU distance: " << max_iou_distance
+               << "\n\t max age: " << max_age
+               << "\n\t n_init: " << n_init;
+  // clang-format on
+  max_iou_distance_ = max_iou_distance;
+  max_age_ = max_age;
+  n_init_ = n_init;
+}
+
+int SortPrivate::FindRoot(int node) {
+  while (parent_[node] != node) {
+    parent_[node] = parent_[parent_[node]];
+    node = parent_[node];
+  }
+  return node;
+}
+
+void SortPrivate::Match(const std::vector<Rect> &det_rects) {
+  res_.Clean();
+  int track_num = tracks_.size();
+  int detect_num = det_rects.size();
+
+  // gate pairs by iou, pairs over the threshold could never be matched
+  candidates_.clear();
+  for (int t = 0; t < track_num; ++t) {
+    const Rect &pos = tracks_[t].pos;
+    for (int d = 0; d < detect_num; ++d) {
+      float cost = 1.0f - IoU(pos, det_rects[d]);
+      if (cost <= sort_->max_iou_distance_) candidates_.push_back({t, d, cost, 0});
+    }
+  }
+
+  // split into groups of objects connected by candidate pairs, each group is an independent assignment problem
+  parent_.resize(track_num + detect_num);
+  std::iota(parent_.begin(), parent_.end(), 0);
+  for (auto &c : candidates_) {
+    int a = FindRoot(c.track), b = FindRoot(track_num + c.detect);
+    if (a != b) parent_[b] = a;
+  }
+
+  for (auto &c : candidates_) c.group = FindRoot(c.track);
+  std::sort(candidates_.begin(), candidates_.end(),
+            [](const Candidate &lhs, const Candidate &rhs) { return lhs.group < rhs.group; });
+
+  std::vector<bool> track_matched(track_num, false), detect_matched(detect_num, false);
+  local_idx_.resize(track_num + detect_num);
+  for (size_t begin = 0, end = 0; begin < candidates_.size(); begin = end) {
+    end = begin;
+    while (end < candidates_.size() && candidates_[end].group == candidates_[begin].group) ++end;
+
+    if (end - begin == 1) {
+      // only one candidate pair, no conflict
+      const Candidate &c = candidates_[begin];
+      res_.matches.emplace_back(c.detect, c.track);
+      track_matched[c.track] = detect_matched[c.detect] = true;
+      continue;
+    }
+
+    group_tracks_.clear();
+    group_detects_.clear();
+    for (size_t i = begin; i < end; ++i) {
+      const Candidate &c = candidates_[i];
+      if (!track_matched[c.track]) {
+        track_matched[c.track] = true;
+        local_idx_[c.track] = group_tracks_.size();
+        group_tracks_.push_back(c.track);
+      }
+      if (!detect_matched[c.detect]) {
+        detect_matched[c.detect] = true;
+        local_idx_[track_num + c.detect] = group_detects_.size();
+        group_detects_.push_back(c.detect);
+      }
+    }
+    // flags are set by the assignment below
+    for (int t : group_tracks_) track_matched[t] = false;
+    for (int d : group_detects_) detect_matched[d] = false;
+
+    cost_matrix_.Resize(group_tracks_.size(), group_detects_.size());
+    cost_matrix_.Fill(sort_->max_iou_distance_ + 1e-5);
+    for (size_t i = begin; i < end; ++i) {
+      const Candidate &c = candidates_[i];
+      cost_matrix_(local_idx_[c.track], local_idx_[track_num + c.detect]) = c.cost;
+    }
+    match_algo_->GatedMatch(cost_matrix_, sort_->max_iou_distance_, &assignments_);
+    for (size_t i = 0; i < assignments_.size(); ++i) {
+      if (assignments_[i] < 0 || cost_matrix_(i, assignments_[i]) > sort_->max_iou_distance_) continue;
+      int t = group_tracks_[i], d = group_detects_[assignments_[i]];
+      res_.matches.emplace_back(d, t);
+      track_matched[t] = detect_matched[d] = true;
+    }
+  }
+
+  for (int t = 0; t < track_num; ++t) {
+    if (!track_matched[t]) res_.unmatched_tracks.push_back(t);
+  }
+  for (int d = 0; d < detect_num; ++d) {
+    if (!detect_matched[d]) res_.unmatched_detections.push_back(d);
+  }
+}
+
+void SortPrivate::InitNewTrack(const DetectObject &det) {
+  SortTrackObject obj;
+  obj.kf.Initiate(ToXyah(det.bbox));
+  obj.pos = BoundingBox2Rect(det.bbox);
+  tracks_.emplace_back(obj);
+}
+
+void SortPrivate::UpdateFrame(const Objects &detects, Objects *tracks) {
+  uint32_t detect_num = detects.size();
+  VLOG5(TRACK) << "Sort) Track scale, detects " << detect_num << " tracks " << tracks_.size();
+
+  for (auto &track : tracks_) {
+    track.time_since_last_update++;
+    track.kf.Predict();
+    track.pos = track.kf.GetRect();
+  }
+
+  std::vector<Rect> det_rects;
+  det_rects.reserve(detect_num);
+  for (auto &det : detects) {
+    det_rects.emplace_back(BoundingBox2Rect(det.bbox));
+  }
+
+  Match(det_rects);
+  VLOG5(TRACK) << "Sort) IoU result, matched " << res_.matches.size() << " unmatched detects "
+               << res_.unmatched_detections.size() << " unmatched tracks " << res_.unmatched_tracks.size();
+
+  // update matched
+  tracks->reserve(tracks->size() + detect_num);
+  for (auto &pair : res_.matches) {
+    SortTrackObject &track = tracks_[pair.second];
+    const DetectObject &det = detects[pair.first];
+    track.kf.Update(ToXyah(det.bbox));
+    track.time_since_last_update = 0;
+    track.age++;
+    if (track.state == TrackState::TENTATIVE && track.age > sort_->n_init_) {
+      VLOG4(TRACK) << "new track: " << next_id_;
+      track.state = TrackState::CONFIRMED;
+      track.track_id = next_id_++;
+    }
+
+    // fill the output
+    tracks->emplace_back(det);
+    tracks->rbegin()->track_id = track.track_id;
+    tracks->rbegin()->detect_id = pair.first;
+  }
+
+  // unmatched tracks: tentative ones are dropped at once, confirmed ones live for max_age frames
+  for (auto idx : res_.unmatched_tracks) {
+    SortTrackObject &track = tracks_[idx];
+    if (track.state == TrackState::TENTATIVE || track.time_since_last_update > sort_->max_age_) {
+      VLOG4(TRACK) << "delete track: " << track.track_id;
+      track.state = TrackState::DELETED;
+    }
+  }
+  tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                               [](const SortTrackObject &track) { return track.state == TrackState::DELETED; }),
+                tracks_.end());
+
+  // unmatched detections: init new track
+  for (auto &idx : res_.unmatched_detections) {
+    InitNewTrack(detects[idx]);
+    tracks->emplace_back(detects[idx]);
+    tracks->rbegin()->track_id = -1;
+    tracks->rbegin()->detect_id = idx;
+  }
+}
+
+TrackStats SortTrack::GetStats() const {
+  TrackStats stats;
+  for (const SortTrackObject &track : sort_p_->tracks_) {
+    ++stats.track_num;
+    if (track.state == TrackState::CONFIRMED) ++stats.confirmed_num;
+  }
+  return stats;
+}
+
+void SortTrack::UpdateFrame(const Objects &detects, Objects *tracks) {
+  if (!tracks) {
+    LOGF(TRACK) << "parameter 'tracks' is nullptr";
+  }
+  sort_p_->UpdateFrame(detects, tracks);
+}
+
+}  // namespace cnstream
@@ -20,6 +20,7 @@
 
 #include "feature_extractor.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -165,37 +166,85 @@ bool FeatureExtractor::ExtractFeatureOnMlu(const CNFrameInfoPtr& info) {
   return true;
 }
 
-bool FeatureExtractor::ExtractFeatureOnCpu(const CNFrameInfoPtr& info) {
-  const CNDataFramePtr& frame = info->collection.Get<CNDataFramePtr>(kCNDataFrameTag);
-  if (info->collection.HasValue(kCNInferObjsTag)) {
-    CNInferObjsPtr objs_holder = info->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
-    std::unique_lock<std::mutex> guard(objs_holder->mutex_);
+namespace {
 
-    const cv::Mat image = frame->ImageBGR();
-    for (uint32_t num = 0; num < objs_holder->objs_.size(); ++num) {
-      auto& obj = objs_holder->objs_[num];
-      cv::Rect rect = cv::Rect(obj->bbox.x * image.cols, obj->bbox.y * image.rows, obj->bbox.w * image.cols,
-                               obj->bbox.h * image.rows);
-      cv::Mat obj_img(image, rect);
+// sign weighted grey sum of a descriptor row
+float CalcFeatureOfRow(const cv::Mat& desc, int n) {
+  float result = 0;
+  const uchar* row = desc.ptr<uchar>(n);
+  for (int i = 0; i < desc.cols; i++) {
+    int grey = row[i];
+    result += grey > 127 ? static_cast<float>(grey) / 255 : -static_cast<float>(grey) / 255;
+  }
+  return result;
+}
+
+// Computes the features of a range of objects. Each thread of the opencv pool keeps its own ORB detector, so
+// detectors are created once per thread instead of once per object.
+class CpuFeatureBody : public cv::ParallelLoopBody {
+ public:
+  // image is the grey Y plane of YUV frames, or the BGR image of other frames
+  CpuFeatureBody(const cv::Mat& image, const std::vector<CNInferObjectPtr>& objs) : image_(image), objs_(objs) {}
+
+  void operator()(const cv::Range& range) const override {
 #if (CV_MAJOR_VERSION == 2)  // NOLINT
-      cv::Ptr<cv::ORB> processer = new cv::ORB(kFeatureSizeForCpu);
+    thread_local cv::Ptr<cv::ORB> processer = new cv::ORB(kFeatureSizeForCpu);
 #elif (CV_MAJOR_VERSION >= 3)  //  NOLINT
-      cv::Ptr<cv::ORB> processer = cv::ORB::create(kFeatureSizeForCpu);
+    thread_local cv::Ptr<cv::ORB> processer = cv::ORB::create(kFeatureSizeForCpu);
 #endif
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat desc;
+    for (int idx = range.start; idx < range.end; ++idx) {
+      const CNInferObjectPtr& obj = objs_[idx];
+      CNInferFeature feature(kFeatureSizeForCpu, 0.f);
+      cv::Rect rect = cv::Rect(obj->bbox.x * image_.cols, obj->bbox.y * image_.rows, obj->bbox.w * image_.cols,
+                               obj->bbox.h * image_.rows);
+      rect &= cv::Rect(0, 0, image_.cols, image_.rows);
+      if (rect.area() > 0) {
+        // the crop shares data with the frame, nothing is copied or cached
+        cv::Mat obj_img = image_(rect);
+        keypoints.clear();
+#if (CV_MAJOR_VERSION == 2)  // NOLINT
+        (*processer)(obj_img, cv::noArray(), keypoints, desc);
+#elif (CV_MAJOR_VERSION >= 3)  //  NOLINT
+        processer->detectAndCompute(obj_img, cv::noArray(), keypoints, desc);
+#endif
+        for (int i = 0; i < kFeatureSizeForCpu && i < desc.rows; i++) {
+          feature[i] = CalcFeatureOfRow(desc, i);
+        }
+      }
+      obj->AddFeature("track", feature);
+    }
+  }
 
+ private:
+  const cv::Mat& image_;
+  const std::vector<CNInferObjectPtr>& objs_;
+};  // class CpuFeatureBody
 
-      std::vector<cv::KeyPoint> keypoints;
-      processer->detect(obj_img, keypoints);
-      cv::Mat desc;
-      processer->compute(obj_img, keypoints, desc);
-      std::vector<float> feature;
-      feature.reserve(kFeatureSizeForCpu);
-      for (int i = 0; i < kFeatureSizeForCpu; i++) {
-        feature.push_back((i < desc.rows ? CalcFeatureOfRow(desc, i) : 0));
-      }
-      obj->AddFeature("track", std::move(feature));
+}  // namespace
+
+bool FeatureExtractor::ExtractFeatureOnCpu(const CNFrameInfoPtr& info) {
+  const CNDataFramePtr& frame = info->collection.Get<CNDataFramePtr>(kCNDataFrameTag);
+  if (info->collection.HasValue(kCNInferObjsTag)) {
+    CNInferObjsPtr objs_holder = info->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
+    std::unique_lock<std::mutex> guard(objs_holder->mutex_);
+    const std::vector<CNInferObjectPtr>& objs = objs_holder->objs_;
+
+    // ORB works on grey images, objects of YUV frames are cropped from the Y plane without color conversion.
+    // Only other formats go through the full frame BGR image.
+    cv::Mat image;
+    CnedkBufSurfaceColorFormat fmt = frame->buf_surf ? frame->buf_surf->GetColorFormat() : CNEDK_BUF_COLOR_FORMAT_BGR;
+    if (fmt == CNEDK_BUF_COLOR_FORMAT_NV12 || fmt == CNEDK_BUF_COLOR_FORMAT_NV21) {
+      CnedkBufSurfaceSyncForCpu(frame->buf_surf->GetBufSurface(), -1, -1);
+      image = cv::Mat(frame->buf_surf->GetHeight(), frame->buf_surf->GetWidth(), CV_8UC1,
+                      frame->buf_surf->GetHostData(0), frame->buf_surf->GetStride(0));
+    } else {
+      image = frame->ImageBGR();
     }
 
+    cv::parallel_for_(cv::Range(0, static_cast<int>(objs.size())), CpuFeatureBody(image, objs));
+
     guard.unlock();
     callback_(info, true);
     return true;
@@ -203,15 +252,6 @@ bool FeatureExtractor::ExtractFeatureOnCpu(const CNFrameInfoPtr& info) {
   return true;
 }
 
-float FeatureExtractor::CalcFeatureOfRow(const cv::Mat& image, int n) {
-  float result = 0;
-  for (int i = 0; i < image.cols; i++) {
-    int grey = image.ptr<uchar>(n)[i];
-    result += grey > 127 ? static_cast<float>(grey) / 255 : -static_cast<float>(grey) / 255;
-  }
-  return result;
-}
-
 int FeatureExtractor::OnTensorParams(const infer_server::CnPreprocTensorParams* params) {
   uint32_t model_input_c;
   if (params->input_order == infer_server::DimOrder::NHWC) {
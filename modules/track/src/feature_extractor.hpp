@@ -69,7 +69,6 @@ class FeatureExtractor : public infer_server::IPreproc, public infer_server::IPo
  private:
   bool ExtractFeatureOnMlu(const CNFrameInfoPtr& info);
   bool ExtractFeatureOnCpu(const CNFrameInfoPtr& info);
-  float CalcFeatureOfRow(const cv::Mat& image, int n);
 
   std::shared_ptr<infer_server::ModelInfo> model_{nullptr};
   std::unique_ptr<infer_server::InferServer> server_{nullptr};
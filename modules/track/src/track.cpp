@@ -18,8 +18,12 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <algorithm>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "cnis/processor.h"
@@ -39,6 +43,15 @@ int tracker_priority_ = -1;
 
 struct TrackerContext {
   std::unique_ptr<EasyTrack> processer_ = nullptr;
+  // frames waiting for a worker, in order
+  std::mutex mtx_;
+  std::deque<CNFrameInfoPtr> pending_;
+  bool scheduled_ = false;
+  // frames in feature extraction (true) and frames without objects behind them (false), in order
+  std::mutex extract_mtx_;
+  std::deque<std::pair<CNFrameInfoPtr, bool>> extracting_;
+  // peak statistics of the stream, collected with show_stats
+  TrackStats peak_stats_;
   TrackerContext() = default;
   ~TrackerContext() = default;
   TrackerContext(const TrackerContext &) = delete;
@@ -90,20 +103,47 @@ Tracker::Tracker(const std::string &name) : ModuleEx(name) {
       ModuleParamParser<uint32_t>::Parser, "uint32_t"},
 
     {"show_stats", "false",
-      "Optional. Whether show performance statistics. "
+      "Optional. Whether show performance statistics. Peak track and feature numbers of streams are shown at EOS. "
       "1/true/TRUE/True/0/false/FALSE/False these values are accepted.",
       PARAM_OPTIONAL, OFFSET(TrackParams, show_stats), ModuleParamParser<bool>::Parser, "bool"},
 
     {"model_path", "", "The path of the offline model.", PARAM_OPTIONAL, OFFSET(TrackParams, model_path),
       ModuleParamParser<std::string>::Parser, "string"},
 
-    {"track_name", "FeatureMatch", "Track algorithm name. Choose from FeatureMatch and IoUMatch.",
+    {"track_name", "FeatureMatch", "Track algorithm name. Choose from FeatureMatch, SORT and IoUMatch. "
+      "SORT tracks objects by IoU only, without extracting features. IoUMatch is an alias of SORT.",
       PARAM_OPTIONAL, OFFSET(TrackParams, track_name),
       ModuleParamParser<std::string>::Parser, "string"},
 
-    {"max_cosine_distance", "0.2", "Threshold of cosine distance.",
+    {"max_cosine_distance", "0.2", "Threshold of cosine distance. Range [0, 2].",
       PARAM_OPTIONAL, OFFSET(TrackParams, max_cosine_distance),
-      ModuleParamParser<float>::Parser, "float"}
+      ModuleParamParser<float>::Parser, "float"},
+
+    {"nn_budget", "100",
+      "Optional. Max number of features kept for each track by FeatureMatch. "
+      "Larger values use more memory and make feature matching slower.",
+      PARAM_OPTIONAL, OFFSET(TrackParams, nn_budget), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
+
+    {"feature_prune_distance", "0",
+      "Optional. Used by FeatureMatch. A feature of a track within this cosine distance of a kept one replaces it "
+      "instead of being kept as a new one, so that tracks with steady appearance keep few features. 0 means keeping "
+      "the latest nn_budget features. Range [0, max_cosine_distance].",
+      PARAM_OPTIONAL, OFFSET(TrackParams, feature_prune_distance), ModuleParamParser<float>::Parser, "float"},
+
+    {"max_iou_distance", "0.7", "Optional. Threshold of IoU distance (1 - IoU). Range [0, 1].",
+      PARAM_OPTIONAL, OFFSET(TrackParams, max_iou_distance), ModuleParamParser<float>::Parser, "float"},
+
+    {"max_age", "30", "Optional. Number of frames a track stays alive after its object disappeared.",
+      PARAM_OPTIONAL, OFFSET(TrackParams, max_age), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
+
+    {"n_init", "3", "Optional. A track is confirmed and given an id after matched in n_init frames.",
+      PARAM_OPTIONAL, OFFSET(TrackParams, n_init), ModuleParamParser<uint32_t>::Parser, "uint32_t"},
+
+    {"worker_num", "0",
+      "Optional. Number of threads tracking streams in parallel, CPU features are extracted by them as well. "
+      "Frames of a stream are still tracked in order. "
+      "0 means tracking in the thread of the module.",
+      PARAM_OPTIONAL, OFFSET(TrackParams, worker_num), ModuleParamParser<uint32_t>::Parser, "uint32_t"}
   };
 
   param_helper_->Register(register_param, &param_register_);
@@ -131,28 +171,194 @@ bool Tracker::InitFeatureExtractor(const CNFrameInfoPtr &data) {
 }
 
 TrackerContext *Tracker::GetContext(const CNFrameInfoPtr &data) {
-  TrackerContext *ctx = nullptr;
-  std::unique_lock<std::mutex> guard(mutex_);
-  auto search = contexts_.find(data->GetStreamIndex());
-  if (search != contexts_.end()) {
-    // context exists
-    ctx = search->second;
-  } else {
-    ctx = new TrackerContext;
+  // frames of a stream are tracked one at a time, so the tracker of the stream is created without lock
+  TrackerContext *ctx = contexts_[data->GetStreamIndex()].get();
+  if (!ctx->processer_) {
     auto params = param_helper_->GetParams();
-    FeatureMatchTrack *track = new FeatureMatchTrack;
-    track->SetParams(params.max_cosine_distance, 100, 0.7, 30, 3);
-    ctx->processer_.reset(track);
-    contexts_[data->GetStreamIndex()] = ctx;
+    if (need_feature_) {
+      FeatureMatchTrack *track = new FeatureMatchTrack;
+      track->SetParams(params.max_cosine_distance, params.nn_budget, params.max_iou_distance, params.max_age,
+                       params.n_init, params.feature_prune_distance);
+      ctx->processer_.reset(track);
+    } else {
+      SortTrack *track = new SortTrack;
+      track->SetParams(params.max_iou_distance, params.max_age, params.n_init);
+      ctx->processer_.reset(track);
+    }
   }
   return ctx;
 }
 
+void Tracker::TrackFrame(const CNFrameInfoPtr &data) {
+  if (data->IsEos()) {
+    TrackerContext *ctx = contexts_[data->GetStreamIndex()].get();
+    if (ctx->processer_ && param_helper_->GetParams().show_stats) {
+      const TrackStats &stats = ctx->peak_stats_;
+      LOGI(TRACK) << "[" << GetName() << "] stream " << data->stream_id << ": peak " << stats.track_num
+                  << " tracks (" << stats.confirmed_num << " confirmed), " << stats.feature_num
+                  << " features in galleries, largest gallery " << stats.max_gallery_size << ".";
+    }
+    // the stream index may be taken by a new stream
+    ctx->processer_.reset();
+    ctx->peak_stats_ = TrackStats();
+    TransmitData(data);
+    return;
+  }
+  if (!data->collection.HasValue(kCNInferObjsTag)) {
+    TransmitData(data);
+    return;
+  }
+  CNInferObjsPtr objs_holder = data->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
+
+  std::vector<DetectObject> in, out;
+  std::unique_lock<std::mutex> guard(objs_holder->mutex_);
+  in.reserve(objs_holder->objs_.size());
+
+  for (size_t i = 0; i < objs_holder->objs_.size(); i++) {
+    DetectObject obj;
+    obj.label = std::stoi(objs_holder->objs_[i]->id);
+    obj.score = objs_holder->objs_[i]->score;
+    obj.bbox.x = objs_holder->objs_[i]->bbox.x;
+    obj.bbox.y = objs_holder->objs_[i]->bbox.y;
+    obj.bbox.width = objs_holder->objs_[i]->bbox.w;
+    obj.bbox.height = objs_holder->objs_[i]->bbox.h;
+    obj.feature = objs_holder->objs_[i]->GetFeature("track");
+    in.emplace_back(obj);
+  }
+  TrackerContext *ctx = GetContext(data);
+  ctx->processer_->UpdateFrame(in, &out);
+  if (param_helper_->GetParams().show_stats) {
+    TrackStats stats = ctx->processer_->GetStats();
+    TrackStats &peak = ctx->peak_stats_;
+    peak.track_num = std::max(peak.track_num, stats.track_num);
+    peak.confirmed_num = std::max(peak.confirmed_num, stats.confirmed_num);
+    peak.feature_num = std::max(peak.feature_num, stats.feature_num);
+    peak.max_gallery_size = std::max(peak.max_gallery_size, stats.max_gallery_size);
+  }
+  for (size_t i = 0; i < out.size(); i++) {
+    objs_holder->objs_[out[i].detect_id]->track_id = std::to_string(out[i].track_id);
+  }
+
+  guard.unlock();
+  TransmitData(data);
+}
+
+void Tracker::Dispatch(const CNFrameInfoPtr &data) {
+  if (workers_.empty()) {
+    TrackFrame(data);
+    return;
+  }
+  uint32_t stream_idx = data->GetStreamIndex();
+  TrackerContext *ctx = contexts_[stream_idx].get();
+  {
+    std::lock_guard<std::mutex> lk(ctx->mtx_);
+    ctx->pending_.push_back(data);
+    // a worker is serving the stream, it takes the frame later
+    if (ctx->scheduled_) return;
+    ctx->scheduled_ = true;
+  }
+  std::lock_guard<std::mutex> lk(ready_mtx_);
+  ready_.push_back(stream_idx);
+  ready_cond_.notify_one();
+}
+
+void Tracker::OnFeatureDone(const CNFrameInfoPtr &data, bool valid) {
+  TrackerContext *ctx = contexts_[data->GetStreamIndex()].get();
+  std::lock_guard<std::mutex> lk(ctx->extract_mtx_);
+  // responses are in order, frames ahead of it are discarded
+  while (!ctx->extracting_.empty() && ctx->extracting_.front().first != data) ctx->extracting_.pop_front();
+  if (!ctx->extracting_.empty()) ctx->extracting_.pop_front();
+  // dispatched with the lock held, so that frames of a stream are never reordered
+  if (valid) {
+    Dispatch(data);
+  } else {
+    PostEvent(EventType::EVENT_ERROR, "Extract feature failed");
+  }
+  while (!ctx->extracting_.empty() && !ctx->extracting_.front().second) {
+    Dispatch(ctx->extracting_.front().first);
+    ctx->extracting_.pop_front();
+  }
+}
+
+void Tracker::Bypass(const CNFrameInfoPtr &data) {
+  TrackerContext *ctx = contexts_[data->GetStreamIndex()].get();
+  std::lock_guard<std::mutex> lk(ctx->extract_mtx_);
+  if (!ctx->extracting_.empty()) {
+    ctx->extracting_.emplace_back(data, false);
+    return;
+  }
+  Dispatch(data);
+}
+
+void Tracker::WorkerLoop() {
+  std::unique_ptr<FeatureExtractor> extractor;
+  if (need_feature_ && !model_) {
+    extractor.reset(new FeatureExtractor([this](const CNFrameInfoPtr data, bool valid) {
+      if (!valid) {
+        PostEvent(EventType::EVENT_ERROR, "Extract feature failed");
+        return;
+      }
+      TrackFrame(data);
+    }));
+  }
+
+  while (true) {
+    uint32_t stream_idx;
+    {
+      std::unique_lock<std::mutex> lk(ready_mtx_);
+      ready_cond_.wait(lk, [this] { return !running_ || !ready_.empty(); });
+      if (ready_.empty()) return;
+      stream_idx = ready_.front();
+      ready_.pop_front();
+    }
+
+    TrackerContext *ctx = contexts_[stream_idx].get();
+    CNFrameInfoPtr data;
+    {
+      std::lock_guard<std::mutex> lk(ctx->mtx_);
+      data = ctx->pending_.front();
+      ctx->pending_.pop_front();
+    }
+    if (extractor && !data->IsEos() && data->collection.HasValue(kCNInferObjsTag)) {
+      if (!extractor->ExtractFeature(data)) {
+        LOGE(TRACK) << "Extract Feature failed";
+        PostEvent(EventType::EVENT_ERROR, "Extract feature failed");
+      }
+    } else {
+      TrackFrame(data);
+    }
+
+    {
+      std::lock_guard<std::mutex> lk(ctx->mtx_);
+      if (ctx->pending_.empty()) {
+        ctx->scheduled_ = false;
+        continue;
+      }
+    }
+    // one frame per turn, so that a heavy stream does not hold a worker
+    std::lock_guard<std::mutex> lk(ready_mtx_);
+    ready_.push_back(stream_idx);
+  }
+}
+
+void Tracker::StopWorkers() {
+  {
+    std::lock_guard<std::mutex> lk(ready_mtx_);
+    running_ = false;
+  }
+  ready_cond_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
 bool Tracker::Open(ModuleParamSet param_set) {
   if (false == CheckParamSet(param_set)) {
     return false;
   }
 
+  StopWorkers();
   auto params = param_helper_->GetParams();
 
   if (!params.model_path.empty()) {
@@ -172,46 +378,24 @@ bool Tracker::Open(ModuleParamSet param_set) {
 
   need_feature_ = (params.track_name == "FeatureMatch");
 
-  match_func_ = [this](const CNFrameInfoPtr data, bool valid) {
-    if (!valid) {
-      PostEvent(EventType::EVENT_ERROR, "Extract feature failed");
-      return;
-    }
-    CNInferObjsPtr objs_holder = data->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
+  match_func_ = [this](const CNFrameInfoPtr data, bool valid) { OnFeatureDone(data, valid); };
 
-    std::vector<DetectObject> in, out;
-    std::unique_lock<std::mutex> guard(objs_holder->mutex_);
-    in.reserve(objs_holder->objs_.size());
-
-    // CNDataFramePtr dataframe = data->collection.Get<CNDataFramePtr>(kCNDataFrameTag);
-    for (size_t i = 0; i < objs_holder->objs_.size(); i++) {
-      DetectObject obj;
-      obj.label = std::stoi(objs_holder->objs_[i]->id);
-      obj.score = objs_holder->objs_[i]->score;
-      obj.bbox.x = objs_holder->objs_[i]->bbox.x;
-      obj.bbox.y = objs_holder->objs_[i]->bbox.y;
-      obj.bbox.width = objs_holder->objs_[i]->bbox.w;
-      obj.bbox.height = objs_holder->objs_[i]->bbox.h;
-      obj.feature = objs_holder->objs_[i]->GetFeature("track");
-      in.emplace_back(obj);
-    }
-    GetContext(data)->processer_->UpdateFrame(in, &out);
-    for (size_t i = 0; i < out.size(); i++) {
-      objs_holder->objs_[out[i].detect_id]->track_id = std::to_string(out[i].track_id);
-    }
+  contexts_.clear();
+  for (uint32_t i = 0; i < GetMaxStreamNumber(); ++i) {
+    contexts_.emplace_back(new TrackerContext);
+  }
 
-    guard.unlock();
-    TransmitData(data);
-  };
+  running_ = true;
+  for (uint32_t i = 0; i < params.worker_num; ++i) {
+    workers_.emplace_back(&Tracker::WorkerLoop, this);
+  }
 
   tracker_priority_ = this->GetPriority();
   return true;
 }
 
 void Tracker::Close() {
-  for (auto &pair : contexts_) {
-    delete pair.second;
-  }
+  StopWorkers();
   contexts_.clear();
   g_feature_extractor.reset();
 }
@@ -222,10 +406,15 @@ int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
     return -1;
   }
   if (data->IsEos()) {
-    if (need_feature_) {
+    if (need_feature_ && g_feature_extractor) {
       g_feature_extractor->WaitTaskDone(data->stream_id);
     }
-    TransmitData(data);
+    // transmitted after the frames of the stream
+    if (data->GetStreamIndex() < GetMaxStreamNumber() && !contexts_.empty()) {
+      Bypass(data);
+    } else {
+      TransmitData(data);
+    }
     return 0;
   }
 
@@ -236,7 +425,9 @@ int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
   if (data->GetStreamIndex() >= GetMaxStreamNumber()) {
     return -1;
   }
-  if (need_feature_ && !InitFeatureExtractor(data)) {
+  // features are extracted here on MLU or without workers, otherwise workers extract them on CPU
+  bool extract_here = need_feature_ && (model_ || workers_.empty());
+  if (extract_here && !InitFeatureExtractor(data)) {
     LOGE(TRACK) << "Init Feature Extractor Failed.";
     return -1;
   }
@@ -258,14 +449,21 @@ int Tracker::Process(std::shared_ptr<CNFrameInfo> data) {
     }
   }
 
-  if (need_feature_) {
-    // async extract feature
+  if (extract_here && have_obj) {
+    TrackerContext *ctx = contexts_[data->GetStreamIndex()].get();
+    {
+      std::lock_guard<std::mutex> lk(ctx->extract_mtx_);
+      ctx->extracting_.emplace_back(data, true);
+    }
+    // async extract feature, the frame is dispatched in OnFeatureDone
     if (!g_feature_extractor->ExtractFeature(data)) {
       LOGE(TRACK) << "Extract Feature failed";
+      OnFeatureDone(data, false);
       return -1;
     }
   } else {
-    match_func_(data, true);
+    // frames without objects are not passed to the extractor, they must not overtake frames in it
+    Bypass(data);
   }
 
   return 0;
@@ -288,11 +486,39 @@ bool Tracker::CheckParamSet(const ModuleParamSet& param_set) const {
     ret = false;
   }
 
-  if (params.track_name != "FeatureMatch" && params.track_name != "IoUMatch") {
+  if (params.track_name != "FeatureMatch" && params.track_name != "SORT" && params.track_name != "IoUMatch") {
     LOGE(TRACK) << "Unsupported track type: " << params.track_name;
     ret = false;
   }
 
+  if (params.max_cosine_distance < 0 || params.max_cosine_distance > 2) {
+    LOGE(TRACK) << "[Tracker] [max_cosine_distance] : " << params.max_cosine_distance << " should be in [0, 2].";
+    ret = false;
+  }
+
+  if (params.nn_budget == 0) {
+    LOGE(TRACK) << "[Tracker] [nn_budget] : should be greater than 0.";
+    ret = false;
+  }
+
+  // only FeatureMatch prunes features
+  if (param_set.find("feature_prune_distance") != param_set.end() && params.track_name == "FeatureMatch" &&
+      (params.feature_prune_distance < 0 || params.feature_prune_distance > params.max_cosine_distance)) {
+    LOGE(TRACK) << "[Tracker] [feature_prune_distance] : " << params.feature_prune_distance
+                << " should be in [0, max_cosine_distance].";
+    ret = false;
+  }
+
+  if (params.max_iou_distance < 0 || params.max_iou_distance > 1) {
+    LOGE(TRACK) << "[Tracker] [max_iou_distance] : " << params.max_iou_distance << " should be in [0, 1].";
+    ret = false;
+  }
+
+  if (params.max_age == 0) {
+    LOGE(TRACK) << "[Tracker] [max_age] : should be greater than 0.";
+    ret = false;
+  }
+
   return ret;
 }
 
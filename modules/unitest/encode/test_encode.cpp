@@ -121,6 +121,20 @@ TEST(EncodeModule, OpenFailed) {
   EXPECT_TRUE(module.Open(params));
   module.Close();
 
+  params["view_color"] = "rgba";
+  EXPECT_FALSE(module.Open(params));
+  // hardware encoding does not support i420 canvas
+  params["view_color"] = "i420";
+  EXPECT_FALSE(module.Open(params));
+  params["hw_accel"] = "false";
+  EXPECT_TRUE(module.Open(params));
+  module.Close();
+  params["hw_accel"] = "true";
+  params["view_color"] = "nv21";
+  EXPECT_TRUE(module.Open(params));
+  module.Close();
+  params.erase("view_color");
+
   {
     params["dst_width"] = "121";
     params["dst_height"] = "131";
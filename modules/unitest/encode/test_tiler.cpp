@@ -0,0 +1,164 @@
+/*************************************************************************
+ * Copyright (C) [2022] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "tiler.hpp"
+
+namespace cnstream {
+
+namespace {
+
+// solid NV12 image
+struct Nv12Image {
+  Nv12Image(uint32_t w, uint32_t h, uint8_t y, uint8_t uv) : data(w * h * 3 / 2, uv) {
+    std::fill(data.begin(), data.begin() + w * h, y);
+    buffer.width = w;
+    buffer.height = h;
+    buffer.color = Scaler::ColorFormat::YUV_NV12;
+    buffer.data[0] = data.data();
+    buffer.data[1] = data.data() + w * h;
+    buffer.data[2] = nullptr;
+    buffer.stride[0] = buffer.stride[1] = w;
+    buffer.stride[2] = 0;
+  }
+  std::vector<uint8_t> data;
+  Scaler::Buffer buffer;
+};
+
+uint8_t Y(const Scaler::Buffer *canvas, int x, int y) { return canvas->data[0][y * canvas->stride[0] + x]; }
+uint8_t UV(const Scaler::Buffer *canvas, int x, int y) { return canvas->data[1][y / 2 * canvas->stride[1] + x]; }
+
+}  // namespace
+
+TEST(EncodeTiler, GetCanvas) {
+  // 2x2 grids of 32x16
+  Tiler tiler(2, 2, Scaler::ColorFormat::YUV_NV12, 64, 32);
+  Nv12Image src(32, 16, 200, 60);
+
+  ASSERT_TRUE(tiler.Blit(&src.buffer, 0));
+  Scaler::Buffer *canvas = tiler.GetCanvas();
+  ASSERT_TRUE(canvas);
+  EXPECT_EQ(Y(canvas, 0, 0), 200);
+  EXPECT_EQ(UV(canvas, 0, 0), 60);
+  EXPECT_EQ(Y(canvas, 32, 0), 0);
+  EXPECT_EQ(UV(canvas, 32, 0), 0x80);
+  tiler.ReleaseCanvas();
+
+  // grids updated before are kept in the other canvas
+  ASSERT_TRUE(tiler.Blit(&src.buffer, 3));
+  canvas = tiler.GetCanvas();
+  EXPECT_EQ(Y(canvas, 0, 0), 200);
+  EXPECT_EQ(Y(canvas, 63, 31), 200);
+  EXPECT_EQ(Y(canvas, 0, 16), 0);
+  tiler.ReleaseCanvas();
+
+  // grids blitted while the canvas is locked are kept as well
+  canvas = tiler.GetCanvas();
+  ASSERT_TRUE(tiler.Blit(&src.buffer, 1));
+  EXPECT_EQ(Y(canvas, 32, 0), 0);
+  tiler.ReleaseCanvas();
+  for (int i = 0; i < 2; ++i) {
+    canvas = tiler.GetCanvas();
+    EXPECT_EQ(Y(canvas, 32, 0), 200);
+    EXPECT_EQ(Y(canvas, 0, 0), 200);
+    EXPECT_EQ(Y(canvas, 63, 31), 200);
+    tiler.ReleaseCanvas();
+  }
+
+  // removed streams leave blank grids
+  EXPECT_TRUE(tiler.ClearGrid(0));
+  EXPECT_FALSE(tiler.ClearGrid(4));
+  for (int i = 0; i < 2; ++i) {
+    canvas = tiler.GetCanvas();
+    EXPECT_EQ(Y(canvas, 0, 0), 0);
+    EXPECT_EQ(UV(canvas, 0, 0), 0x80);
+    EXPECT_EQ(Y(canvas, 32, 0), 200);
+    tiler.ReleaseCanvas();
+  }
+}
+
+TEST(EncodeTiler, BlitConcurrently) {
+  Tiler tiler(2, 2, Scaler::ColorFormat::YUV_NV12, 64, 32);
+  std::vector<Nv12Image> srcs;
+  for (int i = 0; i < 4; ++i) srcs.emplace_back(32, 16, 50 * (i + 1), 60);
+
+  // more threads than grids, each grid is blitted by several threads
+  std::vector<std::thread> threads;
+  std::vector<int> results(32, 0);
+  for (int i = 0; i < 32; ++i) {
+    threads.emplace_back([&, i] {
+      for (int n = 0; n < 10; ++n) results[i] += tiler.Blit(&srcs[i % 4].buffer, i % 4);
+    });
+  }
+  for (int n = 0; n < 10; ++n) {
+    tiler.GetCanvas();
+    tiler.ReleaseCanvas();
+  }
+  for (auto &thread : threads) thread.join();
+  for (int result : results) EXPECT_EQ(result, 10);
+
+  Scaler::Buffer *canvas = tiler.GetCanvas();
+  EXPECT_EQ(Y(canvas, 0, 0), 50);
+  EXPECT_EQ(Y(canvas, 32, 0), 100);
+  EXPECT_EQ(Y(canvas, 0, 16), 150);
+  EXPECT_EQ(Y(canvas, 63, 31), 200);
+  tiler.ReleaseCanvas();
+}
+
+TEST(EncodeTiler, TimerKeepsOwnCadence) {
+  Tiler tiler_a(2, 2, Scaler::ColorFormat::YUV_NV12, 64, 32);
+  Tiler tiler_b(2, 2, Scaler::ColorFormat::YUV_NV12, 64, 32);
+  Nv12Image src(32, 16, 100, 60);
+  ASSERT_TRUE(tiler_a.Blit(&src.buffer, 0));
+
+  std::atomic<int> sent_a{0}, sent_b{0};
+  std::atomic<int> last_y{0};
+  TilerTimer timer_a(&tiler_a, 50, [&](Scaler::Buffer *canvas) {
+    last_y = Y(canvas, 0, 0);
+    ++sent_a;
+  });
+  TilerTimer timer_b(&tiler_b, 10, [&](Scaler::Buffer *canvas) { ++sent_b; });
+  auto start = std::chrono::steady_clock::now();
+  timer_a.Start();
+  timer_b.Start();
+  // no frame arrives, each timer sends the canvas at its own frame rate
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  timer_a.Stop();
+  timer_b.Stop();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  EXPECT_NEAR(sent_a, elapsed * 50, elapsed * 50 * 0.2 + 1);
+  EXPECT_NEAR(sent_b, elapsed * 10, elapsed * 10 * 0.2 + 1);
+  EXPECT_EQ(last_y, 100);
+
+  // nothing is sent after stopping
+  int stopped_a = sent_a, stopped_b = sent_b;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(sent_a, stopped_a);
+  EXPECT_EQ(sent_b, stopped_b);
+}
+
+}  // namespace cnstream
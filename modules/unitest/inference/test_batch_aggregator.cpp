@@ -0,0 +1,155 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "batch_aggregator.hpp"
+
+namespace cnstream {
+
+using Aggregator = BatchAggregator<int>;
+
+static bool PushOne(Aggregator *aggregator, int value, const void *group = nullptr) {
+  std::vector<int> values = {value};
+  return aggregator->Push(&values, group);
+}
+
+TEST(BatchAggregator, FixedTimeout) {
+  Aggregator::Options options;
+  options.batch_size = 4;
+  options.timeout_ms = 20;
+  Aggregator aggregator(options);
+  std::vector<int> values = {0, 1, 2, 3, 4, 5};
+  ASSERT_TRUE(aggregator.Push(&values, nullptr));
+
+  std::vector<int> batch;
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({0, 1, 2, 3}));
+  // the partial batch is flushed after the timeout
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({4, 5}));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(15));
+  EXPECT_EQ(aggregator.BatchCount(), 2u);
+  EXPECT_EQ(aggregator.ItemCount(), 6u);
+}
+
+TEST(BatchAggregator, StaticNeverMerges) {
+  Aggregator::Options options;
+  options.batch_size = 4;
+  options.merge = false;
+  Aggregator aggregator(options);
+  int group_a, group_b;
+  std::vector<int> values = {0, 1};
+  ASSERT_TRUE(aggregator.Push(&values, &group_a));
+  values = {2, 3, 4, 5, 6};
+  ASSERT_TRUE(aggregator.Push(&values, &group_b));
+
+  std::vector<int> batch;
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({0, 1}));
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({2, 3, 4, 5}));
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({6}));
+}
+
+TEST(BatchAggregator, AdaptiveLowLoadFlushesAtOnce) {
+  Aggregator::Options options;
+  options.batch_size = 8;
+  options.timeout_ms = 1000;
+  options.latency_budget_ms = 100;
+  Aggregator aggregator(options);
+  std::vector<int> batch;
+  ASSERT_TRUE(PushOne(&aggregator, 0));
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  // the next input is not expected before the deadline
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  ASSERT_TRUE(PushOne(&aggregator, 1));
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({1}));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST(BatchAggregator, AdaptiveGroupIsOneArrival) {
+  Aggregator::Options options;
+  options.batch_size = 8;
+  options.timeout_ms = 1000;
+  options.latency_budget_ms = 100;
+  Aggregator aggregator(options);
+  std::vector<int> batch;
+  std::vector<int> values = {0, 1, 2, 3, 4, 5, 6};
+  ASSERT_TRUE(aggregator.Push(&values, nullptr));
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch.size(), 7u);
+  // inputs of a group do not shrink the arrival interval, the partial batch is not held until the deadline
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  values = {7, 8, 9, 10, 11, 12, 13};
+  ASSERT_TRUE(aggregator.Push(&values, nullptr));
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(aggregator.Pop(&batch));
+  EXPECT_EQ(batch, std::vector<int>({7, 8, 9, 10, 11, 12, 13}));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST(BatchAggregator, AdaptiveHighLoadFillsBatches) {
+  Aggregator::Options options;
+  options.batch_size = 8;
+  options.latency_budget_ms = 200;
+  Aggregator aggregator(options);
+  const int item_num = 64;
+  std::thread producer([&] {
+    for (int i = 0; i < item_num; ++i) {
+      PushOne(&aggregator, i);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  std::vector<int> batch;
+  int received = 0;
+  while (received < item_num && aggregator.Pop(&batch)) {
+    for (int value : batch) EXPECT_EQ(value, received++);
+  }
+  producer.join();
+  EXPECT_EQ(received, item_num);
+  // most batches are full, only the first ones are flushed before the arrival rate is known
+  EXPECT_LE(aggregator.BatchCount(), 16u);
+}
+
+TEST(BatchAggregator, Close) {
+  Aggregator::Options options;
+  options.batch_size = 4;
+  options.timeout_ms = 10000;
+  Aggregator aggregator(options);
+  ASSERT_TRUE(PushOne(&aggregator, 0));
+  std::thread closer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    aggregator.Close();
+  });
+  std::vector<int> batch;
+  EXPECT_FALSE(aggregator.Pop(&batch));
+  closer.join();
+  EXPECT_FALSE(PushOne(&aggregator, 1));
+}
+
+}  // namespace cnstream
@@ -0,0 +1,116 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "cnstream_frame_va.hpp"
+#include "infer_cache.hpp"
+
+namespace cnstream {
+
+static std::shared_ptr<CNInferObject> CreateObject(const std::string &track_id, float x = 0.1f) {
+  auto obj = std::make_shared<CNInferObject>();
+  obj->id = "0";
+  obj->track_id = track_id;
+  obj->score = 0.9f;
+  obj->bbox = CnInferBbox(x, 0.1f, 0.2f, 0.2f);
+  return obj;
+}
+
+// adds results to the object as a classifier does
+static void Classify(CNInferObject *obj, float score) {
+  CNInferAttr attr;
+  attr.id = 0;
+  attr.value = 3;
+  attr.score = score;
+  obj->AddAttribute("color", attr);
+  obj->AddFeature("embedding", CNInferFeature(4, 1.f));
+}
+
+static InferCache::Options CreateOptions(uint32_t ttl, float refresh_score = 0.f, float min_iou = 0.f) {
+  InferCache::Options options;
+  options.ttl = ttl;
+  options.refresh_score = refresh_score;
+  options.min_iou = min_iou;
+  return options;
+}
+
+TEST(InferCache, ApplyCachedResults) {
+  InferCache cache(CreateOptions(5));
+  auto obj = CreateObject("1");
+  EXPECT_FALSE(cache.Apply(obj.get(), 0));
+  // results added by former modules are not cached
+  obj->AddExtraAttribute("plate", "A12345");
+  auto keys = InferCache::GetKeys(obj.get());
+  Classify(obj.get(), 0.8f);
+  cache.Update(obj.get(), keys, 0);
+
+  auto next = CreateObject("1");
+  EXPECT_TRUE(cache.Apply(next.get(), 3));
+  EXPECT_EQ(next->GetAttribute("color").value, 3);
+  EXPECT_EQ(next->GetFeature("embedding").size(), 4u);
+  EXPECT_TRUE(next->GetExtraAttribute("plate").empty());
+
+  // another track
+  auto other = CreateObject("2");
+  EXPECT_FALSE(cache.Apply(other.get(), 3));
+  // no track id
+  auto untracked = CreateObject("");
+  EXPECT_FALSE(cache.Apply(untracked.get(), 3));
+  EXPECT_EQ(cache.HitCount(), 1u);
+  EXPECT_EQ(cache.LookupCount(), 3u);
+}
+
+TEST(InferCache, Ttl) {
+  InferCache cache(CreateOptions(5));
+  auto obj = CreateObject("1");
+  auto keys = InferCache::GetKeys(obj.get());
+  Classify(obj.get(), 0.8f);
+  cache.Update(obj.get(), keys, 10);
+  EXPECT_TRUE(cache.Apply(CreateObject("1").get(), 15));
+  EXPECT_FALSE(cache.Apply(CreateObject("1").get(), 16));
+
+  cache.Update(obj.get(), keys, 20);
+  cache.Purge(26);
+  EXPECT_FALSE(cache.Apply(CreateObject("1").get(), 21));
+}
+
+TEST(InferCache, RefreshLowScore) {
+  InferCache cache(CreateOptions(5, 0.5f));
+  auto obj = CreateObject("1");
+  auto keys = InferCache::GetKeys(obj.get());
+  Classify(obj.get(), 0.3f);
+  cache.Update(obj.get(), keys, 0);
+  EXPECT_FALSE(cache.Apply(CreateObject("1").get(), 1));
+}
+
+TEST(InferCache, InvalidateMovedBbox) {
+  InferCache cache(CreateOptions(5, 0.f, 0.5f));
+  auto obj = CreateObject("1", 0.1f);
+  auto keys = InferCache::GetKeys(obj.get());
+  Classify(obj.get(), 0.8f);
+  cache.Update(obj.get(), keys, 0);
+  EXPECT_TRUE(cache.Apply(CreateObject("1", 0.12f).get(), 1));
+  EXPECT_FALSE(cache.Apply(CreateObject("1", 0.25f).get(), 2));
+}
+
+}  // namespace cnstream
@@ -63,6 +63,16 @@ TEST(Inferencer, CheckParamSet) {
   param["batch_timeout"] = "100";
   EXPECT_TRUE(infer->CheckParamSet(param));
 
+  param["motion_threshold"] = "1.5";  // motion threshold is a ratio
+  EXPECT_FALSE(infer->CheckParamSet(param));
+  param["motion_threshold"] = "0.02";
+  EXPECT_TRUE(infer->CheckParamSet(param));
+
+  param["cache_iou"] = "-0.5";  // cache iou is a ratio
+  EXPECT_FALSE(infer->CheckParamSet(param));
+  param["cache_iou"] = "0.5";
+  EXPECT_TRUE(infer->CheckParamSet(param));
+
   // batch strategy must be one of them
   std::list<std::string> batch_strategy = {"static", "STATIC", "dynamic", "DYNAMIC"};
   param["batch_strategy"] = "error_type";
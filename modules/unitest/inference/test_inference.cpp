@@ -20,7 +20,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -38,6 +42,7 @@
 #include "test_base.hpp"
 
 static constexpr const char *glabel_path = "../../modules/unitest/data/test_empty_label.txt";
+static constexpr const char *gcpu_model_path = "../../modules/unitest/data/cpu_mock_model.json";
 
 namespace cnstream {
 
@@ -55,6 +60,27 @@ class FakeVideoPostproc : public cnstream::Postproc {
 
 IMPLEMENT_REFLEX_OBJECT_EX(FakeVideoPostproc, cnstream::Postproc);
 
+static std::atomic<size_t> g_counted_frames{0};
+static std::atomic<size_t> g_max_batch{0};
+
+class CountingPostproc : public cnstream::Postproc {
+ public:
+  int Execute(const cnstream::NetOutputs& net_outputs, const infer_server::ModelInfo& model_info,
+              const std::vector<cnstream::CNFrameInfoPtr>& packages,
+              const cnstream::LabelStrings& labels) override {
+    g_counted_frames += packages.size();
+    size_t max_batch = g_max_batch;
+    while (packages.size() > max_batch && !g_max_batch.compare_exchange_weak(max_batch, packages.size())) {
+    }
+    return 0;
+  }
+
+ private:
+  DECLARE_REFLEX_OBJECT_EX(CountingPostproc, cnstream::Postproc);
+};  // class CountingPostproc
+
+IMPLEMENT_REFLEX_OBJECT_EX(CountingPostproc, cnstream::Postproc);
+
 class FakeVideoPreproc : public cnstream::Preproc {
  public:
   int Execute(cnedk::BufSurfWrapperPtr src, cnedk::BufSurfWrapperPtr dst,
@@ -72,6 +98,26 @@ class FakeVideoPreproc : public cnstream::Preproc {
 
 IMPLEMENT_REFLEX_OBJECT_EX(FakeVideoPreproc, cnstream::Preproc);
 
+static std::atomic<size_t> g_preproc_calls{0};
+
+// fails every other input
+class FailingPreproc : public cnstream::Preproc {
+ public:
+  int Execute(cnedk::BufSurfWrapperPtr src, cnedk::BufSurfWrapperPtr dst,
+              const std::vector<CnedkTransformRect> &src_rects) override {
+    return g_preproc_calls++ % 2 ? -1 : 0;
+  }
+
+  int OnTensorParams(const infer_server::CnPreprocTensorParams *params) override {
+    return 0;
+  }
+
+ private:
+  DECLARE_REFLEX_OBJECT_EX(FailingPreproc, cnstream::Preproc);
+};  // class FailingPreproc
+
+IMPLEMENT_REFLEX_OBJECT_EX(FailingPreproc, cnstream::Preproc);
+
 
 class FakeVideoFilter : public cnstream::ObjectFilterVideoCategory {
  public:
@@ -335,4 +381,135 @@ TEST(Inferencer, Process) {
   EXPECT_NO_THROW(infer->Close());
 }
 
+// frames in host memory, the cpu backend needs no device
+static cnstream::CNFrameInfoPtr CreateCpuData(const std::string& stream_id, bool is_eos = false,
+                                              uint32_t stream_index = 0) {
+  auto data = cnstream::CNFrameInfo::Create(stream_id, is_eos);
+  data->SetStreamIndex(stream_index);
+  if (!is_eos) {
+    data->collection.Add(kCNDataFrameTag, std::make_shared<CNDataFrame>());
+    data->collection.Add(kCNInferObjsTag, std::make_shared<CNInferObjs>());
+  }
+  return data;
+}
+
+// records the frames transmitted by the module of each stream
+class FrameOrderObserver : public IModuleObserver {
+ public:
+  void Notify(std::shared_ptr<CNFrameInfo> data) override {
+    if (data->IsEos()) return;
+    std::lock_guard<std::mutex> lk(mtx_);
+    frames_[data->stream_id].push_back(data.get());
+  }
+  std::vector<CNFrameInfo*> Frames(const std::string& stream_id) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return frames_[stream_id];
+  }
+  void Clear() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    frames_.clear();
+  }
+
+ private:
+  std::mutex mtx_;
+  std::map<std::string, std::vector<CNFrameInfo*>> frames_;
+};
+
+TEST(Inferencer, ProcessCpuBackend) {
+  std::string infer_name = "detector";
+  std::unique_ptr<Inferencer> infer(new Inferencer(infer_name));
+  ModuleParamSet param;
+  param["backend"] = "cpu";
+  param["model_path"] = GetExePath() + gcpu_model_path;
+  param["preproc"] = "name=FakeVideoPreproc";
+  param["postproc"] = "name=CountingPostproc";
+  param["device_id"] = "0";
+  param["engine_num"] = "2";
+  param["batch_timeout"] = "50";
+  const size_t frame_num = 10;
+
+  {  // dynamic, frames of both streams are merged into batches of the model batch size
+    param["batch_strategy"] = "dynamic";
+    ASSERT_TRUE(infer->Open(param));
+    FrameOrderObserver observer;
+    infer->SetObserver(&observer);
+    g_counted_frames = 0;
+    g_max_batch = 0;
+    const std::string stream_ids[2] = {"cpu_stream_0", "cpu_stream_1"};
+    std::vector<CNFrameInfoPtr> sent[2];
+    for (size_t i = 0; i < frame_num; ++i) {
+      for (uint32_t s = 0; s < 2; ++s) {
+        auto data = CreateCpuData(stream_ids[s], false, s);
+        sent[s].push_back(data);
+        EXPECT_EQ(infer->Process(data), 0);
+      }
+    }
+    for (uint32_t s = 0; s < 2; ++s) {
+      EXPECT_EQ(infer->Process(CreateCpuData(stream_ids[s], true, s)), 0);
+    }
+    EXPECT_EQ(g_counted_frames, 2 * frame_num);
+    EXPECT_GT(g_max_batch, 1u);
+    EXPECT_LE(g_max_batch, 4u);
+    // frames of each stream are responded in the order of requests
+    for (uint32_t s = 0; s < 2; ++s) {
+      auto received = observer.Frames(stream_ids[s]);
+      ASSERT_EQ(received.size(), frame_num);
+      for (size_t i = 0; i < frame_num; ++i) EXPECT_EQ(received[i], sent[s][i].get());
+    }
+    infer->SetObserver(nullptr);
+    infer->Close();
+  }
+
+  {  // static, frames of different requests are never merged
+    param["batch_strategy"] = "static";
+    ASSERT_TRUE(infer->Open(param));
+    g_counted_frames = 0;
+    g_max_batch = 0;
+    for (size_t i = 0; i < frame_num; ++i) {
+      EXPECT_EQ(infer->Process(CreateCpuData("cpu_stream")), 0);
+    }
+    EXPECT_EQ(infer->Process(CreateCpuData("cpu_stream", true)), 0);
+    EXPECT_EQ(g_counted_frames, frame_num);
+    EXPECT_EQ(g_max_batch, 1u);
+    infer->Close();
+  }
+
+  {  // interval, skipped frames are not inferred
+    param["interval"] = "2";
+    ASSERT_TRUE(infer->Open(param));
+    g_counted_frames = 0;
+    for (size_t i = 0; i < frame_num; ++i) {
+      EXPECT_EQ(infer->Process(CreateCpuData("cpu_stream")), 0);
+    }
+    EXPECT_EQ(infer->Process(CreateCpuData("cpu_stream", true)), 0);
+    EXPECT_EQ(g_counted_frames, frame_num / 2);
+    infer->Close();
+  }
+
+  {  // failed inputs are not postprocessed, but their frames are still transmitted
+    param["interval"] = "1";
+    param["preproc"] = "name=FailingPreproc";
+    ASSERT_TRUE(infer->Open(param));
+    FrameOrderObserver observer;
+    infer->SetObserver(&observer);
+    g_counted_frames = 0;
+    g_preproc_calls = 0;
+    for (size_t i = 0; i < frame_num; ++i) {
+      EXPECT_EQ(infer->Process(CreateCpuData("cpu_stream")), 0);
+    }
+    EXPECT_EQ(infer->Process(CreateCpuData("cpu_stream", true)), 0);
+    EXPECT_EQ(g_preproc_calls, frame_num);
+    EXPECT_EQ(g_counted_frames, frame_num / 2);
+    EXPECT_EQ(observer.Frames("cpu_stream").size(), frame_num);
+    infer->SetObserver(nullptr);
+    infer->Close();
+    param["preproc"] = "name=FakeVideoPreproc";
+  }
+
+  {  // unknown backend
+    param["backend"] = "no_such_backend";
+    EXPECT_FALSE(infer->Open(param));
+  }
+}
+
 }  // namespace cnstream
@@ -0,0 +1,94 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "motion_detector.hpp"
+
+namespace cnstream {
+
+static const int kWidth = 640;
+static const int kHeight = 360;
+static const int kStride = 704;
+
+static std::vector<uint8_t> CreateLuma(uint8_t value) { return std::vector<uint8_t>(kStride * kHeight, value); }
+
+static void FillRect(std::vector<uint8_t> *luma, int x, int y, int w, int h, uint8_t value) {
+  for (int r = y; r < y + h; ++r) {
+    for (int c = x; c < x + w; ++c) (*luma)[r * kStride + c] = value;
+  }
+}
+
+TEST(MotionDetector, Downscale) {
+  auto luma = CreateLuma(100);
+  FillRect(&luma, 0, 0, kWidth / 2, kHeight, 200);
+  std::vector<uint8_t> grid;
+  MotionDetector::Downscale(luma.data(), kStride, kWidth, kHeight, &grid);
+  ASSERT_EQ(grid.size(), static_cast<size_t>(MotionDetector::kGridWidth * MotionDetector::kGridHeight));
+  EXPECT_EQ(grid[0], 200);
+  EXPECT_EQ(grid[MotionDetector::kGridWidth - 1], 100);
+  EXPECT_FLOAT_EQ(MotionDetector::ChangedRatio(grid, grid), 0.f);
+}
+
+TEST(MotionDetector, SkipStaticFrames) {
+  MotionDetector detector(0.01f, 0);
+  auto luma = CreateLuma(80);
+  EXPECT_TRUE(detector.Check(luma.data(), kStride, kWidth, kHeight));  // the first frame
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_FALSE(detector.Check(luma.data(), kStride, kWidth, kHeight));
+  }
+  // small noise is ignored
+  FillRect(&luma, 100, 100, 50, 50, 85);
+  EXPECT_FALSE(detector.Check(luma.data(), kStride, kWidth, kHeight));
+  // an object enters
+  FillRect(&luma, 100, 100, 80, 80, 200);
+  EXPECT_TRUE(detector.Check(luma.data(), kStride, kWidth, kHeight));
+  // compared with the last inferred frame
+  EXPECT_FALSE(detector.Check(luma.data(), kStride, kWidth, kHeight));
+  // resolution changed
+  EXPECT_TRUE(detector.Check(luma.data(), kStride, kWidth / 2, kHeight / 2));
+  EXPECT_EQ(detector.CheckedCount(), 15u);
+  EXPECT_EQ(detector.SkippedCount(), 12u);
+}
+
+TEST(MotionDetector, MaxSkip) {
+  MotionDetector detector(0.01f, 3);
+  auto luma = CreateLuma(80);
+  for (int round = 0; round < 3; ++round) {
+    EXPECT_TRUE(detector.Check(luma.data(), kStride, kWidth, kHeight));
+    for (int i = 0; i < 3; ++i) EXPECT_FALSE(detector.Check(luma.data(), kStride, kWidth, kHeight));
+  }
+}
+
+TEST(MotionDetector, Sensitivity) {
+  auto luma = CreateLuma(80);
+  auto changed = luma;
+  FillRect(&changed, 0, 0, kWidth / 4, kHeight / 4, 160);  // about 1/16 of the frame
+  MotionDetector sensitive(0.01f, 0);
+  MotionDetector insensitive(0.2f, 0);
+  sensitive.Check(luma.data(), kStride, kWidth, kHeight);
+  insensitive.Check(luma.data(), kStride, kWidth, kHeight);
+  EXPECT_TRUE(sensitive.Check(changed.data(), kStride, kWidth, kHeight));
+  EXPECT_FALSE(insensitive.Check(changed.data(), kStride, kWidth, kHeight));
+}
+
+}  // namespace cnstream
@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "postprocess_common.hpp"
+
+namespace cnstream {
+
+TEST(PostprocCommon, FilterByScore) {
+  // 7 floats per row with the score at 2, the same layout as the yolo outputs
+  const int stride = 7, num = 9;
+  std::vector<float> data(num * stride, 0);
+  const float scores[num] = {0.1, 0.5, 0.49, 0.9, 0.5, 0, 0.7, 0.2, 0.6};
+  for (int i = 0; i < num; ++i) data[i * stride + 2] = scores[i];
+
+  std::vector<int> indices = {42};
+  FilterByScore(data.data(), num, stride, 2, 0.5, &indices);
+  EXPECT_EQ(indices, std::vector<int>({1, 3, 4, 6, 8}));
+
+  FilterByScore(data.data(), num, stride, 2, 0, &indices);
+  EXPECT_EQ(indices.size(), static_cast<size_t>(num));
+  EXPECT_EQ(indices[5], 5);
+
+  FilterByScore(data.data(), num, stride, 2, 0.95, &indices);
+  EXPECT_TRUE(indices.empty());
+  FilterByScore(data.data(), 0, stride, 2, 0.5, &indices);
+  EXPECT_TRUE(indices.empty());
+}
+
+TEST(PostprocCommon, SelectTopK) {
+  std::vector<DetectionBox> boxes;
+  const float scores[] = {0.3, 0.9, 0.1, 0.7, 0.5};
+  for (int i = 0; i < 5; ++i) boxes.push_back({0, 0, 1, 1, scores[i], i});
+
+  std::vector<DetectionBox> top = boxes;
+  SelectTopK(&top, 3);
+  ASSERT_EQ(top.size(), 3u);
+  EXPECT_EQ(top[0].label, 1);
+  EXPECT_EQ(top[1].label, 3);
+  EXPECT_EQ(top[2].label, 4);
+
+  // all boxes are sorted if k is 0 or not less than the number of boxes
+  std::vector<DetectionBox> all = boxes;
+  SelectTopK(&all, 0);
+  ASSERT_EQ(all.size(), 5u);
+  for (size_t i = 1; i < all.size(); ++i) EXPECT_GE(all[i - 1].score, all[i].score);
+  all = boxes;
+  SelectTopK(&all, 10);
+  ASSERT_EQ(all.size(), 5u);
+  EXPECT_EQ(all[4].label, 2);
+}
+
+TEST(PostprocCommon, NmsByClass) {
+  std::vector<DetectionBox> boxes = {
+      {0.1, 0.1, 0.5, 0.5, 0.6, 0},    // suppressed by the next one
+      {0.12, 0.1, 0.52, 0.5, 0.9, 0},
+      {0.1, 0.1, 0.5, 0.5, 0.8, 1},    // another label
+      {0.6, 0.6, 0.9, 0.9, 0.7, 0},    // no overlap
+      {0.3, 0.1, 0.7, 0.5, 0.5, 0},    // IoU 0.38 with the best one
+  };
+  std::vector<DetectionBox> result = boxes;
+  NmsByClass(&result, 0.5);
+  ASSERT_EQ(result.size(), 4u);
+  EXPECT_FLOAT_EQ(result[0].score, 0.9);
+  EXPECT_FLOAT_EQ(result[1].score, 0.8);
+  EXPECT_FLOAT_EQ(result[2].score, 0.7);
+  EXPECT_FLOAT_EQ(result[3].score, 0.5);
+
+  result = boxes;
+  NmsByClass(&result, 0.3);
+  ASSERT_EQ(result.size(), 3u);
+  EXPECT_FLOAT_EQ(result[2].score, 0.7);
+
+  result.clear();
+  NmsByClass(&result, 0.5);
+  EXPECT_TRUE(result.empty());
+}
+
+TEST(PostprocCommon, LabelIdString) {
+  EXPECT_EQ(LabelIdString(0), "0");
+  EXPECT_EQ(LabelIdString(79), "79");
+  EXPECT_EQ(LabelIdString(1023), "1023");
+  EXPECT_EQ(LabelIdString(100000), "100000");
+  EXPECT_EQ(LabelIdString(-1), "-1");
+  // small ids are cached
+  EXPECT_EQ(&LabelIdString(5), &LabelIdString(5));
+}
+
+}  // namespace cnstream
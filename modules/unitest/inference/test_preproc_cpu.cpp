@@ -0,0 +1,208 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cnstream_preproc.hpp"
+
+namespace cnstream {
+
+// pixel numbers cover the vectorized body and the scalar tail
+static const uint32_t kTestPixels[] = {1, 7, 16, 33, 1001};
+
+// runs the test with each instruction set supported, and restores the default one after
+template <typename Func>
+static void ForEachIsa(Func func) {
+  PreprocIsa saved = GetPreprocIsa();
+  for (PreprocIsa isa : {PreprocIsa::SCALAR, PreprocIsa::SSE41, PreprocIsa::AVX2, PreprocIsa::NEON}) {
+    if (!SetPreprocIsa(isa)) continue;
+    ASSERT_EQ(GetPreprocIsa(), isa);
+    SCOPED_TRACE("isa " + std::to_string(static_cast<int>(isa)));
+    func();
+  }
+  SetPreprocIsa(saved);
+}
+
+TEST(PreprocCpu, SetPreprocIsa) {
+  PreprocIsa saved = GetPreprocIsa();
+  // the scalar kernels are always available
+  EXPECT_TRUE(SetPreprocIsa(PreprocIsa::SCALAR));
+  EXPECT_EQ(GetPreprocIsa(), PreprocIsa::SCALAR);
+  EXPECT_TRUE(SetPreprocIsa(saved));
+}
+
+TEST(PreprocCpu, NormalizeToFloat) {
+  const float mean[4] = {123.675f, 116.28f, 103.53f, 10.f};
+  const float std[4] = {58.395f, 57.12f, 57.375f, 2.f};
+  for (uint32_t channels = 1; channels <= 4; ++channels) {
+    for (uint32_t pixels : kTestPixels) {
+      std::vector<uint8_t> src(pixels * channels);
+      for (auto &v : src) v = rand() % 256;
+      std::vector<float> scalar_hwc(src.size()), scalar_chw(src.size());
+      PreprocIsa saved = GetPreprocIsa();
+      ASSERT_TRUE(SetPreprocIsa(PreprocIsa::SCALAR));
+      NormalizeToFloat(src.data(), scalar_hwc.data(), pixels, channels, mean, std, false);
+      NormalizeToFloat(src.data(), scalar_chw.data(), pixels, channels, mean, std, true);
+      SetPreprocIsa(saved);
+      for (uint32_t i = 0; i < pixels; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+          float expected = (src[i * channels + c] - mean[c]) / std[c];
+          EXPECT_NEAR(expected, scalar_hwc[i * channels + c], 1e-4);
+          EXPECT_NEAR(expected, scalar_chw[c * pixels + i], 1e-4);
+        }
+      }
+      // the vectorized kernels match the scalar one
+      ForEachIsa([&] {
+        std::vector<float> hwc(src.size()), chw(src.size());
+        NormalizeToFloat(src.data(), hwc.data(), pixels, channels, mean, std, false);
+        NormalizeToFloat(src.data(), chw.data(), pixels, channels, mean, std, true);
+        for (size_t i = 0; i < src.size(); ++i) {
+          EXPECT_FLOAT_EQ(scalar_hwc[i], hwc[i]) << "channels " << channels << " pixels " << pixels;
+          EXPECT_FLOAT_EQ(scalar_chw[i], chw[i]) << "channels " << channels << " pixels " << pixels;
+        }
+      });
+    }
+  }
+  // mean and std are optional
+  std::vector<uint8_t> src = {0, 1, 2, 255};
+  ForEachIsa([&] {
+    std::vector<float> dst(src.size());
+    NormalizeToFloat(src.data(), dst.data(), src.size(), 1, nullptr, nullptr);
+    for (size_t i = 0; i < src.size(); ++i) EXPECT_FLOAT_EQ(static_cast<float>(src[i]), dst[i]);
+  });
+}
+
+TEST(PreprocCpu, HWCToCHW) {
+  for (uint32_t channels = 1; channels <= 4; ++channels) {
+    for (uint32_t pixels : kTestPixels) {
+      std::vector<uint8_t> src(pixels * channels);
+      for (auto &v : src) v = rand() % 256;
+      ForEachIsa([&] {
+        std::vector<uint8_t> dst(pixels * channels);
+        HWCToCHW(src.data(), dst.data(), pixels, channels);
+        for (uint32_t i = 0; i < pixels; ++i) {
+          for (uint32_t c = 0; c < channels; ++c) {
+            EXPECT_EQ(src[i * channels + c], dst[c * pixels + i]);
+          }
+        }
+      });
+    }
+  }
+}
+
+// the HWC tensor as PreprocessCpu made it before YUV420spToTensor, swscale followed by a scalar normalization
+static void ReferenceTensor(uint8_t *src_y, uint8_t *src_uv, int src_w, int src_h, int src_stride,
+                            CnedkBufSurfaceColorFormat src_fmt, const CnPreprocNetworkInfo &info,
+                            CnedkBufSurfaceColorFormat dst_fmt, bool keep_aspect_ratio, int pad_value,
+                            const float *mean, const float *std, std::vector<uint8_t> *u8, std::vector<float> *fp32) {
+  u8->assign(info.w * info.h * info.c, pad_value);
+  CnedkTransformRect dst_bbox;
+  uint8_t *roi = u8->data();
+  if (keep_aspect_ratio) {
+    dst_bbox = KeepAspectRatio(src_w, src_h, info.w, info.h);
+    dst_bbox.left -= dst_bbox.left & 1;
+    dst_bbox.top -= dst_bbox.top & 1;
+    dst_bbox.width -= dst_bbox.width & 1;
+    dst_bbox.height -= dst_bbox.height & 1;
+    while (dst_bbox.left + dst_bbox.width > info.w) dst_bbox.width -= 2;
+    while (dst_bbox.top + dst_bbox.height > info.h) dst_bbox.height -= 2;
+    roi += dst_bbox.left * info.c + dst_bbox.top * info.w * info.c;
+  } else {
+    dst_bbox.left = 0;
+    dst_bbox.top = 0;
+    dst_bbox.width = info.w;
+    dst_bbox.height = info.h;
+  }
+  YUV420spToRGBx(src_y, src_uv, src_w, src_h, src_stride, src_stride, src_fmt, roi, dst_bbox.width, dst_bbox.height,
+                 info.w * info.c, dst_fmt);
+  fp32->resize(u8->size());
+  for (size_t i = 0; i < u8->size(); ++i) {
+    uint32_t c = i % info.c;
+    (*fp32)[i] = mean ? ((*u8)[i] - mean[c]) / std[c] : static_cast<float>((*u8)[i]);
+  }
+}
+
+template <typename T>
+static std::vector<T> ToCHW(const std::vector<T> &hwc, uint32_t pixels, uint32_t channels) {
+  std::vector<T> chw(hwc.size());
+  for (uint32_t i = 0; i < pixels; ++i) {
+    for (uint32_t c = 0; c < channels; ++c) chw[c * pixels + i] = hwc[i * channels + c];
+  }
+  return chw;
+}
+
+TEST(PreprocCpu, YUV420spToTensor) {
+  // the source is not as wide as its stride, and its aspect ratio differs from the tensor
+  const int src_w = 70, src_h = 46, stride = 80;
+  std::vector<uint8_t> yuv(stride * src_h * 3 / 2);
+  for (auto &v : yuv) v = rand() % 256;
+  uint8_t *src_y = yuv.data();
+  uint8_t *src_uv = src_y + stride * src_h;
+  CnPreprocNetworkInfo info;
+  memset(&info, 0, sizeof(info));
+  info.n = 1;
+  info.h = 36;
+  info.w = 44;
+  info.c = 3;
+  const uint32_t pixels = info.w * info.h;
+  const float mean[3] = {123.675f, 116.28f, 103.53f};
+  const float std[3] = {58.395f, 57.12f, 57.375f};
+
+  for (int i = 0; i < 8; ++i) {
+    CnedkBufSurfaceColorFormat src_fmt = i & 1 ? CNEDK_BUF_COLOR_FORMAT_NV21 : CNEDK_BUF_COLOR_FORMAT_NV12;
+    CnedkBufSurfaceColorFormat dst_fmt = i & 2 ? CNEDK_BUF_COLOR_FORMAT_BGR : CNEDK_BUF_COLOR_FORMAT_RGB;
+    bool keep_aspect_ratio = i & 4;
+    const float *norm_mean = i & 2 ? mean : nullptr;
+    const float *norm_std = i & 2 ? std : nullptr;
+    std::vector<uint8_t> ref_u8;
+    std::vector<float> ref_fp32;
+    ReferenceTensor(src_y, src_uv, src_w, src_h, stride, src_fmt, info, dst_fmt, keep_aspect_ratio, 114, norm_mean,
+                    norm_std, &ref_u8, &ref_fp32);
+    SCOPED_TRACE("case " + std::to_string(i));
+    ForEachIsa([&] {
+      for (bool chw : {false, true}) {
+        info.dtype = infer_server::DataType::UINT8;
+        std::vector<uint8_t> u8(pixels * info.c, 0);
+        ASSERT_EQ(YUV420spToTensor(src_y, src_uv, src_w, src_h, stride, stride, src_fmt, info, dst_fmt,
+                                   keep_aspect_ratio, 114, nullptr, nullptr, chw, u8.data()), 0);
+        EXPECT_EQ(u8, chw ? ToCHW(ref_u8, pixels, info.c) : ref_u8) << "chw " << chw;
+
+        info.dtype = infer_server::DataType::FLOAT32;
+        std::vector<float> fp32(pixels * info.c, 0.f);
+        ASSERT_EQ(YUV420spToTensor(src_y, src_uv, src_w, src_h, stride, stride, src_fmt, info, dst_fmt,
+                                   keep_aspect_ratio, 114, norm_mean, norm_std, chw, fp32.data()), 0);
+        std::vector<float> expected = chw ? ToCHW(ref_fp32, pixels, info.c) : ref_fp32;
+        for (size_t k = 0; k < fp32.size(); ++k) EXPECT_NEAR(expected[k], fp32[k], 1e-4) << "chw " << chw;
+      }
+    });
+  }
+
+  // only 3 channels are supported
+  info.c = 1;
+  std::vector<uint8_t> u8(pixels);
+  EXPECT_EQ(YUV420spToTensor(src_y, src_uv, src_w, src_h, stride, stride, CNEDK_BUF_COLOR_FORMAT_NV12, info,
+                             CNEDK_BUF_COLOR_FORMAT_RGB, false, 0, nullptr, nullptr, false, u8.data()), -1);
+}
+
+}  // namespace cnstream
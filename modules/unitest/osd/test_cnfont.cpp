@@ -0,0 +1,156 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cnfont.hpp"
+
+#ifdef HAVE_FREETYPE
+
+namespace cnstream {
+
+namespace {
+
+const char* kFontPaths[] = {"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+                            "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+                            "/usr/share/fonts/truetype/wqy/wqy-microhei.ttc"};
+
+std::string FindFont() {
+  for (const char* path : kFontPaths) {
+    if (std::ifstream(path).good()) return path;
+  }
+  return "";
+}
+
+// renders text glyph by glyph with FreeType, as CnFont did before glyphs were cached
+class UncachedFont {
+ public:
+  UncachedFont(const std::string& font_path, int font_pixel, float space, float step)
+      : space_(font_pixel * space), sep_(font_pixel * step) {
+    FT_Init_FreeType(&library_);
+    FT_New_Face(library_, font_path.c_str(), 0, &face_);
+    FT_Set_Pixel_Sizes(face_, font_pixel, 0);
+  }
+  ~UncachedFont() {
+    FT_Done_Face(face_);
+    FT_Done_FreeType(library_);
+  }
+
+  void PutText(cv::Mat image, const std::wstring& text, cv::Point pos, cv::Scalar color) {
+    for (wchar_t wc : text) {
+      int cols = Render(wc, pos, [&](int r, int c) {
+        if (r >= 0 && r < image.rows && c >= 0 && c < image.cols) {
+          cv::Vec3b& pixel = image.at<cv::Vec3b>(r, c);
+          for (int k = 0; k < 3; ++k) pixel[k] = static_cast<uint8_t>(color.val[k]);
+        }
+      });
+      pos.x += static_cast<int>((cols ? cols : space_) + sep_);
+    }
+  }
+
+  void PutText(const std::wstring& text, cv::Scalar color, uint8_t* bitmap, cv::Size size) {
+    uint8_t b = static_cast<uint8_t>(color.val[0]);
+    uint8_t g = static_cast<uint8_t>(color.val[1]);
+    uint8_t r = static_cast<uint8_t>(color.val[2]);
+    uint16_t argb1555 =
+        0x8000 + (b >> 3) + (static_cast<uint16_t>(g >> 3) << 5) + (static_cast<uint16_t>(r >> 3) << 10);
+    size_t pitch = (size.width * 2 + 63) / 64 * 64;
+    cv::Point pos(0, size.height - 1);
+    for (wchar_t wc : text) {
+      int cols = Render(wc, pos, [&](int r, int c) {
+        if (r >= 0 && r < size.height && c >= 0 && c < size.width) {
+          *reinterpret_cast<uint16_t*>(bitmap + r * pitch + c * 2) = argb1555;
+        }
+      });
+      pos.x += static_cast<int>((cols ? cols : space_) + sep_);
+    }
+  }
+
+ private:
+  template <typename Func>
+  int Render(wchar_t wc, cv::Point pos, Func draw) {
+    FT_UInt glyph_index = FT_Get_Char_Index(face_, wc);
+    FT_Load_Glyph(face_, glyph_index, FT_LOAD_DEFAULT);
+    FT_Render_Glyph(face_->glyph, FT_RENDER_MODE_MONO);
+    FT_GlyphSlot slot = face_->glyph;
+    int rows = slot->bitmap.rows;
+    int cols = slot->bitmap.width;
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        if (slot->bitmap.buffer[i * slot->bitmap.pitch + j / 8] & (0xC0 >> (j % 8))) {
+          draw(pos.y - (rows - 1 - i), pos.x + j);
+        }
+      }
+    }
+    return cols;
+  }
+
+  FT_Library library_;
+  FT_Face face_;
+  double space_, sep_;
+};
+
+// printable ASCII characters are pre-rasterized, the others are cached at the first use
+const char kText[] = u8"Car 12: 0.98 éΩ中";
+const wchar_t kWideText[] = L"Car 12: 0.98 éΩ中";
+const cv::Scalar kColor(40, 200, 120);
+
+}  // namespace
+
+TEST(OsdCnFont, CachedSameAsUncached) {
+  std::string font_path = FindFont();
+  if (font_path.empty()) GTEST_SKIP() << "no font found";
+
+  CnFont font;
+  ASSERT_TRUE(font.Init(font_path, 24));
+  UncachedFont uncached(font_path, 24, 0.4, 0.15);
+
+  // text is partly out of the image, glyphs are clipped
+  const cv::Point positions[] = {cv::Point(10, 40), cv::Point(-5, 10), cv::Point(250, 62)};
+  cv::Mat expected(64, 320, CV_8UC3, cv::Scalar(10, 20, 30));
+  for (const auto& pos : positions) uncached.PutText(expected, kWideText, pos, kColor);
+  // the second round uses glyphs cached by the first one
+  for (int round = 0; round < 2; ++round) {
+    cv::Mat image(64, 320, CV_8UC3, cv::Scalar(10, 20, 30));
+    for (const auto& pos : positions) {
+      ASSERT_EQ(font.putText(image, const_cast<char*>(kText), pos, kColor), 0);
+    }
+    EXPECT_EQ(cv::norm(expected, image, cv::NORM_INF), 0) << "round " << round;
+  }
+
+  // ARGB1555 bitmap of hardware OSD
+  cv::Size size(200, 30);
+  size_t pitch = (size.width * 2 + 63) / 64 * 64;
+  std::vector<uint8_t> expected_bitmap(pitch * size.height, 0);
+  uncached.PutText(kWideText, kColor, expected_bitmap.data(), size);
+  for (int round = 0; round < 2; ++round) {
+    std::vector<uint8_t> bitmap(pitch * size.height, 0);
+    ASSERT_EQ(font.putText(const_cast<char*>(kText), kColor, cv::Scalar(0, 0, 0), bitmap.data(), size), 0);
+    EXPECT_EQ(bitmap, expected_bitmap) << "round " << round;
+  }
+}
+
+}  // namespace cnstream
+
+#endif  // HAVE_FREETYPE
@@ -20,6 +20,7 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
 #include <memory>
 #include <string>
 #include <utility>
@@ -30,6 +31,7 @@
 #if (CV_MAJOR_VERSION >= 3)
 #include "opencv2/imgcodecs/imgcodecs.hpp"
 #endif
+#include "cnosd.hpp"
 #include "cnstream_frame_va.hpp"
 #include "cnstream_module.hpp"
 #include "osd.hpp"
@@ -96,6 +98,11 @@ TEST(Osd, OpenClose) {
   param["text_thickness"] = "1.5";
   param["box_thickness"] = "2";
   EXPECT_TRUE(osd->Open(param));
+  param["tile_num"] = "4";
+  EXPECT_TRUE(osd->Open(param));
+  param["label_cache"] = "true";
+  param["show_stats"] = "true";
+  EXPECT_TRUE(osd->Open(param));
 
   param["secondary_label_path"] = label_path;
   param["attr_keys"] = "test_key";
@@ -330,4 +337,88 @@ TEST(Osd, OsdHandler) {
   osd->OnEos(std::to_string(0));
 }
 
+static std::shared_ptr<CNDataFrame> CreateNv12Frame(int width, int height) {
+  CnedkBufSurfaceCreateParams create_params;
+  memset(&create_params, 0, sizeof(create_params));
+  create_params.device_id = g_dev_id;
+  create_params.batch_size = 1;
+  create_params.width = width;
+  create_params.height = height;
+  create_params.color_format = CNEDK_BUF_COLOR_FORMAT_NV12;
+  create_params.mem_type = CNEDK_BUF_MEM_SYSTEM;
+  CnedkBufSurface *surf;
+  if (CnedkBufSurfaceCreate(&surf, &create_params) < 0) return nullptr;
+
+  std::shared_ptr<CNDataFrame> frame = std::make_shared<CNDataFrame>();
+  frame->buf_surf = std::make_shared<cnedk::BufSurfaceWrapper>(surf);
+  for (uint32_t plane = 0; plane < 2; ++plane) {
+    uint8_t *data = static_cast<uint8_t *>(frame->buf_surf->GetHostData(plane));
+    uint32_t rows = plane ? height / 2 : height;
+    for (uint32_t r = 0; r < rows; ++r) memset(data + r * frame->buf_surf->GetStride(plane), plane ? 128 : 16, width);
+  }
+  return frame;
+}
+
+// returns the Y and UV planes without paddings
+static std::vector<uint8_t> GetPlanes(std::shared_ptr<CNDataFrame> frame) {
+  std::vector<uint8_t> planes;
+  uint32_t width = frame->buf_surf->GetWidth();
+  uint32_t height = frame->buf_surf->GetHeight();
+  for (uint32_t plane = 0; plane < 2; ++plane) {
+    const uint8_t *data = static_cast<uint8_t *>(frame->buf_surf->GetHostData(plane));
+    uint32_t rows = plane ? height / 2 : height;
+    for (uint32_t r = 0; r < rows; ++r) {
+      const uint8_t *row = data + r * frame->buf_surf->GetStride(plane);
+      planes.insert(planes.end(), row, row + width);
+    }
+  }
+  return planes;
+}
+
+TEST(Osd, LabelCacheOnNv12) {
+  const std::vector<std::string> labels = {"person", "car", "bus"};
+  const std::vector<std::string> attr_keys = {"color"};
+  std::vector<uint8_t> planes[2][2];
+  for (int cache = 0; cache < 2; ++cache) {
+    CnOsd osd(labels);
+    osd.SetLabelCache(cache);
+    uint64_t lookups[2], hits[2];
+    for (int f = 0; f < 2; ++f) {
+      auto frame = CreateNv12Frame(640, 360);
+      ASSERT_NE(frame, nullptr);
+      CNObjsVec objs;
+      // the last object is not tracked, its label is never cached
+      const char *track_ids[] = {"1", "2", "-1"};
+      for (int i = 0; i < 3; ++i) {
+        auto obj = std::make_shared<CNInferObject>();
+        obj->id = std::to_string(i);
+        obj->track_id = track_ids[i];
+        obj->score = 0.9;
+        // objects move between frames, cached labels are painted at the new positions
+        obj->bbox = CnInferBbox(0.1 + 0.25 * i + 0.02 * f, 0.3 + 0.01 * f, 0.2, 0.4);
+        obj->AddExtraAttribute("color", i ? "red" : "white");
+        objs.push_back(obj);
+      }
+      osd.DrawLabel(frame, objs, attr_keys);
+      osd.update_vframe(frame);
+      planes[cache][f] = GetPlanes(frame);
+      osd.GetLabelCacheStats(&lookups[f], &hits[f]);
+    }
+    if (!cache) {
+      EXPECT_EQ(lookups[1], 0u);
+      continue;
+    }
+    // a label and an attribute of the two tracked objects in each frame
+    EXPECT_EQ(lookups[0], 4u);
+    EXPECT_EQ(hits[0], 0u);
+    EXPECT_EQ(lookups[1] - lookups[0], 4u);
+    EXPECT_EQ(hits[1] - hits[0], 4u);
+  }
+  std::vector<uint8_t> blank = GetPlanes(CreateNv12Frame(640, 360));
+  for (int f = 0; f < 2; ++f) {
+    EXPECT_NE(planes[0][f], blank) << "frame " << f;
+    EXPECT_TRUE(planes[0][f] == planes[1][f]) << "frame " << f;
+  }
+}
+
 }  // namespace cnstream
@@ -0,0 +1,144 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "yuv_painter.hpp"
+
+namespace cnstream {
+
+namespace {
+
+// NV12 or NV21 image with strides larger than the width
+struct YuvImage {
+  YuvImage(int w, int h, bool nv21) : width(w), height(h), stride(w + 16) {
+    y.assign(stride * h, 16);
+    uv.assign(stride * ((h + 1) / 2), 128);
+    painter.Bind(y.data(), stride, uv.data(), stride, w, h, nv21);
+  }
+  uint8_t Y(int x, int row) const { return y[row * stride + x]; }
+  uint8_t UV(int x, int row, int i) const { return uv[row / 2 * stride + x / 2 * 2 + i]; }
+  int width, height, stride;
+  std::vector<uint8_t> y, uv;
+  YuvPainter painter;
+};
+
+const cv::Scalar kRed(0, 0, 255);  // Y 82, U 90, V 240
+
+}  // namespace
+
+TEST(OsdYuvPainter, FillRect) {
+  YuvImage img(64, 32, false);
+  img.painter.FillRect(cv::Rect(10, 4, 8, 6), kRed);
+  EXPECT_EQ(img.Y(10, 4), 82);
+  EXPECT_EQ(img.Y(17, 9), 82);
+  EXPECT_EQ(img.Y(9, 4), 16);
+  EXPECT_EQ(img.Y(18, 9), 16);
+  EXPECT_EQ(img.Y(10, 10), 16);
+  EXPECT_EQ(img.UV(10, 4, 0), 90);
+  EXPECT_EQ(img.UV(10, 4, 1), 240);
+  EXPECT_EQ(img.UV(18, 4, 0), 128);
+
+  // clipped to the image, the padding of rows is not touched
+  img.painter.FillRect(cv::Rect(-5, 28, 100, 10), kRed);
+  EXPECT_EQ(img.Y(0, 31), 82);
+  EXPECT_EQ(img.Y(63, 31), 82);
+  EXPECT_EQ(img.y[31 * img.stride + 64], 16);
+  EXPECT_EQ(img.uv[15 * img.stride + 64], 128);
+
+  // odd edges take the chroma of the whole block
+  img.painter.FillRect(cv::Rect(31, 17, 1, 1), kRed);
+  EXPECT_EQ(img.Y(30, 16), 16);
+  EXPECT_EQ(img.UV(30, 16, 1), 240);
+
+  img.painter.Unbind();
+  EXPECT_FALSE(img.painter.IsBound());
+  img.painter.FillRect(cv::Rect(0, 0, 4, 4), kRed);
+  EXPECT_EQ(img.Y(0, 0), 16);
+}
+
+TEST(OsdYuvPainter, DrawRect) {
+  YuvImage img(64, 64, false);
+  img.painter.DrawRect(cv::Point(10, 10), cv::Point(40, 30), kRed, 2);
+  EXPECT_EQ(img.Y(9, 9), 82);
+  EXPECT_EQ(img.Y(10, 10), 82);
+  EXPECT_EQ(img.Y(40, 30), 82);
+  EXPECT_EQ(img.Y(25, 9), 82);
+  EXPECT_EQ(img.Y(25, 30), 82);
+  EXPECT_EQ(img.Y(25, 20), 16);
+  EXPECT_EQ(img.Y(11, 11), 16);
+  EXPECT_EQ(img.Y(8, 20), 16);
+  EXPECT_EQ(img.Y(41, 20), 16);
+  EXPECT_EQ(img.UV(25, 20, 0), 128);
+
+  // too small to have a hollow
+  img.painter.DrawRect(cv::Point(50, 50), cv::Point(51, 51), kRed, 3);
+  EXPECT_EQ(img.Y(50, 50), 82);
+  EXPECT_EQ(img.Y(51, 51), 82);
+}
+
+TEST(OsdYuvPainter, DrawMask) {
+  YuvImage img(32, 16, true);
+  std::vector<uint8_t> data(8 * 4, 0);
+  cv::Mat mask(4, 8, CV_8UC1, data.data());
+  // the first block is covered fully, the second by one pixel
+  mask.ptr<uint8_t>(0)[0] = mask.ptr<uint8_t>(0)[1] = 255;
+  mask.ptr<uint8_t>(1)[0] = mask.ptr<uint8_t>(1)[1] = 255;
+  mask.ptr<uint8_t>(0)[2] = 255;
+  img.painter.DrawMask(mask, cv::Point(4, 2), kRed);
+
+  EXPECT_EQ(img.Y(4, 2), 82);
+  EXPECT_EQ(img.Y(5, 3), 82);
+  EXPECT_EQ(img.Y(6, 2), 82);
+  EXPECT_EQ(img.Y(7, 2), 16);
+  EXPECT_EQ(img.Y(6, 3), 16);
+  // V comes first in NV21
+  EXPECT_EQ(img.UV(4, 2, 0), 240);
+  EXPECT_EQ(img.UV(4, 2, 1), 90);
+  EXPECT_EQ(img.UV(6, 2, 0), 128);
+
+  // partly outside of the image
+  img.painter.DrawMask(mask, cv::Point(30, 14), kRed);
+  EXPECT_EQ(img.Y(30, 14), 82);
+  EXPECT_EQ(img.Y(31, 15), 82);
+  EXPECT_EQ(img.y[14 * img.stride + 32], 16);
+  EXPECT_EQ(img.UV(30, 14, 0), 240);
+}
+
+TEST(OsdYuvPainter, Clip) {
+  // drawing by tiles is the same as drawing the whole image
+  YuvImage whole(64, 48, false), tiled(64, 48, false);
+  std::vector<uint8_t> data(6 * 5, 255);
+  cv::Mat mask(5, 6, CV_8UC1, data.data());
+  whole.painter.DrawRect(cv::Point(3, 9), cv::Point(50, 30), kRed, 3);
+  whole.painter.DrawMask(mask, cv::Point(7, 13), kRed);
+  for (int y = 0; y < 48; y += 16) {
+    YuvPainter painter = tiled.painter;
+    painter.SetClip(cv::Rect(0, y, 64, 16));
+    painter.DrawRect(cv::Point(3, 9), cv::Point(50, 30), kRed, 3);
+    painter.DrawMask(mask, cv::Point(7, 13), kRed);
+  }
+  EXPECT_EQ(whole.y, tiled.y);
+  EXPECT_EQ(whole.uv, tiled.uv);
+}
+
+}  // namespace cnstream
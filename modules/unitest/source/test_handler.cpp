@@ -23,6 +23,7 @@
 #include <chrono>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -77,7 +78,8 @@ static std::shared_ptr<SourceHandler> CreateFileHandle(DataSource* src,
                                                        std::string filename,
                                                        std::string stream_id = "0",
                                                        int framerate = 30,
-                                                       bool loop = false) {
+                                                       bool loop = false,
+                                                       bool max_speed = false) {
   Resolution maximum_resolution;
   maximum_resolution.width = 1920;
   maximum_resolution.height = 1080;
@@ -86,6 +88,7 @@ static std::shared_ptr<SourceHandler> CreateFileHandle(DataSource* src,
   param.filename = filename;
   param.framerate = framerate;
   param.loop = loop;
+  param.max_speed = max_speed;
   param.max_res = maximum_resolution;
 
   auto handle = CreateSource(src, stream_id, param);
@@ -295,6 +298,92 @@ TEST(DataHandlerFile, ProcessMlu) {
   }
 }
 
+class PtsObserver : public IModuleObserver {
+ public:
+  void Wait(size_t count) {
+    while (!get_eos && GetTimestamps().size() < count) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  void WaitEos() {
+    while (!get_eos) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  std::vector<int64_t> GetTimestamps() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return timestamps_;
+  }
+
+ private:
+  void Notify(std::shared_ptr<CNFrameInfo> data) override {
+    if (data->IsEos()) {
+      get_eos = true;
+      return;
+    }
+    std::lock_guard<std::mutex> lk(mutex_);
+    timestamps_.push_back(data->timestamp);
+  }
+  std::mutex mutex_;
+  std::vector<int64_t> timestamps_;
+  std::atomic<bool> get_eos{false};
+};
+
+TEST(DataHandlerFile, ProcessMluMaxSpeed) {
+  std::string car_path = GetExePath() + "../../modules/unitest/data/cars_short.mp4";
+  std::string wrong_path = "/fake/data/image.h264";
+  ModuleParamSet param;
+  param["device_id"] = "0";
+  std::vector<int64_t> first_run;
+  for (int run = 0; run < 2; ++run) {  // replay is deterministic
+    PtsObserver observer;
+    DataSource src(gname);
+    src.SetObserver(&observer);
+    ASSERT_TRUE(src.Open(param));
+    auto handler = CreateFileHandle(&src, car_path, "0", 1, false, true);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(src.AddSource(handler), 0);
+    observer.WaitEos();
+    std::chrono::duration<double, std::milli> dura = std::chrono::steady_clock::now() - start;
+    // framerate 1 is ignored in max speed mode
+    EXPECT_LT(dura.count(), 11 * 1000);
+    src.RemoveSource(handler);
+    auto timestamps = observer.GetTimestamps();
+    EXPECT_EQ(timestamps.size(), 11u);
+    if (run == 0) {
+      first_run = timestamps;
+    } else {
+      EXPECT_EQ(timestamps, first_run);
+    }
+  }
+  {  // pts keeps increasing across loops
+    PtsObserver observer;
+    DataSource src(gname);
+    src.SetObserver(&observer);
+    ASSERT_TRUE(src.Open(param));
+    auto handler = CreateFileHandle(&src, car_path, "0", 30, true, true);
+    EXPECT_EQ(src.AddSource(handler), 0);
+    observer.Wait(3 * 11);
+    src.RemoveSource(handler);
+    auto timestamps = observer.GetTimestamps();
+    ASSERT_GE(timestamps.size(), 3u * 11);
+    for (size_t i = 1; i < timestamps.size(); ++i) {
+      EXPECT_GT(timestamps[i], timestamps[i - 1]);
+    }
+  }
+  {  // eos is reported even if the stream fails to open
+    PtsObserver observer;
+    DataSource src(gname);
+    src.SetObserver(&observer);
+    ASSERT_TRUE(src.Open(param));
+    auto handler = CreateFileHandle(&src, wrong_path, "0", 30, false, true);
+    EXPECT_EQ(src.AddSource(handler), 0);
+    observer.WaitEos();
+    src.RemoveSource(handler);
+    EXPECT_TRUE(observer.GetTimestamps().empty());
+  }
+}
+
 static std::shared_ptr<SourceHandler> CreateRtspHandle(DataSource* src,
                                                        std::string rtsp_url,
                                                        std::string stream_id = "0",
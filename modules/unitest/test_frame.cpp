@@ -18,9 +18,11 @@
  * THE SOFTWARE.
  *************************************************************************/
 
+#include <algorithm>
 #include <ctime>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -81,6 +83,86 @@ TEST(CoreFrameDeathTest, ConvertImageToBGRFailed) {
   EXPECT_DEATH(frame.ImageBGR(), ".*Unsupported pixel format.*");
 }
 
+// fills the frame with smooth gradients in the middle of the color range, so that the interpolations of
+// different resizers are close and no color is clipped
+static void FillGradient(CNDataFrame* frame) {
+  uint32_t w = frame->buf_surf->GetWidth();
+  uint32_t h = frame->buf_surf->GetHeight();
+  uint8_t* y_plane = static_cast<uint8_t*>(frame->buf_surf->GetHostData(0));
+  uint8_t* uv_plane = static_cast<uint8_t*>(frame->buf_surf->GetHostData(1));
+  uint32_t y_stride = frame->buf_surf->GetStride(0);
+  uint32_t uv_stride = frame->buf_surf->GetStride(1);
+  for (uint32_t r = 0; r < h; ++r) {
+    for (uint32_t c = 0; c < w; ++c) y_plane[r * y_stride + c] = 64 + (r + c) / 32;
+  }
+  for (uint32_t r = 0; r < h / 2; ++r) {
+    for (uint32_t c = 0; c < w / 2; ++c) {
+      uv_plane[r * uv_stride + c * 2] = 112 + c / 64;
+      uv_plane[r * uv_stride + c * 2 + 1] = 120 + r / 32;
+    }
+  }
+  frame->buf_surf->SyncHostToDevice();
+}
+
+TEST(CoreFrame, ConvertImageRoiPixels) {
+  CNDataFrame frame;
+  InitFrame(&frame, CNEDK_BUF_COLOR_FORMAT_NV12);
+  FillGradient(&frame);
+  const cv::Rect roi(400, 300, 320, 200);
+  cv::Mat bgr = frame.ImageRoi(roi);
+  cv::Mat resized = frame.ImageRoi(roi, cv::Size(100, 64));
+  cv::Mat rgb = frame.ImageRoi(roi, cv::Size(), CNEDK_BUF_COLOR_FORMAT_RGB);
+  cv::Mat gray = frame.ImageRoi(roi, cv::Size(), CNEDK_BUF_COLOR_FORMAT_GRAY8);
+  ASSERT_FALSE(frame.HasBGRImage());
+
+  // regions are converted the same as the whole frame
+  cv::Mat expected = frame.ImageBGR()(roi);
+  EXPECT_LE(cv::norm(bgr, expected, cv::NORM_INF), 1);
+  cv::Mat expected_rgb;
+  cv::cvtColor(expected, expected_rgb, cv::COLOR_BGR2RGB);
+  EXPECT_LE(cv::norm(rgb, expected_rgb, cv::NORM_INF), 1);
+  cv::Mat expected_resized;
+  cv::resize(expected, expected_resized, cv::Size(100, 64));
+  // the chroma is interpolated before the conversion instead of after it
+  EXPECT_LE(cv::norm(resized, expected_resized, cv::NORM_INF), 6);
+  // gray is the luma of the frame
+  uint8_t* y_plane = static_cast<uint8_t*>(frame.buf_surf->GetHostData(0));
+  cv::Mat luma(frame.buf_surf->GetHeight(), frame.buf_surf->GetWidth(), CV_8UC1, y_plane, frame.buf_surf->GetStride(0));
+  EXPECT_EQ(cv::norm(gray, luma(roi), cv::NORM_INF), 0);
+}
+
+TEST(CoreFrame, ConvertImageRoi) {
+  CNDataFrame frame;
+  InitFrame(&frame, CNEDK_BUF_COLOR_FORMAT_NV12);
+  cv::Mat roi = frame.ImageRoi(cv::Rect(101, 51, 200, 100));
+  ASSERT_FALSE(roi.empty());
+  // aligned to even
+  EXPECT_EQ(roi.cols, 200);
+  EXPECT_EQ(roi.rows, 100);
+  EXPECT_EQ(roi.channels(), 3);
+  // cached
+  EXPECT_EQ(frame.ImageRoi(cv::Rect(101, 51, 200, 100)).data, roi.data);
+
+  cv::Mat resized = frame.ImageRoi(cv::Rect(100, 50, 200, 100), cv::Size(64, 32), CNEDK_BUF_COLOR_FORMAT_RGB);
+  EXPECT_EQ(resized.cols, 64);
+  EXPECT_EQ(resized.rows, 32);
+  cv::Mat gray = frame.ImageRoi(cv::Rect(1800, 1000, 400, 400), cv::Size(), CNEDK_BUF_COLOR_FORMAT_GRAY8);
+  EXPECT_EQ(gray.cols, 120);
+  EXPECT_EQ(gray.rows, 80);
+  EXPECT_EQ(gray.channels(), 1);
+  // the whole frame is not converted
+  EXPECT_FALSE(frame.HasBGRImage());
+
+  EXPECT_TRUE(frame.ImageRoi(cv::Rect(3000, 0, 100, 100)).empty());
+  EXPECT_TRUE(frame.ImageRoi(cv::Rect(0, 0, 100, 100), cv::Size(), CNEDK_BUF_COLOR_FORMAT_NV12).empty());
+
+  // cropped from the BGR image once the whole frame is converted
+  EXPECT_FALSE(frame.ImageBGR().empty());
+  cv::Mat from_bgr = frame.ImageRoi(cv::Rect(0, 0, 50, 50), cv::Size(20, 20));
+  EXPECT_EQ(from_bgr.cols, 20);
+  EXPECT_EQ(from_bgr.rows, 20);
+}
+
 TEST(CoreFrame, InferObjAddAttribute) {
   CNInferObject infer_obj;
   std::string key = "test_key";
@@ -119,6 +201,29 @@ TEST(CoreFrame, InferObjGetAttribute) {
   EXPECT_EQ(infer_attr.score, value.score);
 }
 
+TEST(CoreFrame, InferObjGetAttributes) {
+  CNInferObject infer_obj;
+  EXPECT_TRUE(infer_obj.GetAttributes().empty());
+  CNInferAttr value;
+  value.id = 1;
+  value.value = 2;
+  value.score = 0.9;
+  EXPECT_TRUE(infer_obj.AddAttribute("color", value));
+  value.value = 3;
+  EXPECT_TRUE(infer_obj.AddAttribute("type", value));
+
+  auto attributes = infer_obj.GetAttributes();
+  ASSERT_EQ(attributes.size(), 2u);
+  std::sort(attributes.begin(), attributes.end(),
+            [](const std::pair<std::string, CNInferAttr>& a, const std::pair<std::string, CNInferAttr>& b) {
+              return a.first < b.first;
+            });
+  EXPECT_EQ(attributes[0].first, "color");
+  EXPECT_EQ(attributes[0].second.value, 2);
+  EXPECT_EQ(attributes[1].first, "type");
+  EXPECT_EQ(attributes[1].second.value, 3);
+}
+
 TEST(CoreFrame, InferObjAddExtraAttribute) {
   CNInferObject infer_obj;
   std::string key = "test_key";
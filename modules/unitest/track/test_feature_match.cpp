@@ -0,0 +1,223 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "easytrack/include/easy_track.h"
+#include "easytrack/src/match.h"
+
+namespace cnstream {
+
+static std::vector<float> RandomFeature(std::mt19937 *gen, uint32_t dim) {
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  std::vector<float> feature(dim);
+  for (auto &val : feature) val = dist(*gen);
+  return feature;
+}
+
+TEST(FeatureMatch, CosineDistanceMatrix) {
+  std::mt19937 gen(0);
+  // odd sizes to cover the tails of vectorized loops
+  constexpr uint32_t kDim = 131, kDetNum = 7, kTrackNum = 5, kBudget = 6;
+  MatchAlgorithm *algo = MatchAlgorithm::Instance();
+
+  std::vector<std::vector<float>> dets;
+  std::vector<float> det_feats(kDetNum * kDim);
+  for (uint32_t d = 0; d < kDetNum; ++d) {
+    dets.emplace_back(RandomFeature(&gen, kDim));
+    ASSERT_TRUE(NormalizeFeature(dets.back(), det_feats.data() + d * kDim));
+  }
+
+  std::vector<FeatureGallery> galleries(kTrackNum);
+  std::vector<std::vector<Feature>> track_feats(kTrackNum);
+  std::vector<float> normalized(kDim);
+  for (uint32_t t = 0; t < kTrackNum; ++t) {
+    galleries[t].Reset(kDim, kBudget);
+    // more features than budget for some tracks, the oldest ones are dropped
+    for (uint32_t f = 0; f < t * 3; ++f) {
+      std::vector<float> feature = f % 4 == 0 ? dets[f % kDetNum] : RandomFeature(&gen, kDim);
+      NormalizeFeature(feature, normalized.data());
+      galleries[t].Add(normalized.data());
+      track_feats[t].emplace_back(feature, -1);
+      if (track_feats[t].size() > kBudget) track_feats[t].erase(track_feats[t].begin());
+    }
+    EXPECT_EQ(galleries[t].Size(), track_feats[t].size());
+  }
+
+  std::vector<const FeatureGallery *> gallery_ptrs;
+  for (auto &gallery : galleries) gallery_ptrs.push_back(&gallery);
+  Matrix cost;
+  CosineDistanceMatrix(gallery_ptrs, det_feats.data(), kDetNum, kDim, &cost);
+  ASSERT_EQ(cost.Rows(), kTrackNum);
+  ASSERT_EQ(cost.Cols(), kDetNum);
+  for (uint32_t t = 0; t < kTrackNum; ++t) {
+    for (uint32_t d = 0; d < kDetNum; ++d) {
+      EXPECT_NEAR(cost(t, d), algo->Distance(track_feats[t], Feature(dets[d], -1)), 1e-5) << t << " " << d;
+    }
+  }
+
+  // gallery of another dimension never matches
+  galleries[1].Reset(kDim + 1, kBudget);
+  std::vector<float> other(kDim + 1, 1.f);
+  galleries[1].Add(other.data());
+  CosineDistanceMatrix(gallery_ptrs, det_feats.data(), kDetNum, kDim, &cost);
+  for (uint32_t d = 0; d < kDetNum; ++d) EXPECT_EQ(cost(1, d), 1.f);
+}
+
+TEST(FeatureMatch, TrackWithFeatures) {
+  std::mt19937 gen(1);
+  constexpr int kObjNum = 50;
+  constexpr uint32_t kDim = 128;
+  std::vector<std::vector<float>> features;
+  for (int i = 0; i < kObjNum; ++i) features.emplace_back(RandomFeature(&gen, kDim));
+
+  FeatureMatchTrack tracker;
+  tracker.SetParams(0.2, 100, 0.7, 30, 3);
+  std::vector<int> confirmed_ids;
+  for (int frame = 0; frame < 10; ++frame) {
+    Objects detects;
+    for (int i = 0; i < kObjNum; ++i) {
+      DetectObject obj;
+      obj.label = 0;
+      obj.score = 0.9;
+      obj.track_id = -1;
+      obj.detect_id = -1;
+      obj.feat_mold = -1;
+      obj.bbox.x = (i % 10) * 0.1f + frame * 0.002f;
+      obj.bbox.y = (i / 10) * 0.2f;
+      obj.bbox.width = 0.08f;
+      obj.bbox.height = 0.15f;
+      obj.feature = features[i];
+      detects.emplace_back(obj);
+    }
+    // shuffle detections, ids follow objects instead of order
+    std::shuffle(detects.begin(), detects.end(), gen);
+    Objects tracks;
+    tracker.UpdateFrame(detects, &tracks);
+    ASSERT_EQ(tracks.size(), detects.size());
+    std::vector<int> ids(kObjNum, -2);
+    for (auto &obj : tracks) {
+      int i = std::find(features.begin(), features.end(), obj.feature) - features.begin();
+      ids[i] = obj.track_id;
+    }
+    // ids are reported from the frame after tracks are confirmed
+    if (frame == 4) {
+      confirmed_ids = ids;
+      EXPECT_EQ(std::set<int>(ids.begin(), ids.end()).size(), ids.size());
+      EXPECT_EQ(std::count(ids.begin(), ids.end(), -1), 0);
+    } else if (frame > 4) {
+      EXPECT_EQ(ids, confirmed_ids);
+    }
+  }
+  // a feature is added to the gallery of its track in every frame
+  TrackStats stats = tracker.GetStats();
+  EXPECT_EQ(stats.track_num, static_cast<uint32_t>(kObjNum));
+  EXPECT_EQ(stats.confirmed_num, static_cast<uint32_t>(kObjNum));
+  EXPECT_EQ(stats.max_gallery_size, 10u);
+  EXPECT_EQ(stats.feature_num, 10u * kObjNum);
+}
+
+TEST(FeatureMatch, GalleryPrune) {
+  std::mt19937 gen(2);
+  std::normal_distribution<float> noise(0.f, 0.01f);
+  constexpr uint32_t kDim = 64, kBudget = 8;
+  std::vector<std::vector<float>> appearances;
+  for (int i = 0; i < 3; ++i) appearances.emplace_back(RandomFeature(&gen, kDim));
+
+  FeatureGallery gallery;
+  gallery.Reset(kDim, kBudget, 0.05f);
+  std::vector<float> normalized(kDim);
+  // near duplicates of a few appearances take one row for each appearance
+  for (int f = 0; f < 30; ++f) {
+    std::vector<float> feature = appearances[f % appearances.size()];
+    for (auto &val : feature) val += noise(gen);
+    NormalizeFeature(feature, normalized.data());
+    gallery.Add(normalized.data());
+  }
+  EXPECT_EQ(gallery.Size(), appearances.size());
+  // the latest sample of an appearance is kept
+  std::vector<float> latest(gallery.Data() + (29 % 3) * kDim, gallery.Data() + (29 % 3 + 1) * kDim);
+  EXPECT_EQ(latest, normalized);
+
+  // distinct features fill the budget, then the oldest ones are overwritten
+  for (int f = 0; f < 20; ++f) {
+    NormalizeFeature(RandomFeature(&gen, kDim), normalized.data());
+    gallery.Add(normalized.data());
+  }
+  EXPECT_EQ(gallery.Size(), kBudget);
+  bool kept = false;
+  for (uint32_t row = 0; row < gallery.Size(); ++row) {
+    kept |= std::equal(normalized.begin(), normalized.end(), gallery.Data() + row * kDim);
+  }
+  EXPECT_TRUE(kept);
+
+  // a track with steady appearance keeps a single feature
+  FeatureMatchTrack tracker;
+  tracker.SetParams(0.2, 100, 0.7, 30, 3, 0.05);
+  for (int frame = 0; frame < 10; ++frame) {
+    DetectObject obj;
+    obj.label = 0;
+    obj.score = 0.9;
+    obj.track_id = -1;
+    obj.detect_id = -1;
+    obj.feat_mold = -1;
+    obj.bbox = {0.1f + frame * 0.002f, 0.1f, 0.1f, 0.2f};
+    obj.feature = appearances[0];
+    Objects tracks;
+    tracker.UpdateFrame({obj}, &tracks);
+  }
+  TrackStats stats = tracker.GetStats();
+  EXPECT_EQ(stats.track_num, 1u);
+  EXPECT_EQ(stats.feature_num, 1u);
+}
+
+TEST(FeatureMatch, FeatureDimChanged) {
+  std::mt19937 gen(3);
+  FeatureMatchTrack tracker;
+  tracker.SetParams(0.2, 100, 0.7, 30, 3);
+  std::vector<int> ids;
+  for (int frame = 0; frame < 10; ++frame) {
+    DetectObject obj;
+    obj.label = 0;
+    obj.score = 0.9;
+    obj.track_id = -1;
+    obj.detect_id = -1;
+    obj.feat_mold = -1;
+    obj.bbox = {0.1f + frame * 0.002f, 0.1f, 0.1f, 0.2f};
+    // the feature extractor is changed to a smaller one
+    obj.feature = RandomFeature(&gen, frame < 5 ? 128 : 64);
+    Objects tracks;
+    tracker.UpdateFrame({obj}, &tracks);
+    ASSERT_EQ(tracks.size(), 1u);
+    ids.push_back(tracks[0].track_id);
+  }
+  // the track is kept, and its gallery restarts with features of the new dimension
+  EXPECT_EQ(std::set<int>(ids.begin() + 4, ids.end()).size(), 1u);
+  TrackStats stats = tracker.GetStats();
+  EXPECT_EQ(stats.track_num, 1u);
+  EXPECT_EQ(stats.feature_num, 5u);
+}
+
+}  // namespace cnstream
@@ -0,0 +1,169 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "easytrack/src/kalmanfilter.h"
+#include "easytrack/src/matrix.h"
+
+namespace cnstream {
+
+// kalman filter written with general matrices, as the reference of KalmanFilterBatch
+class ReferenceKalman {
+ public:
+  ReferenceKalman() : motion_(8, 8), update_(4, 8), mean_(1, 8), covariance_(8, 8) {
+    for (int i = 0; i < 8; ++i) motion_(i, i) = 1;
+    for (int i = 0; i < 4; ++i) motion_(i, i + 4) = 1;
+    for (int i = 0; i < 4; ++i) update_(i, i) = 1;
+  }
+
+  void Initiate(const BoundingBox &m) {
+    float z[4] = {m.x, m.y, m.width, m.height};
+    float std[8] = {2 * kPos * m.height,  2 * kPos * m.height,  1e-2f, 2 * kPos * m.height,
+                    10 * kVel * m.height, 10 * kVel * m.height, 1e-5f, 10 * kVel * m.height};
+    for (int i = 0; i < 8; ++i) {
+      mean_(0, i) = i < 4 ? z[i] : 0;
+      covariance_(i, i) = std[i] * std[i];
+    }
+  }
+
+  void Predict() {
+    float h = mean_(0, 3);
+    float std[8] = {kPos * h, kPos * h, 1e-2f, kPos * h, kVel * h, kVel * h, 1e-5f, kVel * h};
+    Matrix noise(8, 8);
+    for (int i = 0; i < 8; ++i) noise(i, i) = std[i] * std[i];
+    mean_ = mean_ * motion_.Trans();
+    covariance_ = motion_ * covariance_ * motion_.Trans() + noise;
+  }
+
+  Matrix ProjectedCovariance() const {
+    float h = mean_(0, 3);
+    float std[4] = {kPos * h, kPos * h, 1e-1f, kPos * h};
+    Matrix noise(4, 4);
+    for (int i = 0; i < 4; ++i) noise(i, i) = std[i] * std[i];
+    return update_ * covariance_ * update_.Trans() + noise;
+  }
+
+  void Update(const BoundingBox &m) {
+    Matrix z(std::vector<float>{m.x, m.y, m.width, m.height}, 1, 4);
+    Matrix gain = covariance_ * update_.Trans() * ProjectedCovariance().Inv();
+    mean_ += (z - mean_ * update_.Trans()) * gain.Trans();
+    covariance_ = covariance_ - gain * update_ * covariance_;
+  }
+
+  float GatingDistance(const BoundingBox &m) const {
+    Matrix d(std::vector<float>{m.x - mean_(0, 0), m.y - mean_(0, 1), m.width - mean_(0, 2), m.height - mean_(0, 3)},
+             1, 4);
+    return (d * ProjectedCovariance().Inv() * d.Trans())(0, 0);
+  }
+
+  BoundingBox GetCurPos() const { return {mean_(0, 0), mean_(0, 1), mean_(0, 2), mean_(0, 3)}; }
+
+ private:
+  static constexpr float kPos = 1. / 20;
+  static constexpr float kVel = 1. / 160;
+  Matrix motion_;
+  Matrix update_;
+  Matrix mean_;
+  Matrix covariance_;
+};
+
+constexpr float ReferenceKalman::kPos;
+constexpr float ReferenceKalman::kVel;
+
+static void ExpectNearBox(const BoundingBox &a, const BoundingBox &b) {
+  EXPECT_NEAR(a.x, b.x, 1e-2 * (1 + std::abs(b.x)));
+  EXPECT_NEAR(a.y, b.y, 1e-2 * (1 + std::abs(b.y)));
+  EXPECT_NEAR(a.width, b.width, 1e-3 * (1 + std::abs(b.width)));
+  EXPECT_NEAR(a.height, b.height, 1e-2 * (1 + std::abs(b.height)));
+}
+
+TEST(KalmanFilterBatch, SameAsGeneralMatrix) {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> pos(50, 1000);
+  std::uniform_real_distribution<float> ratio(0.3, 2);
+  std::uniform_real_distribution<float> height(20, 300);
+  std::uniform_real_distribution<float> noise(-3, 3);
+  std::bernoulli_distribution detected(0.8);
+
+  constexpr int kTrackNum = 37;
+  KalmanFilterBatch batch;
+  std::vector<ReferenceKalman> reference(kTrackNum);
+  std::vector<BoundingBox> truth(kTrackNum);
+  std::vector<BoundingBox> velocity(kTrackNum);
+  for (int i = 0; i < kTrackNum; ++i) {
+    truth[i] = {pos(gen), pos(gen), ratio(gen), height(gen)};
+    velocity[i] = {noise(gen), noise(gen), 0, noise(gen) / 10};
+    batch.Initiate(truth[i]);
+    reference[i].Initiate(truth[i]);
+  }
+  ASSERT_EQ(batch.Size(), static_cast<size_t>(kTrackNum));
+
+  for (int frame = 0; frame < 30; ++frame) {
+    batch.Predict();
+    for (int i = 0; i < kTrackNum; ++i) {
+      reference[i].Predict();
+      ExpectNearBox(batch.GetCurPos(i), reference[i].GetCurPos());
+
+      truth[i].x += velocity[i].x;
+      truth[i].y += velocity[i].y;
+      truth[i].height += velocity[i].height;
+      BoundingBox measurement = {truth[i].x + noise(gen), truth[i].y + noise(gen), truth[i].width,
+                                 truth[i].height + noise(gen)};
+      float distance;
+      batch.GatingDistance(i, {measurement}, &distance);
+      float expected = reference[i].GatingDistance(measurement);
+      EXPECT_NEAR(distance, expected, 1e-2 * (1 + expected));
+
+      if (detected(gen)) {
+        batch.Update(i, measurement);
+        reference[i].Update(measurement);
+        ExpectNearBox(batch.GetCurPos(i), reference[i].GetCurPos());
+      }
+    }
+  }
+}
+
+TEST(KalmanFilterBatch, MoveAndShrink) {
+  KalmanFilterBatch batch;
+  // enough filters to grow the storage several times
+  for (int i = 0; i < 100; ++i) {
+    batch.Initiate({static_cast<float>(i), static_cast<float>(2 * i), 0.5f, 100.f});
+  }
+  // keep odd filters
+  size_t alive = 0;
+  for (size_t i = 1; i < batch.Size(); i += 2) batch.Move(i, alive++);
+  batch.Shrink(alive);
+  ASSERT_EQ(batch.Size(), 50u);
+  for (size_t i = 0; i < batch.Size(); ++i) {
+    BoundingBox box = batch.GetCurPos(i);
+    EXPECT_FLOAT_EQ(box.x, 2 * i + 1);
+    EXPECT_FLOAT_EQ(box.y, 2 * (2 * i + 1));
+  }
+  batch.Predict();
+  batch.Initiate({1.f, 2.f, 0.5f, 100.f});
+  EXPECT_EQ(batch.Size(), 51u);
+  EXPECT_FLOAT_EQ(batch.GetCurPos(50).x, 1.f);
+}
+
+}  // namespace cnstream
@@ -0,0 +1,132 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "easytrack/src/hungarian.h"
+#include "easytrack/src/lapjv.h"
+#include "easytrack/src/match.h"
+
+namespace cnstream {
+
+// total cost where each missing pair costs max_cost
+static float GatedCost(const Matrix &cost, float max_cost, const std::vector<int> &assignment) {
+  float total = 0.f;
+  uint32_t assigned = 0;
+  for (uint32_t i = 0; i < assignment.size(); ++i) {
+    if (assignment[i] < 0) continue;
+    EXPECT_LE(cost(i, assignment[i]), max_cost);
+    total += cost(i, assignment[i]);
+    ++assigned;
+  }
+  return total + max_cost * (std::min(cost.Rows(), cost.Cols()) - assigned);
+}
+
+static Matrix RandomMatrix(std::mt19937 *gen, uint32_t rows, uint32_t cols) {
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  Matrix cost(rows, cols);
+  for (uint32_t i = 0; i < rows; ++i) {
+    for (uint32_t j = 0; j < cols; ++j) cost(i, j) = dist(*gen);
+  }
+  return cost;
+}
+
+// dense matrix for Hungarian, gated entries cost max_cost as missing pairs do
+static Matrix GateDense(const Matrix &cost, float max_cost) {
+  Matrix dense = cost;
+  for (uint32_t i = 0; i < dense.Rows(); ++i) {
+    for (uint32_t j = 0; j < dense.Cols(); ++j) dense(i, j) = std::min(dense(i, j), max_cost);
+  }
+  return dense;
+}
+
+static void ExpectValidAssignment(const std::vector<int> &assignment, uint32_t rows, uint32_t cols) {
+  ASSERT_EQ(assignment.size(), rows);
+  std::set<int> used;
+  for (int col : assignment) {
+    if (col < 0) continue;
+    EXPECT_LT(col, static_cast<int>(cols));
+    EXPECT_TRUE(used.insert(col).second) << "column " << col << " assigned twice";
+  }
+}
+
+TEST(Lapjv, SameCostAsHungarian) {
+  std::mt19937 gen(0);
+  const std::vector<std::pair<uint32_t, uint32_t>> shapes = {{1, 1}, {1, 5}, {5, 1}, {6, 9}, {9, 6},
+                                                            {20, 20}, {33, 50}, {120, 100}};
+  HungarianAlgorithm hungarian;
+  LapjvAlgorithm lapjv;
+  for (auto &shape : shapes) {
+    for (float max_cost : {0.05f, 0.3f, 0.7f, 1.f}) {
+      Matrix cost = RandomMatrix(&gen, shape.first, shape.second);
+      Matrix dense = GateDense(cost, max_cost);
+
+      std::vector<int> expected, actual;
+      hungarian.Solve(dense, &expected);
+      float expected_cost = 0.f;
+      for (uint32_t i = 0; i < expected.size(); ++i) {
+        if (expected[i] >= 0) expected_cost += dense(i, expected[i]);
+      }
+
+      lapjv.Solve(cost, max_cost, &actual);
+      ExpectValidAssignment(actual, shape.first, shape.second);
+      EXPECT_NEAR(GatedCost(cost, max_cost, actual), expected_cost, 1e-3)
+          << shape.first << "x" << shape.second << " max cost " << max_cost;
+    }
+  }
+}
+
+TEST(Lapjv, Empty) {
+  LapjvAlgorithm lapjv;
+  std::vector<int> assignment;
+  EXPECT_EQ(lapjv.Solve(Matrix(0, 3), 1.f, &assignment), 0.f);
+  EXPECT_TRUE(assignment.empty());
+  EXPECT_EQ(lapjv.Solve(Matrix(3, 0), 1.f, &assignment), 0.f);
+  EXPECT_EQ(assignment, std::vector<int>(3, -1));
+  // all entries gated
+  Matrix cost(2, 2);
+  cost.Fill(2.f);
+  lapjv.Solve(cost, 1.f, &assignment);
+  EXPECT_EQ(assignment, std::vector<int>(2, -1));
+}
+
+TEST(Lapjv, GatedMatch) {
+  std::mt19937 gen(1);
+  MatchAlgorithm *algo = MatchAlgorithm::Instance();
+  // small dense problems go to Hungarian, large or sparse ones to LAPJV
+  for (uint32_t size : {4u, 16u, 300u}) {
+    for (float max_cost : {0.02f, 0.9f}) {
+      Matrix cost = RandomMatrix(&gen, size, size);
+      Matrix dense = GateDense(cost, max_cost);
+      std::vector<int> expected, actual;
+      algo->HungarianMatch(dense, &expected);
+      algo->GatedMatch(cost, max_cost, &actual);
+      ExpectValidAssignment(actual, size, size);
+      EXPECT_NEAR(GatedCost(cost, max_cost, actual), GatedCost(dense, max_cost, expected), 1e-3);
+    }
+  }
+}
+
+}  // namespace cnstream
@@ -0,0 +1,126 @@
+/*************************************************************************
+ * Copyright (C) [2019] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+#include "easytrack/include/easy_track.h"
+
+namespace cnstream {
+
+static DetectObject MakeDetect(float x, float y, float w, float h) {
+  DetectObject obj;
+  obj.label = 0;
+  obj.score = 0.9;
+  obj.track_id = -1;
+  obj.detect_id = -1;
+  obj.feat_mold = -1;
+  obj.bbox.x = x;
+  obj.bbox.y = y;
+  obj.bbox.width = w;
+  obj.bbox.height = h;
+  return obj;
+}
+
+// returns track ids indexed by detect id
+static std::vector<int> Track(SortTrack *tracker, const Objects &detects) {
+  Objects tracks;
+  tracker->UpdateFrame(detects, &tracks);
+  EXPECT_EQ(tracks.size(), detects.size());
+  std::vector<int> ids(detects.size(), -2);
+  for (auto &obj : tracks) {
+    ids[obj.detect_id] = obj.track_id;
+  }
+  return ids;
+}
+
+TEST(SortTrack, ManyMovingObjects) {
+  SortTrack tracker;
+  tracker.SetParams(0.7, 30, 3);
+  constexpr int kRows = 15, kCols = 20;
+  std::vector<int> confirmed_ids;
+  for (int frame = 0; frame < 20; ++frame) {
+    Objects detects;
+    for (int r = 0; r < kRows; ++r) {
+      for (int c = 0; c < kCols; ++c) {
+        detects.emplace_back(MakeDetect(c * 0.05f + frame * 0.002f, r * 0.06f + frame * 0.001f, 0.04f, 0.05f));
+      }
+    }
+    std::vector<int> ids = Track(&tracker, detects);
+    if (frame < 3) {
+      for (int id : ids) EXPECT_EQ(id, -1);
+    } else if (frame == 3) {
+      confirmed_ids = ids;
+      std::set<int> unique_ids(ids.begin(), ids.end());
+      EXPECT_EQ(unique_ids.size(), ids.size());
+      EXPECT_EQ(unique_ids.count(-1), 0u);
+    } else {
+      EXPECT_EQ(ids, confirmed_ids);
+    }
+  }
+}
+
+TEST(SortTrack, OverlappedObjects) {
+  SortTrack tracker;
+  tracker.SetParams(0.7, 30, 3);
+  std::vector<int> confirmed_ids;
+  for (int frame = 0; frame < 10; ++frame) {
+    Objects detects;
+    // two heavily overlapped objects moving apart slowly
+    detects.emplace_back(MakeDetect(0.3f - frame * 0.002f, 0.3f, 0.2f, 0.2f));
+    detects.emplace_back(MakeDetect(0.34f + frame * 0.002f, 0.32f, 0.2f, 0.2f));
+    std::vector<int> ids = Track(&tracker, detects);
+    if (frame == 3) {
+      confirmed_ids = ids;
+      EXPECT_NE(ids[0], ids[1]);
+    } else if (frame > 3) {
+      EXPECT_EQ(ids, confirmed_ids);
+    }
+  }
+}
+
+TEST(SortTrack, MissedObjects) {
+  SortTrack tracker;
+  tracker.SetParams(0.7, 5, 3);
+  Objects detects = {MakeDetect(0.1f, 0.1f, 0.1f, 0.1f)};
+  Objects empty;
+  int id = -1;
+  for (int frame = 0; frame < 4; ++frame) id = Track(&tracker, detects)[0];
+  ASSERT_GE(id, 0);
+
+  // confirmed track survives missing for max_age frames
+  for (int frame = 0; frame < 5; ++frame) Track(&tracker, empty);
+  EXPECT_EQ(Track(&tracker, detects)[0], id);
+
+  // and is deleted after that
+  for (int frame = 0; frame < 6; ++frame) Track(&tracker, empty);
+  EXPECT_EQ(Track(&tracker, detects)[0], -1);
+
+  // tentative track is deleted once missed
+  Track(&tracker, empty);
+  Track(&tracker, detects);
+  Track(&tracker, detects);
+  EXPECT_EQ(Track(&tracker, detects)[0], -1);
+  EXPECT_GT(Track(&tracker, detects)[0], id);
+}
+
+}  // namespace cnstream
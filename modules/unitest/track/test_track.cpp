@@ -20,7 +20,10 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -33,6 +36,7 @@
 #include "cnis/processor.h"
 #include "cnstream_frame_va.hpp"
 #include "cnstream_module.hpp"
+#include "feature_extractor.hpp"
 #include "test_base.hpp"
 #include "track.hpp"
 
@@ -82,6 +86,47 @@ TEST(Tracker, CheckParamSet) {
   param["track_name"] = "no_such_track_name";
   EXPECT_FALSE(track->CheckParamSet(param));
 
+  param["track_name"] = "SORT";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["worker_num"] = "2";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["worker_num"] = "fake_num";
+  EXPECT_FALSE(track->CheckParamSet(param));
+  param.erase("worker_num");
+  param["max_iou_distance"] = "1.5";
+  EXPECT_FALSE(track->CheckParamSet(param));
+  param["max_iou_distance"] = "0.5";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["max_age"] = "0";
+  EXPECT_FALSE(track->CheckParamSet(param));
+  param["max_age"] = "10";
+  param["n_init"] = "2";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param.erase("max_iou_distance");
+  param.erase("max_age");
+  param.erase("n_init");
+
+  param["track_name"] = "FeatureMatch";
+  param["nn_budget"] = "0";
+  EXPECT_FALSE(track->CheckParamSet(param));
+  param["nn_budget"] = "20";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["feature_prune_distance"] = "-0.1";
+  EXPECT_FALSE(track->CheckParamSet(param));
+  param["feature_prune_distance"] = "0";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["feature_prune_distance"] = "0.1";
+  param["max_cosine_distance"] = "0.05";
+  EXPECT_FALSE(track->CheckParamSet(param));
+  // not checked if not set, or not used by SORT
+  param["track_name"] = "SORT";
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["track_name"] = "FeatureMatch";
+  param.erase("feature_prune_distance");
+  EXPECT_TRUE(track->CheckParamSet(param));
+  param["max_cosine_distance"] = std::to_string(g_max_cosine_distance);
+  param.erase("nn_budget");
+
   param["track_name"] = "FeatureMatch";
   EXPECT_TRUE(track->CheckParamSet(param));
   param["engine_num"] = "fake_num";
@@ -131,7 +176,7 @@ TEST(Tracker, OpenClose) {
   track->Close();
 }
 
-std::shared_ptr<CNFrameInfo> GenTestData(int iter, int obj_num) {
+std::shared_ptr<CNFrameInfo> GenTestData(int iter, int obj_num, bool have_obj = true) {
   // prepare data
   int width = 1920;
   int height = 1080;
@@ -170,10 +215,26 @@ std::shared_ptr<CNFrameInfo> GenTestData(int iter, int obj_num) {
     objs_holder->objs_.push_back(obj);
   }
   data->collection.Add(kCNDataFrameTag, frame);
-  data->collection.Add(kCNInferObjsTag, objs_holder);
+  if (have_obj) data->collection.Add(kCNInferObjsTag, objs_holder);
   return data;
 }
 
+class FrameOrderObserver : public IModuleObserver {
+ public:
+  void Notify(std::shared_ptr<CNFrameInfo> data) override {
+    if (data->IsEos()) return;
+    std::lock_guard<std::mutex> lk(mtx_);
+    frames_[data->GetStreamIndex()].push_back(data.get());
+  }
+  std::vector<CNFrameInfo*> Frames(uint32_t stream_idx) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return frames_[stream_idx];
+  }
+
+ private:
+  std::mutex mtx_;
+  std::map<uint32_t, std::vector<CNFrameInfo*>> frames_;
+};
 
 std::shared_ptr<CNFrameInfo> GenTestImageData(bool eos = false) {
   // prepare data
@@ -226,6 +287,34 @@ TEST(Tracker, ProcessMluFeature) {
   }
 }
 
+TEST(Tracker, ProcessMluFeatureOrder) {
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = ds_track;
+  param["model_path"] = GetExePath() + GetDSModelPath();
+  ASSERT_TRUE(track->Open(param));
+  FrameOrderObserver observer;
+  track->SetObserver(&observer);
+
+  int obj_num = 4;
+  int repeat_time = 10;
+  std::vector<CNFrameInfo*> sent;
+  std::vector<std::shared_ptr<CNFrameInfo>> frames;
+  for (int n = 0; n < repeat_time; ++n) {
+    // frames without objects are not passed to the extractor
+    auto data = GenTestData(n, obj_num, n % 3 != 1);
+    EXPECT_EQ(track->Process(data), 0);
+    sent.push_back(data.get());
+    frames.push_back(data);
+  }
+  auto eos = cnstream::CNFrameInfo::Create(std::to_string(0), true);
+  eos->SetStreamIndex(g_channel_id);
+  EXPECT_EQ(track->Process(eos), 0);
+  // frames without objects do not overtake frames in feature extraction
+  EXPECT_EQ(observer.Frames(g_channel_id), sent);
+  track->Close();
+}
+
 TEST(Tracker, ProcessCpuFeature) {
   // create track
   std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
@@ -253,6 +342,54 @@ TEST(Tracker, ProcessCpuFeature) {
   EXPECT_EQ(track->Process(data), 0);
 }
 
+static std::vector<CNInferFeature> ExtractCpuFeatures(const CNDataFramePtr& frame,
+                                                      const std::vector<CnInferBbox>& bboxes) {
+  auto data = cnstream::CNFrameInfo::Create("1");
+  data->SetStreamIndex(g_channel_id);
+  std::shared_ptr<CNInferObjs> objs_holder = std::make_shared<CNInferObjs>();
+  for (size_t i = 0; i < bboxes.size(); ++i) {
+    auto obj = std::make_shared<CNInferObject>();
+    obj->id = std::to_string(i);
+    obj->bbox = bboxes[i];
+    objs_holder->objs_.push_back(obj);
+  }
+  data->collection.Add(kCNDataFrameTag, frame);
+  data->collection.Add(kCNInferObjsTag, objs_holder);
+
+  int done = 0;
+  FeatureExtractor extractor([&done](const CNFrameInfoPtr, bool valid) { done += valid; });
+  EXPECT_TRUE(extractor.ExtractFeature(data));
+  EXPECT_EQ(done, 1);
+  std::vector<CNInferFeature> features;
+  for (auto& obj : objs_holder->objs_) features.push_back(obj->GetFeature("track"));
+  return features;
+}
+
+TEST(Tracker, CpuFeatureOnYPlane) {
+  cv::Mat img = cv::imread(GetExePath() + img_path, cv::IMREAD_COLOR);
+  ASSERT_FALSE(img.empty());
+  // a YUV frame, objects are cropped from its Y plane
+  CNDataFramePtr frame = GenerateCNDataFrame(img, g_dev_id);
+  std::vector<CnInferBbox> bboxes;
+  for (int i = 0; i < 16; ++i) bboxes.emplace_back(0.05 * (i % 4) + 0.1, 0.2 * (i / 4), 0.3, 0.25);
+  // out of the frame, no feature
+  bboxes.emplace_back(1.2, 0.1, 0.2, 0.2);
+
+  std::vector<CNInferFeature> features = ExtractCpuFeatures(frame, bboxes);
+  ASSERT_EQ(features.size(), bboxes.size());
+  for (size_t i = 0; i + 1 < features.size(); ++i) {
+    ASSERT_EQ(features[i].size(), 512u);
+    EXPECT_NE(std::count(features[i].begin(), features[i].end(), 0.f), 512) << "object " << i;
+  }
+  EXPECT_EQ(features.back(), CNInferFeature(512, 0.f));
+
+  // objects are processed in parallel, features do not depend on the other objects or on the thread
+  EXPECT_EQ(ExtractCpuFeatures(frame, bboxes), features);
+  EXPECT_EQ(ExtractCpuFeatures(frame, {bboxes[5]})[0], features[5]);
+  // the Y plane is not converted to BGR
+  EXPECT_FALSE(frame->HasBGRImage());
+}
+
 TEST(Tracker, ProcessFeatureMatchCPU0) {
   // create track
   std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
@@ -437,4 +574,61 @@ TEST(Tracker, ProcessCpuIoUMatch) {
   EXPECT_EQ(track->Process(data), 0);
 }
 
+TEST(Tracker, ProcessCpuSort) {
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = "SORT";
+  ASSERT_TRUE(track->Open(param));
+
+  int obj_num = 4;
+  int repeat_time = 10;
+  for (int n = 0; n < repeat_time; ++n) {
+    auto data = GenTestData(n, obj_num);
+    EXPECT_EQ(track->Process(data), 0);
+    CNInferObjsPtr objs_holder = data->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
+    for (size_t idx = 0; idx < objs_holder->objs_.size(); ++idx) {
+      EXPECT_FALSE(objs_holder->objs_[idx]->track_id.empty());
+    }
+  }
+  track->Close();
+}
+
+TEST(Tracker, ProcessCpuSortWorkers) {
+  std::shared_ptr<Module> track = std::make_shared<Tracker>(gname);
+  ModuleParamSet param;
+  param["track_name"] = "SORT";
+  param["worker_num"] = "2";
+  ASSERT_TRUE(track->Open(param));
+  FrameOrderObserver observer;
+  track->SetObserver(&observer);
+
+  int obj_num = 4;
+  int repeat_time = 10;
+  uint32_t stream_num = 3;
+  std::vector<std::shared_ptr<CNFrameInfo>> frames;
+  std::vector<std::vector<CNFrameInfo*>> sent(stream_num);
+  for (int n = 0; n < repeat_time; ++n) {
+    for (uint32_t stream_idx = 0; stream_idx < stream_num; ++stream_idx) {
+      auto data = GenTestData(n, obj_num, n % 3 != 1);
+      data->SetStreamIndex(stream_idx);
+      EXPECT_EQ(track->Process(data), 0);
+      frames.push_back(data);
+      sent[stream_idx].push_back(data.get());
+    }
+  }
+  // workers finish pending frames before exit
+  track->Close();
+  // frames of a stream are transmitted in order
+  for (uint32_t stream_idx = 0; stream_idx < stream_num; ++stream_idx) {
+    EXPECT_EQ(observer.Frames(stream_idx), sent[stream_idx]);
+  }
+  for (auto &data : frames) {
+    if (!data->collection.HasValue(kCNInferObjsTag)) continue;
+    CNInferObjsPtr objs_holder = data->collection.Get<CNInferObjsPtr>(kCNInferObjsTag);
+    for (size_t idx = 0; idx < objs_holder->objs_.size(); ++idx) {
+      EXPECT_FALSE(objs_holder->objs_[idx]->track_id.empty());
+    }
+  }
+}
+
 }  // namespace cnstream
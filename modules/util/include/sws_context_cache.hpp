@@ -0,0 +1,60 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#ifndef MODULES_UTIL_INCLUDE_SWS_CONTEXT_CACHE_HPP_
+#define MODULES_UTIL_INCLUDE_SWS_CONTEXT_CACHE_HPP_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavutil/pixfmt.h>
+#ifdef __cplusplus
+}
+#endif
+
+struct SwsContext;
+
+namespace cnstream {
+
+/**
+ * @brief Gets a scaler context from the cache of the calling thread.
+ *
+ * Contexts are keyed by the source and destination size, pixel format and scaling flags. A context is created by
+ * sws_getContext() the first time a key is seen, and reused afterwards. The least recently used context is freed when
+ * the cache of the thread is full, and all contexts are freed when the thread exits.
+ *
+ * @param[in] src_w The width of the source.
+ * @param[in] src_h The height of the source.
+ * @param[in] src_fmt The pixel format of the source.
+ * @param[in] dst_w The width of the destination.
+ * @param[in] dst_h The height of the destination.
+ * @param[in] dst_fmt The pixel format of the destination.
+ * @param[in] flags The scaling flags, e.g. SWS_BILINEAR.
+ *
+ * @return Returns the context, or nullptr if it fails to create one.
+ *
+ * @note The context is owned by the cache, it must not be freed and must not be used by other threads.
+ */
+SwsContext *GetCachedSwsContext(int src_w, int src_h, AVPixelFormat src_fmt, int dst_w, int dst_h,
+                                AVPixelFormat dst_fmt, int flags);
+
+}  // namespace cnstream
+
+#endif  // MODULES_UTIL_INCLUDE_SWS_CONTEXT_CACHE_HPP_
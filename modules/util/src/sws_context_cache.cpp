@@ -0,0 +1,96 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+
+#include "sws_context_cache.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libswscale/swscale.h>
+#ifdef __cplusplus
+}
+#endif
+
+namespace cnstream {
+
+namespace {
+
+// Sources of the same stream (and often of all streams) share one resolution, and object crops are scaled to the
+// network input size, so a few entries per thread cover the common cases.
+constexpr size_t kMaxCachedSwsContexts = 16;
+
+class SwsContextCache {
+ public:
+  ~SwsContextCache() {
+    for (auto &entry : entries_) sws_freeContext(entry.ctx);
+  }
+
+  SwsContext *Get(int src_w, int src_h, AVPixelFormat src_fmt, int dst_w, int dst_h, AVPixelFormat dst_fmt,
+                  int flags) {
+    ++tick_;
+    for (auto &entry : entries_) {
+      if (entry.src_w == src_w && entry.src_h == src_h && entry.src_fmt == src_fmt && entry.dst_w == dst_w &&
+          entry.dst_h == dst_h && entry.dst_fmt == dst_fmt && entry.flags == flags) {
+        entry.last_used = tick_;
+        return entry.ctx;
+      }
+    }
+    SwsContext *ctx = sws_getContext(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt, flags, nullptr, nullptr, nullptr);
+    if (!ctx) return nullptr;
+    if (entries_.size() >= kMaxCachedSwsContexts) {
+      size_t lru = 0;
+      for (size_t i = 1; i < entries_.size(); ++i) {
+        if (entries_[i].last_used < entries_[lru].last_used) lru = i;
+      }
+      sws_freeContext(entries_[lru].ctx);
+      entries_[lru] = entries_.back();
+      entries_.pop_back();
+    }
+    entries_.push_back({src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt, flags, ctx, tick_});
+    return ctx;
+  }
+
+ private:
+  struct Entry {
+    int src_w, src_h;
+    AVPixelFormat src_fmt;
+    int dst_w, dst_h;
+    AVPixelFormat dst_fmt;
+    int flags;
+    SwsContext *ctx;
+    uint64_t last_used;
+  };
+  std::vector<Entry> entries_;
+  uint64_t tick_ = 0;
+};  // class SwsContextCache
+
+}  // namespace
+
+SwsContext *GetCachedSwsContext(int src_w, int src_h, AVPixelFormat src_fmt, int dst_w, int dst_h,
+                                AVPixelFormat dst_fmt, int flags) {
+  thread_local SwsContextCache cache;
+  return cache.Get(src_w, src_h, src_fmt, dst_w, dst_h, dst_fmt, flags);
+}
+
+}  // namespace cnstream
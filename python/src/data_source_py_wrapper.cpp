@@ -51,6 +51,7 @@ void DataHandlerWrapper(py::module &m) {  // NOLINT
       .def_readwrite("loop", &FileSourceParam::loop)
       .def_readwrite("max_res", &FileSourceParam::max_res)
       .def_readwrite("only_key_frame", &FileSourceParam::only_key_frame)
+      .def_readwrite("max_speed", &FileSourceParam::max_speed)
       .def_readwrite("out_res", &FileSourceParam::out_res);
 
   py::class_<RtspSourceParam, std::shared_ptr<RtspSourceParam>>(m, "RtspSourceParam")
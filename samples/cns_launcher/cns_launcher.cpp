@@ -54,6 +54,7 @@
 DEFINE_string(data_path, "", "video file list.");
 DEFINE_string(data_name, "", "video file name.");
 DEFINE_int32(src_frame_rate, 25, "frame rate for send data");
+DEFINE_bool(src_max_speed, false, "feed video files as fast as the pipeline can process, src_frame_rate is ignored");
 DEFINE_int32(codec_id_start, 0, "vdec/venc first id, for CE3226 only");
 DEFINE_int32(maximum_width, -1, "maximum width, for variable video resolutions and Jpeg decoding");
 DEFINE_int32(maximum_height, -1, "maximum height, for variable video resolutions and Jpeg decoding");
@@ -727,6 +728,7 @@ int main(int argc, char **argv) {
       param.filename = filename;
       param.framerate = FLAGS_src_frame_rate;
       param.loop = FLAGS_loop;
+      param.max_speed = FLAGS_src_max_speed;
       param.max_res = maximum_resolution;
       if (platform == "CE3226") {
         param.out_res = out_resolution;
@@ -55,6 +55,7 @@ int OsdHandlerVS::GetDrawInfo(const CNObjsVec &objects, const std::vector<std::s
   for (auto &obj : objects) {
     DrawInfo draw_info;
     draw_info.bbox = GetFullFovBbox(obj.get());
+    draw_info.track_id = obj->track_id;
 
     // Label
     if (!obj->id.empty()) {
@@ -20,6 +20,8 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 // #define LOCAL_DEBUG_DUMP_IMAGE
@@ -32,11 +34,15 @@
 #endif
 
 #include "cnstream_postproc.hpp"
+#include "postprocess_common.hpp"
 
 #define CLIP(x) ((x) < 0 ? 0 : ((x) > 1 ? 1 : (x)))
 
 class PostprocSSDLpd : public cnstream::Postproc {
  public:
+  int Init(const std::unordered_map<std::string, std::string>& params) override {
+    return ParseDetectionParams(params, &det_params_);
+  }
   int Execute(const cnstream::NetOutputs& net_outputs, const infer_server::ModelInfo& model_info,
               const std::vector<cnstream::CNFrameInfoPtr>& packages,
               const std::vector<cnstream::CNInferObjectPtr>& objects,
@@ -45,6 +51,7 @@ class PostprocSSDLpd : public cnstream::Postproc {
  private:
   DECLARE_REFLEX_OBJECT_EX(PostprocSSDLpd, cnstream::Postproc);
   float threshold_ = 0.1;
+  DetectionParams det_params_;
 };
 
 IMPLEMENT_REFLEX_OBJECT_EX(PostprocSSDLpd, cnstream::Postproc);
@@ -68,8 +75,12 @@ int PostprocSSDLpd::Execute(const cnstream::NetOutputs& net_outputs, const infer
   int bbox_size = pred_dims[1];
   if (bbox_size != 7) return 0;
 
-  for (int i = 0; i < bbox_num; i++) {
-    float* bbox_data = preds + i * bbox_size;
+  // candidates of all batches are in one output, group them by batch index
+  std::vector<int> indices;
+  FilterByScore(preds, bbox_num, bbox_size, 2, threshold_, &indices);
+  std::vector<std::vector<DetectionBox>> batch_boxes(packages.size());
+  for (int i : indices) {
+    const float* bbox_data = preds + i * bbox_size;
     size_t batch_idx = static_cast<size_t>(bbox_data[0]);
     if (batch_idx >= packages.size()) continue;  // FIXME
     int category = static_cast<int>(bbox_data[1]);
@@ -77,8 +88,18 @@ int PostprocSSDLpd::Execute(const cnstream::NetOutputs& net_outputs, const infer
       // background
       continue;
     }
-    float score = bbox_data[2];
-    if (score < threshold_) continue;
+    float l = CLIP(bbox_data[3]);
+    float t = CLIP(bbox_data[4]);
+    float w = std::min(1 - l, bbox_data[5] - bbox_data[3]);
+    float h = std::min(1 - t, bbox_data[6] - bbox_data[4]);
+    if (w <= 0.0f || h <= 0.0f) continue;
+    batch_boxes[batch_idx].push_back({l, t, l + w, t + h, bbox_data[2], category});
+  }
+
+  for (size_t batch_idx = 0; batch_idx < packages.size(); ++batch_idx) {
+    std::vector<DetectionBox>& boxes = batch_boxes[batch_idx];
+    if (boxes.empty()) continue;
+    FilterDetections(&boxes, det_params_);
 
     auto package = packages[batch_idx];
     auto parent = objects[batch_idx];
@@ -89,46 +110,36 @@ int PostprocSSDLpd::Execute(const cnstream::NetOutputs& net_outputs, const infer
     if (!objs_holder) {
       return -1;
     }
-    auto plate_obj = std::make_shared<cnstream::CNInferObject>();
-    plate_obj->parent = parent;
-    plate_obj->id = std::to_string(category);
-    plate_obj->score = score;
-    plate_obj->bbox.x = bbox_data[3];
-    plate_obj->bbox.y = bbox_data[4];
-    plate_obj->bbox.w = bbox_data[5] - bbox_data[3];
-    plate_obj->bbox.h = bbox_data[6] - bbox_data[4];
-    plate_obj->bbox.x = CLIP(plate_obj->bbox.x);
-    plate_obj->bbox.y = CLIP(plate_obj->bbox.y);
-    plate_obj->bbox.w = std::min(1 - plate_obj->bbox.x, plate_obj->bbox.w);
-    plate_obj->bbox.h = std::min(1 - plate_obj->bbox.y, plate_obj->bbox.h);
-    if (plate_obj->bbox.w <= 0.0f || plate_obj->bbox.h <= 0.0f) continue;
-
-    plate_obj->AddExtraAttribute("Category", "Plate");
     std::lock_guard<std::mutex> lk(objs_holder->mutex_);
-    objs_holder->objs_.push_back(plate_obj);
+    for (const DetectionBox& box : boxes) {
+      auto plate_obj = CreateDetectionObject(box);
+      plate_obj->parent = parent;
+      plate_obj->AddExtraAttribute("Category", "Plate");
+      objs_holder->objs_.push_back(plate_obj);
 
 #ifdef LOCAL_DEBUG_DUMP_IMAGE
-    static std::atomic<unsigned int> count{0};
-    if (count < 100) {
-      const auto frame = package->collection.Get<cnstream::CNDataFramePtr>(cnstream::kCNDataFrameTag);
-      auto parent_bbox = cnstream::GetFullFovBbox(parent.get());
-      cv::Mat image = frame->ImageBGR();
-      auto color = cv::Scalar(0, 0, 255);  // cv::Scalar(b, g, r);
-      cv::Point top_left_p(parent_bbox.x * frame->buf_surf->GetWidth(), parent_bbox.y * frame->buf_surf->GetHeight());
-      cv::Point bottom_right_p((parent_bbox.x + parent_bbox.w) * frame->buf_surf->GetWidth(),
-                               (parent_bbox.y + parent_bbox.h) * frame->buf_surf->GetHeight());
-      cv::rectangle(image, top_left_p, bottom_right_p, color, 2);
-      auto obj_bbox = cnstream::GetFullFovBbox(plate_obj.get());
-      cv::Point top_left(obj_bbox.x * frame->buf_surf->GetWidth(), obj_bbox.y * frame->buf_surf->GetHeight());
-      cv::Point bottom_right((obj_bbox.x + obj_bbox.w) * frame->buf_surf->GetWidth(),
-                             (obj_bbox.y + obj_bbox.h) * frame->buf_surf->GetHeight());
-      cv::rectangle(image, top_left, bottom_right, color, 2);
-      std::string filename("test_ssd_lpd_bgr_");
-      filename += std::to_string(count) + ".jpg";
-      cv::imwrite(filename, image);
-    }
-    ++count;
+      static std::atomic<unsigned int> count{0};
+      if (count < 100) {
+        const auto frame = package->collection.Get<cnstream::CNDataFramePtr>(cnstream::kCNDataFrameTag);
+        auto parent_bbox = cnstream::GetFullFovBbox(parent.get());
+        cv::Mat image = frame->ImageBGR();
+        auto color = cv::Scalar(0, 0, 255);  // cv::Scalar(b, g, r);
+        cv::Point top_left_p(parent_bbox.x * frame->buf_surf->GetWidth(), parent_bbox.y * frame->buf_surf->GetHeight());
+        cv::Point bottom_right_p((parent_bbox.x + parent_bbox.w) * frame->buf_surf->GetWidth(),
+                                 (parent_bbox.y + parent_bbox.h) * frame->buf_surf->GetHeight());
+        cv::rectangle(image, top_left_p, bottom_right_p, color, 2);
+        auto obj_bbox = cnstream::GetFullFovBbox(plate_obj.get());
+        cv::Point top_left(obj_bbox.x * frame->buf_surf->GetWidth(), obj_bbox.y * frame->buf_surf->GetHeight());
+        cv::Point bottom_right((obj_bbox.x + obj_bbox.w) * frame->buf_surf->GetWidth(),
+                               (obj_bbox.y + obj_bbox.h) * frame->buf_surf->GetHeight());
+        cv::rectangle(image, top_left, bottom_right, color, 2);
+        std::string filename("test_ssd_lpd_bgr_");
+        filename += std::to_string(count) + ".jpg";
+        cv::imwrite(filename, image);
+      }
+      ++count;
 #endif
+    }
   }
   return 0;
 }
@@ -20,20 +20,27 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "cnstream_postproc.hpp"
+#include "postprocess_common.hpp"
 
 #define CLIP(x) ((x) < 0 ? 0 : ((x) > 1 ? 1 : (x)))
 
 class PostprocYolov3 : public cnstream::Postproc {
  public:
+  int Init(const std::unordered_map<std::string, std::string>& params) override {
+    return ParseDetectionParams(params, &det_params_);
+  }
   int Execute(const cnstream::NetOutputs& net_outputs, const infer_server::ModelInfo& model_info,
               const std::vector<cnstream::CNFrameInfoPtr>& packages,
               const cnstream::LabelStrings& labels) override;
 
  private:
   DECLARE_REFLEX_OBJECT_EX(PostprocYolov3, cnstream::Postproc);
+  DetectionParams det_params_;
 };  // class PostprocYolov3
 
 IMPLEMENT_REFLEX_OBJECT_EX(PostprocYolov3, cnstream::Postproc);
@@ -71,8 +78,10 @@ int PostprocYolov3::Execute(const cnstream::NetOutputs& net_outputs, const infer
     return -1;
   }
 
+  std::vector<int> indices;
+  std::vector<DetectionBox> boxes;
   for (size_t batch_idx = 0; batch_idx < packages.size(); batch_idx++) {
-    float* data = static_cast<float*>(output0->GetHostData(0, batch_idx));
+    const float* data = static_cast<const float*>(output0->GetHostData(0, batch_idx));
     int box_num = static_cast<int*>(output1->GetHostData(0, batch_idx))[0];
     if (!box_num) {
       continue;  // no bboxes
@@ -96,41 +105,31 @@ int PostprocYolov3::Execute(const cnstream::NetOutputs& net_outputs, const infer
     scaling_factor_w = scaling_w / scaling;
     scaling_factor_h = scaling_h / scaling;
 
-    std::lock_guard<std::mutex> lk(objs_holder->mutex_);
-    for (int bi = 0; bi < box_num; ++bi) {
-      if (threshold_ > 0 && data[2] < threshold_) {
-        data += 7;
-        continue;
-      }
-
-      float l = CLIP(data[3]);
-      float t = CLIP(data[4]);
-      float r = CLIP(data[5]);
-      float b = CLIP(data[6]);
+    // objects are only created for boxes surviving the score threshold, the top k selection and NMS
+    FilterByScore(data, box_num, 7, 2, threshold_, &indices);
+    boxes.clear();
+    for (int bi : indices) {
+      const float* row = data + bi * 7;
+      float l = CLIP(row[3]);
+      float t = CLIP(row[4]);
+      float r = CLIP(row[5]);
+      float b = CLIP(row[6]);
       l = CLIP((l - 0.5f) * scaling_factor_w + 0.5f);
       t = CLIP((t - 0.5f) * scaling_factor_h + 0.5f);
       r = CLIP((r - 0.5f) * scaling_factor_w + 0.5f);
       b = CLIP((b - 0.5f) * scaling_factor_h + 0.5f);
-      if (r <= l || b <= t) {
-        data += 7;
-        continue;
-      }
-
-      auto obj = std::make_shared<cnstream::CNInferObject>();
-      uint32_t id = static_cast<uint32_t>(data[1]);
-      obj->id = std::to_string(id);
-      obj->score = data[2];
-      obj->bbox.x = l;
-      obj->bbox.y = t;
-      obj->bbox.w = std::min(1.0f - l, r - l);
-      obj->bbox.h = std::min(1.0f - t, b - t);
+      if (r <= l || b <= t) continue;
+      boxes.push_back({l, t, r, b, row[2], static_cast<int>(row[1])});
+    }
+    FilterDetections(&boxes, det_params_);
 
-      if (!labels.empty() && id < labels[0].size()) {
-        obj->AddExtraAttribute("Category", labels[0][id]);
+    std::lock_guard<std::mutex> lk(objs_holder->mutex_);
+    for (const DetectionBox& box : boxes) {
+      auto obj = CreateDetectionObject(box);
+      if (!labels.empty() && box.label >= 0 && static_cast<size_t>(box.label) < labels[0].size()) {
+        obj->AddExtraAttribute("Category", labels[0][box.label]);
       }
-
       objs_holder->objs_.push_back(obj);
-      data += 7;
     }
   }  // for(batch_idx)
   return 0;
@@ -0,0 +1,127 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#include "postprocess_common.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cnstream_logging.hpp"
+
+int ParseDetectionParams(const std::unordered_map<std::string, std::string> &params, DetectionParams *det_params) {
+  try {
+    auto iter = params.find("nms_threshold");
+    if (iter != params.end()) det_params->nms_threshold = std::stof(iter->second);
+    iter = params.find("top_k");
+    if (iter != params.end()) det_params->top_k = std::stoul(iter->second);
+  } catch (std::exception &e) {
+    LOGE(POSTPROC) << "[ParseDetectionParams] Invalid nms_threshold or top_k: " << e.what();
+    return -1;
+  }
+  if (det_params->nms_threshold < 0 || det_params->nms_threshold > 1) {
+    LOGE(POSTPROC) << "[ParseDetectionParams] nms_threshold should be in range [0, 1].";
+    return -1;
+  }
+  return 0;
+}
+
+void FilterByScore(const float *data, int num, int stride, int score_offset, float threshold,
+                   std::vector<int> *indices) {
+  indices->clear();
+  if (threshold <= 0) {
+    indices->resize(num);
+    for (int i = 0; i < num; ++i) (*indices)[i] = i;
+    return;
+  }
+  // rows are strided, gathering the scores into vectors costs more than comparing them one by one
+  const float *score = data + score_offset;
+  for (int i = 0; i < num; ++i) {
+    if (!(score[i * stride] < threshold)) indices->push_back(i);
+  }
+}
+
+static bool ScoreGreater(const DetectionBox &a, const DetectionBox &b) { return a.score > b.score; }
+
+void SelectTopK(std::vector<DetectionBox> *boxes, size_t k) {
+  if (k && boxes->size() > k) {
+    std::partial_sort(boxes->begin(), boxes->begin() + k, boxes->end(), ScoreGreater);
+    boxes->resize(k);
+  } else {
+    std::stable_sort(boxes->begin(), boxes->end(), ScoreGreater);
+  }
+}
+
+void NmsByClass(std::vector<DetectionBox> *boxes, float iou_threshold) {
+  std::stable_sort(boxes->begin(), boxes->end(), ScoreGreater);
+  const size_t num = boxes->size();
+  std::vector<float> areas(num);
+  std::vector<char> suppressed(num, 0);
+  for (size_t i = 0; i < num; ++i) {
+    const DetectionBox &box = (*boxes)[i];
+    areas[i] = (box.r - box.l) * (box.b - box.t);
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < num; ++i) {
+    if (suppressed[i]) continue;
+    const DetectionBox box = (*boxes)[i];
+    for (size_t j = i + 1; j < num; ++j) {
+      const DetectionBox &other = (*boxes)[j];
+      if (suppressed[j] || other.label != box.label) continue;
+      float w = std::min(box.r, other.r) - std::max(box.l, other.l);
+      float h = std::min(box.b, other.b) - std::max(box.t, other.t);
+      if (w <= 0 || h <= 0) continue;
+      float inter = w * h;
+      if (inter > iou_threshold * (areas[i] + areas[j] - inter)) suppressed[j] = 1;
+    }
+    (*boxes)[kept++] = box;
+  }
+  boxes->resize(kept);
+}
+
+void FilterDetections(std::vector<DetectionBox> *boxes, const DetectionParams &params) {
+  if (params.top_k) SelectTopK(boxes, params.top_k);
+  if (params.nms_threshold > 0) NmsByClass(boxes, params.nms_threshold);
+}
+
+cnstream::CNInferObjectPtr CreateDetectionObject(const DetectionBox &box) {
+  auto obj = std::make_shared<cnstream::CNInferObject>();
+  obj->id = LabelIdString(box.label);
+  obj->score = box.score;
+  obj->bbox.x = box.l;
+  obj->bbox.y = box.t;
+  obj->bbox.w = std::min(1.0f - box.l, box.r - box.l);
+  obj->bbox.h = std::min(1.0f - box.t, box.b - box.t);
+  return obj;
+}
+
+const std::string &LabelIdString(int id) {
+  static const int kCachedNum = 1024;
+  static const std::vector<std::string> cached = [] {
+    std::vector<std::string> strs(kCachedNum);
+    for (int i = 0; i < kCachedNum; ++i) strs[i] = std::to_string(i);
+    return strs;
+  }();
+  if (id >= 0 && id < kCachedNum) return cached[id];
+  thread_local std::string str;
+  str = std::to_string(id);
+  return str;
+}
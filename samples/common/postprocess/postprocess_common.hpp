@@ -0,0 +1,87 @@
+/*************************************************************************
+ * Copyright (C) [2023] by Cambricon, Inc. All rights reserved
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *************************************************************************/
+#ifndef SAMPLES_COMMON_POSTPROCESS_COMMON_HPP_
+#define SAMPLES_COMMON_POSTPROCESS_COMMON_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cnstream_postproc.hpp"
+
+/**
+ * @brief A detection candidate. The coordinates are normalized to [0, 1].
+ */
+struct DetectionBox {
+  float l;
+  float t;
+  float r;
+  float b;
+  float score;
+  int label;
+};
+
+/**
+ * @brief Parameters of detection postprocessing, parsed from custom postproc params.
+ *
+ * nms_threshold: IoU threshold of class-aware NMS. 0 means NMS is disabled, e.g. it is done in the model already.
+ * top_k: the maximum number of candidates kept before NMS. 0 means no limit.
+ */
+struct DetectionParams {
+  float nms_threshold = 0;
+  size_t top_k = 0;
+};
+
+int ParseDetectionParams(const std::unordered_map<std::string, std::string> &params, DetectionParams *det_params);
+
+/**
+ * @brief Gets the indices of rows whose score is not less than threshold. All rows are kept if threshold <= 0.
+ *
+ * The rows are `stride` floats each and the score is at `score_offset` of a row.
+ */
+void FilterByScore(const float *data, int num, int stride, int score_offset, float threshold,
+                   std::vector<int> *indices);
+
+/**
+ * @brief Keeps the top k boxes sorted by score in descending order. Boxes are only sorted if k is 0.
+ */
+void SelectTopK(std::vector<DetectionBox> *boxes, size_t k);
+
+/**
+ * @brief Class-aware NMS. Boxes of different labels never suppress each other. The result is sorted by score.
+ */
+void NmsByClass(std::vector<DetectionBox> *boxes, float iou_threshold);
+
+/**
+ * @brief Applies top k selection and NMS to boxes according to params.
+ */
+void FilterDetections(std::vector<DetectionBox> *boxes, const DetectionParams &params);
+
+/**
+ * @brief Creates an object from a box. Id, score and bbox are set. Labels are left to the caller.
+ */
+cnstream::CNInferObjectPtr CreateDetectionObject(const DetectionBox &box);
+
+/**
+ * @brief Gets the string of a label id. Strings of small ids are cached.
+ */
+const std::string &LabelIdString(int id);
+
+#endif  // SAMPLES_COMMON_POSTPROCESS_COMMON_HPP_
@@ -197,8 +197,14 @@ int PreprocessCpu(cnedk::BufSurfWrapperPtr src, cnedk::BufSurfWrapperPtr dst,
   uint32_t batch_size = src->GetNumFilled();
 
   CnedkBufSurfaceSyncForCpu(src_buf, -1, -1);
-  size_t img_size = info.w * info.h * info.c;
-  std::unique_ptr<uint8_t[]> img_tmp = nullptr;
+  // mean and std are applied while the image is converted to float
+  bool normalize = mean_std && info.dtype == infer_server::DataType::FLOAT32;
+  if (normalize && (mean.size() < info.c || std.size() < info.c)) {
+    LOGE(PREPROC) << "[PreprocessCpu] The size of mean or std is less than the number of channels.";
+    return -1;
+  }
+  const float *norm_mean = normalize ? mean.data() : nullptr;
+  const float *norm_std = normalize ? std.data() : nullptr;
 
   for (uint32_t batch_idx = 0; batch_idx < batch_size; ++batch_idx) {
     uint8_t *y_plane = static_cast<uint8_t *>(src->GetHostData(0, batch_idx));
@@ -229,56 +235,11 @@ int PreprocessCpu(cnedk::BufSurfWrapperPtr src, cnedk::BufSurfWrapperPtr dst,
     uv_plane += src_bbox.left + src_bbox.top / 2 * uv_stride;
 
     void *dst_img = dst->GetHostData(0, batch_idx);
-
-    uint8_t *dst_img_u8, *dst_img_roi;
-    CnedkTransformRect dst_bbox;
-    if (info.dtype == infer_server::DataType::UINT8) {
-      dst_img_u8 = reinterpret_cast<uint8_t *>(dst_img);
-    } else if (info.dtype == infer_server::DataType::FLOAT32) {
-      img_tmp.reset(new uint8_t[img_size]);
-      dst_img_u8 = img_tmp.get();
-    } else {
+    if (cnstream::YUV420spToTensor(y_plane, uv_plane, src_bbox.width, src_bbox.height, y_stride, uv_stride, src_fmt,
+                                   info, dst_fmt, keep_aspect_ratio, pad_value, norm_mean, norm_std, false,
+                                   dst_img) != 0) {
       return -1;
     }
-
-    memset(dst_img_u8, pad_value, img_size);
-    if (keep_aspect_ratio) {
-      dst_bbox = cnstream::KeepAspectRatio(src_bbox.width, src_bbox.height, info.w, info.h);
-      // validate bbox
-      dst_bbox.left -= dst_bbox.left & 1;
-      dst_bbox.top -= dst_bbox.top & 1;
-      dst_bbox.width -= dst_bbox.width & 1;
-      dst_bbox.height -= dst_bbox.height & 1;
-
-      while (dst_bbox.left + dst_bbox.width > info.w) dst_bbox.width -= 2;
-      while (dst_bbox.top + dst_bbox.height > info.h) dst_bbox.height -= 2;
-
-      dst_img_roi = dst_img_u8 + dst_bbox.left * info.c + dst_bbox.top * info.w * info.c;
-    } else {
-      dst_bbox.left = 0;
-      dst_bbox.top = 0;
-      dst_bbox.width = info.w;
-      dst_bbox.height = info.h;
-      dst_img_roi = dst_img_u8;
-    }
-
-    cnstream::YUV420spToRGBx(y_plane, uv_plane, src_bbox.width, src_bbox.height, y_stride, uv_stride, src_fmt,
-                             dst_img_roi, dst_bbox.width, dst_bbox.height, info.w * info.c, dst_fmt);
-
-    if (info.dtype == infer_server::DataType::FLOAT32) {
-      float *dst_img_fp32 = reinterpret_cast<float *>(dst_img);
-      if (mean_std) {
-        for (uint32_t i = 0; i < info.w * info.h; i++) {
-          for (uint32_t c_i = 0; c_i < info.c; c_i++) {
-            dst_img_fp32[i * info.c + c_i] = (dst_img_u8[i * info.c + c_i] - mean[c_i]) / std[c_i];
-          }
-        }
-      } else {
-        for (uint32_t i = 0; i < img_size; i++) {
-          dst_img_fp32[i] = static_cast<float>(dst_img_u8[i]);
-        }
-      }
-    }
     dst->SyncHostToDevice(-1, batch_idx);
   }
   return 0;